@@ -143,6 +143,7 @@ namespace VulkanHelper
 		//static inline VkInstance GetInstance() { return s_Instance; }
 		static inline VkDevice GetDevice() { return s_Device; }
 		static inline VkPhysicalDevice GetPhysicalDevice() { return s_PhysicalDevice.Handle; }
+		static inline const VkPhysicalDeviceFeatures2& GetEnabledFeatures() { return s_Features; }
 		static inline SwapchainSupportDetails GetSwapchainSupport(VkSurfaceKHR surface) { return QuerySwapchainSupport(s_PhysicalDevice.Handle, surface); }
 		static inline QueueFamilyIndices FindPhysicalQueueFamilies() { return s_PhysicalDevice.Requirements.QueueIndices; }
 		static inline VkCommandPool& GetGraphicsCommandPool() { return s_CommandPools[std::this_thread::get_id()].GraphicsCommandPool; }
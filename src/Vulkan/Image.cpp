@@ -26,8 +26,18 @@ namespace VulkanHelper
 		m_Size.height = createInfo.Height;
 
 		m_MipLevels = createInfo.MipMapCount + 1;
-		m_MipLevels = glm::min((int)m_MipLevels, (int)glm::floor(glm::log2((float)glm::max(createInfo.Width, createInfo.Height))));
+		if (createInfo.DataContainsMips)
+		{
+			// Provided chain is used as is, so it may go all the way down to 1x1
+			VK_CORE_ASSERT(m_MipLevels <= (uint32_t)glm::floor(glm::log2((float)glm::max(createInfo.Width, createInfo.Height))) + 1, "Too many mip levels! Count: {}", m_MipLevels);
+		}
+		else
+		{
+			m_MipLevels = glm::min((int)m_MipLevels, (int)glm::floor(glm::log2((float)glm::max(createInfo.Width, createInfo.Height))));
+		}
 		m_MipLevels = glm::max((int)m_MipLevels, 1);
+		m_ResidentMip = createInfo.DataContainsMips ? createInfo.ResidentMip : 0;
+		VK_CORE_ASSERT(m_ResidentMip < m_MipLevels, "Resident mip is out of range! Mip: {}", m_ResidentMip);
 		m_Format = createInfo.Format;
 		m_Aspect = createInfo.Aspect;
 
@@ -53,11 +63,33 @@ namespace VulkanHelper
 
 		if (createInfo.Data != nullptr)
 		{
-			if (createInfo.HDR)
+			if (createInfo.HDR && createInfo.EnvAccelData != nullptr)
+				UploadHDRSamplingBuffer((const EnvAccel*)createInfo.EnvAccelData, (uint64_t)createInfo.Width * (uint64_t)createInfo.Height);
+			else if (createInfo.HDR)
+			{
+				VK_CORE_ASSERT(createInfo.Format == VK_FORMAT_R32G32B32A32_SFLOAT, "Importance sampling data can only be built from RGBA32F data, provide EnvAccelData for other formats!");
 				CreateHDRSamplingBuffer(createInfo.Data);
-			WritePixels(createInfo.Data);
+			}
 
-			GenerateMipmaps();
+			if (createInfo.DataContainsMips && m_ResidentMip != 0)
+			{
+				uint64_t offset = 0;
+				for (uint32_t i = 0; i < m_ResidentMip; i++)
+					offset += GetImageDataSize(m_Format, glm::max(m_Size.width >> i, 1u), glm::max(m_Size.height >> i, 1u));
+
+				WriteMipRange((const char*)createInfo.Data + offset, m_ResidentMip, m_MipLevels - m_ResidentMip);
+				m_Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+			else if (createInfo.DataContainsMips)
+			{
+				WriteMips(createInfo.Data);
+			}
+			else
+			{
+				WritePixels(createInfo.Data);
+
+				GenerateMipmaps();
+			}
 		}
 
 		m_Initialized = true;
@@ -109,6 +141,7 @@ namespace VulkanHelper
 		m_Allocation = std::move(other.m_Allocation);
 		m_Size = std::move(other.m_Size);
 		m_MipLevels = std::move(other.m_MipLevels);
+		m_ResidentMip = std::move(other.m_ResidentMip);
 
 		other.Reset();
 	}
@@ -135,6 +168,7 @@ namespace VulkanHelper
 		m_Allocation = std::move(other.m_Allocation);
 		m_Size = std::move(other.m_Size);
 		m_MipLevels = std::move(other.m_MipLevels);
+		m_ResidentMip = std::move(other.m_ResidentMip);
 
 		other.Reset();
 
@@ -201,6 +235,157 @@ namespace VulkanHelper
 		}
 	}
 
+	/**
+	 * @brief Uploads every mip level of the image at once. Data has to contain all levels tightly packed,
+	 * starting with the biggest one. Image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+	 */
+	void Image::WriteMips(const void* data, VkCommandBuffer cmd, uint32_t baseLayer)
+	{
+		bool cmdProvided = cmd != 0;
+
+		if (!cmdProvided)
+		{
+			Device::BeginSingleTimeCommands(cmd, Device::GetGraphicsCommandPool());
+		}
+
+		std::vector<VkBufferImageCopy> regions(m_MipLevels);
+		VkDeviceSize dataSize = 0;
+		for (uint32_t i = 0; i < m_MipLevels; i++)
+		{
+			uint32_t mipWidth = glm::max(m_Size.width >> i, 1u);
+			uint32_t mipHeight = glm::max(m_Size.height >> i, 1u);
+
+			VkBufferImageCopy& region = regions[i];
+			region = {};
+			region.bufferOffset = dataSize;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.baseArrayLayer = baseLayer;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { mipWidth, mipHeight, 1 };
+
+			dataSize += GetImageDataSize(m_Format, mipWidth, mipHeight);
+		}
+
+		Buffer buffer = Buffer();
+		Buffer::CreateInfo BufferInfo{};
+		BufferInfo.InstanceSize = dataSize;
+		BufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		BufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		buffer.Init(BufferInfo);
+
+		buffer.Map(dataSize);
+		buffer.WriteToBuffer((void*)data, dataSize);
+		buffer.Flush();
+		buffer.Unmap();
+
+		TransitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmd, baseLayer);
+		vkCmdCopyBufferToImage(cmd, buffer.GetBuffer(), m_ImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+		TransitionImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmd, baseLayer);
+
+		if (!cmdProvided)
+		{
+			Device::EndSingleTimeCommands(cmd, Device::GetGraphicsQueue(), Device::GetGraphicsCommandPool());
+		}
+	}
+
+	/**
+	 * @brief Uploads mipCount levels starting at baseMip, data has to contain only these levels tightly packed.
+	 * Levels are expected to be written for the first time, whatever they held before is discarded.
+	 * They end up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, other levels are left untouched.
+	 */
+	void Image::WriteMipRange(const void* data, uint32_t baseMip, uint32_t mipCount, VkCommandBuffer cmd)
+	{
+		VK_CORE_ASSERT(baseMip + mipCount <= m_MipLevels, "Mip range is out of bounds! Base: {}, Count: {}", baseMip, mipCount);
+
+		bool cmdProvided = cmd != 0;
+
+		if (!cmdProvided)
+		{
+			Device::BeginSingleTimeCommands(cmd, Device::GetGraphicsCommandPool());
+		}
+
+		std::vector<VkBufferImageCopy> regions(mipCount);
+		VkDeviceSize dataSize = 0;
+		for (uint32_t i = 0; i < mipCount; i++)
+		{
+			uint32_t mipWidth = glm::max(m_Size.width >> (baseMip + i), 1u);
+			uint32_t mipHeight = glm::max(m_Size.height >> (baseMip + i), 1u);
+
+			VkBufferImageCopy& region = regions[i];
+			region = {};
+			region.bufferOffset = dataSize;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = baseMip + i;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { mipWidth, mipHeight, 1 };
+
+			dataSize += GetImageDataSize(m_Format, mipWidth, mipHeight);
+		}
+
+		Buffer buffer = Buffer();
+		Buffer::CreateInfo BufferInfo{};
+		BufferInfo.InstanceSize = dataSize;
+		BufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		BufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		buffer.Init(BufferInfo);
+
+		buffer.Map(dataSize);
+		buffer.WriteToBuffer((void*)data, dataSize);
+		buffer.Flush();
+		buffer.Unmap();
+
+		// Only the written levels are transitioned, the resident ones may be sampled at the same time
+		VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, baseMip, mipCount, 0, 1 };
+		TransitionImageLayout(m_ImageHandle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, cmd, range);
+		vkCmdCopyBufferToImage(cmd, buffer.GetBuffer(), m_ImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+		TransitionImageLayout(m_ImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, cmd, range);
+
+		if (!cmdProvided)
+		{
+			Device::EndSingleTimeCommands(cmd, Device::GetGraphicsQueue(), Device::GetGraphicsCommandPool());
+		}
+	}
+
+	/**
+	 * @brief Recreates the image view so that it starts at the given mip level. Every level from mip down has to be
+	 * written already. Old view is destroyed right away, so the caller has to make sure that the GPU isn't using it
+	 * and that descriptors pointing to it get updated.
+	 */
+	void Image::SetResidentMip(uint32_t mip)
+	{
+		VK_CORE_ASSERT(m_Initialized, "Image Not Initialized!");
+		VK_CORE_ASSERT(mip < m_MipLevels, "Resident mip is out of range! Mip: {}", mip);
+
+		if (mip == m_ResidentMip)
+			return;
+
+		for (auto view : m_ImageViews)
+		{
+			vkDestroyImageView(Device::GetDevice(), view, nullptr);
+		}
+
+		m_ResidentMip = mip;
+		CreateImageView(m_Format, m_Aspect, m_LayerCount, VK_IMAGE_VIEW_TYPE_2D);
+	}
+
+	uint64_t Image::GetImageDataSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return (uint64_t)((width + 3) / 4) * (uint64_t)((height + 3) / 4) * 16;
+		default:
+			return (uint64_t)width * (uint64_t)height * (uint64_t)FormatToSize(format);
+		}
+	}
+
 	/*
 	 * @brief Creates an image view for the image based on the provided format, aspect, layer count, and image type.
 	 * It also handles the creation of individual layer views when the layer count is greater than 1.
@@ -221,8 +406,8 @@ namespace VulkanHelper
 		viewInfo.viewType = imageType;
 		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = aspect;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = m_MipLevels;
+		viewInfo.subresourceRange.baseMipLevel = m_ResidentMip;
+		viewInfo.subresourceRange.levelCount = m_MipLevels - m_ResidentMip;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = layerCount;
 		VK_CORE_RETURN_ASSERT(vkCreateImageView(Device::GetDevice(), &viewInfo, nullptr, &m_ImageViews[0]),
@@ -262,14 +447,19 @@ namespace VulkanHelper
 		float average, integral;
 		std::vector<EnvAccel> envAccel = CreateEnvAccel((float*)pixels, m_Size.width, m_Size.height, average, integral);
 
+		UploadHDRSamplingBuffer(envAccel.data(), envAccel.size());
+	}
+
+	void Image::UploadHDRSamplingBuffer(const EnvAccel* envAccel, uint64_t count)
+	{
 		Buffer::CreateInfo bufferInfo{};
-		bufferInfo.InstanceSize = sizeof(EnvAccel) * envAccel.size();
+		bufferInfo.InstanceSize = sizeof(EnvAccel) * count;
 		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 		bufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
 		Buffer stagingBuf(bufferInfo);
 		stagingBuf.Map();
-		stagingBuf.WriteToBuffer(envAccel.data());
+		stagingBuf.WriteToBuffer((void*)envAccel);
 		stagingBuf.Unmap();
 
 		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -792,6 +982,7 @@ namespace VulkanHelper
 		m_Allocation = nullptr;
 		m_Size = { 0, 0 };
 		m_MipLevels = 1;
+		m_ResidentMip = 0;
 		m_Initialized = false;
 		m_Usage = 0;
 		m_MemoryProperties = 0;
@@ -856,6 +1047,9 @@ namespace VulkanHelper
 		case VK_FORMAT_R16G16B16A16_SFLOAT:
 			return 4 * 2;
 			break;
+		case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+			return 4;
+			break;
 		case VK_FORMAT_R32_SFLOAT:
 			return 1 * 4;
 			break;
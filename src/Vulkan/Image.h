@@ -40,6 +40,18 @@ namespace VulkanHelper
 
 			bool HDR = false;
 
+			// Data already holds the whole mip chain (MipMapCount + 1 levels) packed one level after another,
+			// levels are uploaded as they are and nothing is generated on the GPU
+			bool DataContainsMips = false;
+
+			// Only with DataContainsMips. Levels below ResidentMip aren't uploaded and the view starts at ResidentMip,
+			// they can be streamed in later with WriteMipRange and made visible with SetResidentMip
+			uint32_t ResidentMip = 0;
+
+			// HDR only, precomputed importance sampling data with Width * Height entries.
+			// If it's not set it's built from Data, which writes the PDF into the alpha channel of Data.
+			const void* EnvAccelData = nullptr;
+
 			operator bool() const
 			{
 				if (Width == 0 || Height == 0 || Format == VK_FORMAT_MAX_ENUM || Usage == 0 || Properties == 0 || Aspect == VK_IMAGE_ASPECT_NONE)
@@ -70,7 +82,22 @@ namespace VulkanHelper
 		void BlitImageToImage(Image* srcImage, VkCommandBuffer cmd);
 
 		void WritePixels(void* data, VkCommandBuffer cmd = 0, uint32_t baseLayer = 0);
+		void WriteMips(const void* data, VkCommandBuffer cmd = 0, uint32_t baseLayer = 0);
+		void WriteMipRange(const void* data, uint32_t baseMip, uint32_t mipCount, VkCommandBuffer cmd = 0);
+		void SetResidentMip(uint32_t mip);
 		void GenerateMipmaps();
+
+		// Size in bytes of a single level, block compressed formats are rounded up to whole blocks
+		static uint64_t GetImageDataSize(VkFormat format, uint32_t width, uint32_t height);
+
+		struct EnvAccel
+		{
+			uint32_t Alias;
+			float Importance;
+		};
+
+		// Builds importance sampling data of an equirectangular RGBA32F map and stores the PDF into the alpha channel of pixels
+		static std::vector<EnvAccel> CreateEnvAccel(float* pixels, uint32_t width, uint32_t height, float& average, float& integral);
 	public:
 
 		inline VkImage GetImage() const { return m_ImageHandle; }
@@ -84,25 +111,21 @@ namespace VulkanHelper
 		inline void SetLayout(VkImageLayout newLayout) { m_Layout = newLayout; }
 		inline Buffer* GetAccelBuffer() { return &m_ImportanceSmplAccel; }
 		inline uint32_t GetMipLevelsCount() const { return m_MipLevels; }
+		inline uint32_t GetResidentMip() const { return m_ResidentMip; }
 		inline bool IsInitialized() const { return m_Initialized; }
 		inline VmaAllocation* GetAllocation() { return m_Allocation; }
 
 	private:
-		uint32_t FormatToSize(VkFormat format);
+		static uint32_t FormatToSize(VkFormat format);
 		void CreateImageView(VkFormat format, VkImageAspectFlagBits aspect, int layerCount = 1, VkImageViewType imageType = VK_IMAGE_VIEW_TYPE_2D);
 		void CreateImage(const CreateInfo& createInfo);
 		
-		float GetLuminance(const glm::vec3& color);
+		static float GetLuminance(const glm::vec3& color);
 
 		void CreateHDRSamplingBuffer(void* pixels);
-		struct EnvAccel
-		{
-			uint32_t Alias;
-			float Importance;
-		}; 
-		
-		std::vector<EnvAccel> CreateEnvAccel(float* pixels, uint32_t width, uint32_t height, float& average, float& integral);
-		float BuildAliasMap(const std::vector<float>& data, std::vector<EnvAccel>& accel);
+		void UploadHDRSamplingBuffer(const EnvAccel* envAccel, uint64_t count);
+
+		static float BuildAliasMap(const std::vector<float>& data, std::vector<EnvAccel>& accel);
 
 		VkFormat m_Format = VK_FORMAT_MAX_ENUM;
 		VkImageAspectFlagBits m_Aspect = VK_IMAGE_ASPECT_NONE;
@@ -115,6 +138,7 @@ namespace VulkanHelper
 		VmaAllocation* m_Allocation;
 		VkExtent2D m_Size;
 		uint32_t m_MipLevels = 1;
+		uint32_t m_ResidentMip = 0;
 
 		bool m_Initialized = false;
 
@@ -313,16 +313,14 @@ namespace VulkanHelper
 	 */
 	std::vector<char> Pipeline::ReadFile(const std::string& filepath)
 	{
-		std::ifstream file(filepath, std::ios::ate | std::ios::binary);    // ate goes to the end of the file so reading filesize is easier and binary avoids text transformation
-		VK_CORE_ASSERT(file.is_open(), "failed to open file: " + filepath);
-
-		uint32_t fileSize = (uint32_t)(file.tellg());    // tellg gets current position in file
-		std::vector<char> buffer(fileSize);
-		file.seekg(0);    // return to the beginning of the file
-		file.read(buffer.data(), fileSize);
+		MappedFile file;
+		if (!file.Init({ filepath }))
+		{
+			VK_CORE_ASSERT(false, "failed to open file: " + filepath);
+			return {};
+		}
 
-		file.close();
-		return buffer;
+		return std::vector<char>(file.GetData(), file.GetData() + file.GetSize());
 	}
 
 	/*
@@ -110,156 +110,187 @@ namespace VulkanHelper
 		std::string extension = filepath.substr(dotPos, filepath.size() - dotPos);
 		std::vector<uint32_t> data;
 		std::string shaderName = GetLastPartAfterLastSlash(filepath);
+		std::string cachePath = "CachedShaders/" + shaderName + ".cache";
 
-		if (std::filesystem::exists("CachedShaders/" + shaderName + ".cache"))
+		bool cached = std::filesystem::exists(cachePath) && ReadCache(cachePath, data);
+		if (!cached)
 		{
-			File::ReadFromFileVec(data, "CachedShaders/" + shaderName + ".cache");
-		}
-		else if (extension == ".slang")
-		{
-			slang::TargetDesc targetDesc{};
-			targetDesc.format = SLANG_SPIRV;
-			targetDesc.profile = s_GlobalSession->findProfile("spirv_1_4");
+			if (extension == ".slang")
+			{
+				slang::TargetDesc targetDesc{};
+				targetDesc.format = SLANG_SPIRV;
+				targetDesc.profile = s_GlobalSession->findProfile("spirv_1_4");
 
-			const char* searchPaths[] = { "src/shaders/" };
+				const char* searchPaths[] = { "src/shaders/" };
 
-			std::vector<slang::CompilerOptionEntry> compilerOptions(2);
-			compilerOptions[0].name = slang::CompilerOptionName::Optimization;
-			compilerOptions[0].value = slang::CompilerOptionValue{ slang::CompilerOptionValueKind::Int, SlangOptimizationLevel::SLANG_OPTIMIZATION_LEVEL_MAXIMAL };
+				std::vector<slang::CompilerOptionEntry> compilerOptions(2);
+				compilerOptions[0].name = slang::CompilerOptionName::Optimization;
+				compilerOptions[0].value = slang::CompilerOptionValue{ slang::CompilerOptionValueKind::Int, SlangOptimizationLevel::SLANG_OPTIMIZATION_LEVEL_MAXIMAL };
 
-			slang::SessionDesc sessionDesc{};
+				slang::SessionDesc sessionDesc{};
 
-			std::vector<slang::PreprocessorMacroDesc> macros(defines.size());
+				std::vector<slang::PreprocessorMacroDesc> macros(defines.size());
 
-			for (int i = 0; i < defines.size(); i++)
-			{
-				macros.emplace_back(defines[i].Name.c_str(), defines[i].Value.c_str());
-			}
+				for (int i = 0; i < defines.size(); i++)
+				{
+					macros.emplace_back(defines[i].Name.c_str(), defines[i].Value.c_str());
+				}
 
-			sessionDesc.preprocessorMacros = macros.data();
-			sessionDesc.preprocessorMacroCount = macros.size();
+				sessionDesc.preprocessorMacros = macros.data();
+				sessionDesc.preprocessorMacroCount = macros.size();
 
-			sessionDesc.targets = &targetDesc;
-			sessionDesc.targetCount = 1;
+				sessionDesc.targets = &targetDesc;
+				sessionDesc.targetCount = 1;
 
-			sessionDesc.searchPaths = searchPaths;
-			sessionDesc.searchPathCount = 1;
+				sessionDesc.searchPaths = searchPaths;
+				sessionDesc.searchPathCount = 1;
 
-			sessionDesc.compilerOptionEntries = compilerOptions.data();
-			sessionDesc.compilerOptionEntryCount = (uint32_t)compilerOptions.size();
+				sessionDesc.compilerOptionEntries = compilerOptions.data();
+				sessionDesc.compilerOptionEntryCount = (uint32_t)compilerOptions.size();
 
-			Microsoft::WRL::ComPtr<slang::ISession> session;
-			s_GlobalSession->createSession(sessionDesc, &session);
+				Microsoft::WRL::ComPtr<slang::ISession> session;
+				s_GlobalSession->createSession(sessionDesc, &session);
 
-			Microsoft::WRL::ComPtr<slang::IBlob> diagnostics;
-			Microsoft::WRL::ComPtr<slang::IModule> module = session->loadModule(filepath.c_str(), &diagnostics);
+				Microsoft::WRL::ComPtr<slang::IBlob> diagnostics;
+				Microsoft::WRL::ComPtr<slang::IModule> module = session->loadModule(filepath.c_str(), &diagnostics);
 
-			if (diagnostics)
-			{
-				std::string message((const char*)diagnostics->getBufferPointer());
-				if (message.find(": error") != std::string::npos)
-					VK_CORE_ERROR(message);
-				else
-					VK_CORE_WARN(message);
-			}
+				if (diagnostics)
+				{
+					std::string message((const char*)diagnostics->getBufferPointer());
+					if (message.find(": error") != std::string::npos)
+						VK_CORE_ERROR(message);
+					else
+						VK_CORE_WARN(message);
+				}
 
-			if (module == nullptr)
-				return data;
+				if (module == nullptr)
+					return data;
 
-			SlangResult res;
+				SlangResult res;
 
-			Microsoft::WRL::ComPtr<slang::IEntryPoint> entryPoint;
-			res = module->findEntryPointByName("main", &entryPoint);
+				Microsoft::WRL::ComPtr<slang::IEntryPoint> entryPoint;
+				res = module->findEntryPointByName("main", &entryPoint);
 
-			if (res != 0)
-				return data;
+				if (res != 0)
+					return data;
 
-			slang::IComponentType* components[] = { module.Get(), entryPoint.Get() };
-			Microsoft::WRL::ComPtr<slang::IComponentType> program;
-			res = session->createCompositeComponentType(components, 2, &program);
+				slang::IComponentType* components[] = { module.Get(), entryPoint.Get() };
+				Microsoft::WRL::ComPtr<slang::IComponentType> program;
+				res = session->createCompositeComponentType(components, 2, &program);
 
-			if (res != 0)
-				return data;
+				if (res != 0)
+					return data;
 
-			Microsoft::WRL::ComPtr<slang::IComponentType> linkedProgram;
-			Microsoft::WRL::ComPtr<ISlangBlob> diagnosticBlob;
-			res = program->link(&linkedProgram, &diagnosticBlob);
+				Microsoft::WRL::ComPtr<slang::IComponentType> linkedProgram;
+				Microsoft::WRL::ComPtr<ISlangBlob> diagnosticBlob;
+				res = program->link(&linkedProgram, &diagnosticBlob);
 
-			if (diagnosticBlob)
-			{
-				std::string message((const char*)diagnosticBlob->getBufferPointer());
-				if (message.find(": error") != std::string::npos)
-					VK_CORE_ERROR(message);
-				else
-					VK_CORE_WARN(message);
-			}
+				if (diagnosticBlob)
+				{
+					std::string message((const char*)diagnosticBlob->getBufferPointer());
+					if (message.find(": error") != std::string::npos)
+						VK_CORE_ERROR(message);
+					else
+						VK_CORE_WARN(message);
+				}
 
-			if (res != 0)
-				return data;
+				if (res != 0)
+					return data;
 
-			int entryPointIndex = 0; // only one entry point
-			int targetIndex = 0; // only one target
-			Microsoft::WRL::ComPtr<slang::IBlob> kernelBlob;
-			Microsoft::WRL::ComPtr<slang::IBlob> diagnostics1;
+				int entryPointIndex = 0; // only one entry point
+				int targetIndex = 0; // only one target
+				Microsoft::WRL::ComPtr<slang::IBlob> kernelBlob;
+				Microsoft::WRL::ComPtr<slang::IBlob> diagnostics1;
 
-			res = linkedProgram->getEntryPointCode(entryPointIndex, targetIndex, &kernelBlob, &diagnostics1);
+				res = linkedProgram->getEntryPointCode(entryPointIndex, targetIndex, &kernelBlob, &diagnostics1);
 
-			if (diagnostics1)
-			{
-				std::string message((const char*)diagnostics1->getBufferPointer());
-				if (message.find(": error") != std::string::npos)
-					VK_CORE_ERROR(message);
-				else
-					VK_CORE_WARN(message);
-			}
+				if (diagnostics1)
+				{
+					std::string message((const char*)diagnostics1->getBufferPointer());
+					if (message.find(": error") != std::string::npos)
+						VK_CORE_ERROR(message);
+					else
+						VK_CORE_WARN(message);
+				}
 
-			if (res != 0)
-				return data;
+				if (res != 0)
+					return data;
 
-			int codeSize = (int)kernelBlob->getBufferSize();
+				int codeSize = (int)kernelBlob->getBufferSize();
 
-			data.resize(codeSize / 4);
+				data.resize(codeSize / 4);
 
-			memcpy(data.data(), kernelBlob->getBufferPointer(), codeSize);
-		}
-		else if (extension == ".glsl")
-		{
-			VK_CORE_INFO("Compiling shader {}", filepath);
-
-			shaderc::Compiler compiler;
-			shaderc::CompileOptions options;
-			options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
-			options.SetOptimizationLevel(shaderc_optimization_level_performance);
-			for (int i = 0; i < defines.size(); i++)
-			{
-				options.AddMacroDefinition(defines[i].Name, defines[i].Value);
+				memcpy(data.data(), kernelBlob->getBufferPointer(), codeSize);
 			}
-			shaderc_util::FileFinder fileFinder;
-			options.SetIncluder(std::make_unique<glslc::FileIncluder>(&fileFinder));
+			else if (extension == ".glsl")
+			{
+				VK_CORE_INFO("Compiling shader {}", filepath);
+
+				shaderc::Compiler compiler;
+				shaderc::CompileOptions options;
+				options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+				options.SetOptimizationLevel(shaderc_optimization_level_performance);
+				for (int i = 0; i < defines.size(); i++)
+				{
+					options.AddMacroDefinition(defines[i].Name, defines[i].Value);
+				}
+				shaderc_util::FileFinder fileFinder;
+				options.SetIncluder(std::make_unique<glslc::FileIncluder>(&fileFinder));
 
-			std::string source = File::ReadFromFile(filepath);
-			shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(source, VkStageToScStage(m_Type), filepath.c_str(), options);
+				std::string source = File::ReadFromFile(filepath);
+				shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(source, VkStageToScStage(m_Type), filepath.c_str(), options);
 
-			if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+				if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+				{
+					VK_CORE_ERROR("Failed to compile shader! {}", module.GetErrorMessage());
+					return std::vector<uint32_t>();
+				}
+
+				data = std::vector<uint32_t>(module.cbegin(), module.cend());
+			}
+			else
 			{
-				VK_CORE_ERROR("Failed to compile shader! {}", module.GetErrorMessage());
-				return std::vector<uint32_t>();
+				VK_CORE_ASSERT(false, "The extension of shader has be either .slang or .glsl to indicate what language does it use! Given extension is {}", extension);
 			}
+		}
 
-			data = std::vector<uint32_t>(module.cbegin(), module.cend());
+		if (cacheToFile && !cached)
+		{
+			CreateCacheDir();
+
+			// SPIR-V is very repetitive so the cache is stored compressed
+			std::vector<char> compressed = Compression::Compress({ (const char*)data.data(), data.size() * sizeof(uint32_t) });
+			File::WriteToFile(compressed.data(), compressed.size(), cachePath);
 		}
-		else
+
+		return data;
+	}
+
+	bool Shader::ReadCache(const std::string& filepath, std::vector<uint32_t>& outData)
+	{
+		MappedFile file;
+		if (!file.Init({ filepath }))
+			return false;
+
+		// Caches written before they were compressed hold the SPIR-V as it is
+		if (!Compression::IsCompressed(file.GetSpan()))
 		{
-			VK_CORE_ASSERT(false, "The extension of shader has be either .slang or .glsl to indicate what language does it use! Given extension is {}", extension);
+			outData.resize(file.GetSize() / sizeof(uint32_t));
+			memcpy(outData.data(), file.GetData(), outData.size() * sizeof(uint32_t));
+			return !outData.empty();
 		}
 
-		if (cacheToFile)
+		uint64_t size = 0;
+		if (Compression::GetDecompressedSize(file.GetSpan(), size) && size % sizeof(uint32_t) == 0)
 		{
-			CreateCacheDir();
-			File::WriteToFile(data.data(), sizeof(uint32_t)* (uint32_t)data.size(), ("CachedShaders/" + shaderName + ".cache"));
+			outData.resize(size / sizeof(uint32_t));
+			if (Compression::Decompress(file.GetSpan(), { (char*)outData.data(), (size_t)size }))
+				return true;
 		}
 
-		return data;
+		VK_CORE_WARN("Shader cache {} is corrupted, compiling the shader again", filepath);
+		outData.clear();
+		return false;
 	}
 
 	void Shader::CreateCacheDir()
@@ -51,6 +51,7 @@ namespace VulkanHelper
 
 		std::string ReadShaderFile(const std::string& filepath);
 		void CreateCacheDir();
+		bool ReadCache(const std::string& filepath, std::vector<uint32_t>& outData);
 		std::vector<uint32_t> CompileSource(const std::string& filepath, const std::vector<Define>& defines, bool cacheToFile);
 		shaderc_shader_kind VkStageToScStage(VkShaderStageFlagBits stage);
 
@@ -0,0 +1,52 @@
+#include "pch.h"
+#include "Utility/Utility.h"
+
+#include "UploadBatch.h"
+
+namespace VulkanHelper
+{
+	UploadBatch::~UploadBatch()
+	{
+		Submit();
+	}
+
+	void UploadBatch::UploadToBuffer(const void* data, VkDeviceSize size, Buffer& dst, VkDeviceSize dstOffset)
+	{
+		if (size == 0)
+			return;
+
+		if (m_CommandBuffer == VK_NULL_HANDLE)
+		{
+			m_CommandPool = Device::GetGraphicsCommandPool();
+			Device::BeginSingleTimeCommands(m_CommandBuffer, m_CommandPool);
+		}
+
+		Buffer::CreateInfo bufferInfo{};
+		bufferInfo.InstanceSize = size;
+		bufferInfo.InstanceCount = 1;
+		bufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		Buffer stagingBuffer;
+		stagingBuffer.Init(bufferInfo);
+
+		stagingBuffer.Map();
+		stagingBuffer.WriteToBuffer((void*)data);
+		stagingBuffer.Flush();
+
+		Buffer::CopyBuffer(stagingBuffer.GetBuffer(), dst.GetBuffer(), size, 0, dstOffset, Device::GetGraphicsQueue(), m_CommandBuffer);
+
+		m_StagingBuffers.push_back(std::move(stagingBuffer));
+	}
+
+	void UploadBatch::Submit()
+	{
+		if (m_CommandBuffer == VK_NULL_HANDLE)
+			return;
+
+		Device::EndSingleTimeCommands(m_CommandBuffer, Device::GetGraphicsQueue(), m_CommandPool);
+
+		m_CommandBuffer = VK_NULL_HANDLE;
+		m_CommandPool = VK_NULL_HANDLE;
+		m_StagingBuffers.clear();
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "pch.h"
+
+#include "Buffer.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Records many buffer uploads into a single command buffer so that they are submitted and waited on once,
+	 * instead of once per upload. Staging buffers are kept alive until Submit.
+	 *
+	 * Command buffer is allocated from the pool of the thread that records the first upload, so the whole batch has
+	 * to be recorded and submitted on one thread. Destination buffers can't be used before Submit returns.
+	 */
+	class UploadBatch
+	{
+	public:
+		UploadBatch() = default;
+		~UploadBatch();
+
+		UploadBatch(const UploadBatch& other) = delete;
+		UploadBatch& operator=(const UploadBatch& other) = delete;
+		UploadBatch(UploadBatch&& other) noexcept = delete;
+		UploadBatch& operator=(UploadBatch&& other) noexcept = delete;
+
+		// Copies data into a new staging buffer and records a copy from it into dst
+		void UploadToBuffer(const void* data, VkDeviceSize size, Buffer& dst, VkDeviceSize dstOffset = 0);
+
+		// Submits everything recorded so far and waits for it, does nothing if the batch is empty
+		void Submit();
+
+		inline uint32_t GetUploadCount() const { return (uint32_t)m_StagingBuffers.size(); }
+
+	private:
+		VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+		VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+		std::vector<Buffer> m_StagingBuffers;
+	};
+}
@@ -7,6 +7,7 @@
 #include "VulkanHelper/src/VulkanHelper/Renderer/Renderer.h"
 #include "VulkanHelper/src/VulkanHelper/Renderer/FontAtlas.h"
 #include "VulkanHelper/src/VulkanHelper/Renderer/Text.h"
+#include "VulkanHelper/src/VulkanHelper/Renderer/MeshOptimizer.h"
 #include "VulkanHelper/src/VulkanHelper/Math/Transform.h"
 #include "VulkanHelper/src/VulkanHelper/Renderer/AccelerationStructure.h"
 #include "VulkanHelper/src/VulkanHelper/Renderer/Denoiser.h"
@@ -19,16 +19,15 @@ namespace VulkanHelper
 
 	AssetHandle::AssetHandle(const AssetHandle& other)
 	{
-		Init({ other.m_Handle });
+		if (other.m_Initialized)
+			Init({ other.m_Index, other.m_Generation });
 	}
 
 	AssetHandle::AssetHandle(AssetHandle&& other) noexcept
 	{
-		if (m_Initialized)
-			Destroy();
-
 		m_Initialized	= std::move(other.m_Initialized);
-		m_Handle		= std::move(other.m_Handle);
+		m_Index			= std::move(other.m_Index);
+		m_Generation	= std::move(other.m_Generation);
 
 		other.Reset();
 	}
@@ -40,18 +39,17 @@ namespace VulkanHelper
 
 	void AssetHandle::Init(const CreateInfo& createInfo)
 	{
+		// Increase reference count before releasing the old one, otherwise re-initializing
+		// a handle with the same asset could unload it in between
+		AssetManager::s_Assets.AddReference(createInfo.Index);
+
 		if (m_Initialized)
 			Destroy();
 
-		m_Handle = createInfo.Handle;
+		m_Index = createInfo.Index;
+		m_Generation = createInfo.Generation;
 
 		m_Initialized = true;
-
-		// Increase reference count
-		if (!AssetManager::s_AssetsReferenceCount.contains(m_Handle))
-			AssetManager::s_AssetsReferenceCount[m_Handle] = 1;
-		else
-			AssetManager::s_AssetsReferenceCount[m_Handle] += 1;
 	}
 
 	void AssetHandle::Destroy()
@@ -59,30 +57,33 @@ namespace VulkanHelper
 		if (!m_Initialized)
 			return;
 
-		// Decrease reference count
-		AssetManager::s_AssetsReferenceCount[m_Handle] -= 1;
-
-		// If there are no references then unload the asset
-		// <= 2 because 1 handle is stored inside the m_Assets map and one in Asset itself
-		if (AssetManager::s_AssetsReferenceCount[m_Handle] <= 2 && DoesHandleExist())
-			AssetManager::UnloadAsset(*this);
+		// Decrease reference count, the asset is unloaded once the last handle is gone
+		AssetManager::s_Assets.RemoveReference(m_Index, m_Generation);
 
 		m_Initialized = false;
 	}
 
 	AssetHandle& AssetHandle::operator=(const AssetHandle& other)
 	{
-		Init({ other.m_Handle });
+		if (other.m_Initialized)
+			Init({ other.m_Index, other.m_Generation });
+		else
+			Destroy();
+
 		return *this;
 	}
 
 	AssetHandle& AssetHandle::operator=(AssetHandle&& other) noexcept
 	{
+		if (this == &other)
+			return *this;
+
 		if (m_Initialized)
 			Destroy();
 
 		m_Initialized	= std::move(other.m_Initialized);
-		m_Handle		= std::move(other.m_Handle);
+		m_Index			= std::move(other.m_Index);
+		m_Generation	= std::move(other.m_Generation);
 
 		other.Reset();
 
@@ -164,12 +165,13 @@ namespace VulkanHelper
 	{
 		VK_CORE_ASSERT(m_Initialized, "Handle is not Initialized!");
 
-		return (size_t)m_Handle;
+		return (size_t)(((uint64_t)m_Generation << 32) | (uint64_t)m_Index);
 	}
 
 	void AssetHandle::Reset()
 	{
-		m_Handle = 0;
+		m_Index = 0;
+		m_Generation = 0;
 		m_Initialized = false;
 	}
 
@@ -177,18 +179,18 @@ namespace VulkanHelper
 	{
 		VK_CORE_ASSERT(m_Initialized, "Handle is not Initialized!");
 
-		return m_Handle == other.m_Handle;
+		return m_Index == other.m_Index && m_Generation == other.m_Generation;
 	}
 
 	bool AssetHandle::operator==(uint64_t other) const
 	{
 		VK_CORE_ASSERT(m_Initialized, "Handle is not Initialized!");
 
-		return m_Handle == other;
+		return (uint64_t)Hash() == other;
 	}
 
 	ModelAsset::ModelAsset(const std::string& path)
-		: Asset(AssetManager::CreateHandleFromPath(path), path)
+		: Asset(path)
 	{
 
 	}
@@ -239,7 +241,7 @@ namespace VulkanHelper
 
 	MaterialTextures::~MaterialTextures()
 	{
-
+		UntrackSet();
 	};
 
 	void MaterialTextures::CreateSet(VulkanHelperContext context, VkSampler samplerHandle)
@@ -284,101 +286,245 @@ namespace VulkanHelper
 		);
 
 		TexturesSet.Build();
+
+		// Streamed textures rewrite the set in place whenever more of their mips become resident
+		const AssetHandle* textures[] = { &AlbedoTexture, &NormalTexture, &RoughnessTexture, &MetallnessTexture };
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			dynamic_cast<TextureAsset*>(textures[i]->GetAsset())->TrackDescriptorBinding(TexturesSet.GetDescriptorSetHandle(), i, samplerHandle);
+		}
 	}
 
 	void MaterialTextures::SetAlbedo(AssetHandle handle)
 	{
+		UntrackTexture(AlbedoTexture);
 		AlbedoTexture = handle;
 	}
 
 	void MaterialTextures::SetNormal(AssetHandle handle)
 	{
+		UntrackTexture(NormalTexture);
 		NormalTexture = handle;
 	}
 
 	void MaterialTextures::SetRoughness(AssetHandle handle)
 	{
+		UntrackTexture(RoughnessTexture);
 		RoughnessTexture = handle;
 	}
 
 	void MaterialTextures::SetMetallness(AssetHandle handle)
 	{
+		UntrackTexture(MetallnessTexture);
 		MetallnessTexture = handle;
 	}
 
-	Asset::Asset(const AssetHandle& handle, const std::string& path)
+	void MaterialTextures::SetStreamingPriority(float priority)
+	{
+		AssetManager::SetStreamingPriority(AlbedoTexture, priority);
+		AssetManager::SetStreamingPriority(NormalTexture, priority);
+		AssetManager::SetStreamingPriority(RoughnessTexture, priority);
+		AssetManager::SetStreamingPriority(MetallnessTexture, priority);
+	}
+
+	void MaterialTextures::UntrackTexture(const AssetHandle& texture)
+	{
+		// Textures are tracked only once the set is built
+		if (!TexturesSet.IsInitialized() || !texture.DoesHandleExist())
+			return;
+
+		TextureAsset* asset = dynamic_cast<TextureAsset*>(AssetManager::GetAsset(texture));
+		if (asset != nullptr)
+			asset->UntrackDescriptorSet(TexturesSet.GetDescriptorSetHandle());
+	}
+
+	void MaterialTextures::UntrackSet()
+	{
+		UntrackTexture(AlbedoTexture);
+		UntrackTexture(NormalTexture);
+		UntrackTexture(RoughnessTexture);
+		UntrackTexture(MetallnessTexture);
+	}
+
+	Asset::Asset(const std::string& path)
 	{
-		m_AssetHandle = handle;
 		m_Path = path;
 	}
 
+	AssetHandle Asset::GetHandle()
+	{
+		VK_CORE_ASSERT(m_HandleInfo.Generation != 0, "Asset isn't registered in the AssetManager!");
+
+		return AssetHandle(m_HandleInfo);
+	}
+
 	Asset::~Asset()
 	{
 
 	}
 
 	MeshAsset::MeshAsset(const std::string& path)
-		: Asset(AssetManager::CreateHandleFromPath(path), path)
+		: Asset(path)
 	{
 
 	}
 
 	MeshAsset::MeshAsset(const std::string& path, VulkanHelper::Mesh&& mesh)
-		: Asset(AssetManager::CreateHandleFromPath(path), path), Mesh(std::move(mesh))
+		: Asset(path), Mesh(std::move(mesh))
+	{
+
+	};
+
+	MeshAsset::MeshAsset(const std::string& path, VulkanHelper::Mesh&& mesh, SourceData&& source)
+		: Asset(path), Mesh(std::move(mesh)), Source(std::move(source))
 	{
 
 	};
 
 	MeshAsset::MeshAsset(MeshAsset&& other) noexcept
-		: Asset(other.GetHandle(), other.GetPath()), Mesh(std::move(other.Mesh))
+		: Asset(std::move(other)), Mesh(std::move(other.Mesh)), Source(std::move(other.Source))
+	{
+
+	}
+
+	MeshAsset::SourceData MeshAsset::GetSourceData()
 	{
+		if (Source.Owner != nullptr)
+			return Source;
+
+		// Slow path, staging copy and a queue wait for each buffer
+		Ref<std::pair<std::vector<VulkanHelper::Mesh::Vertex>, std::vector<uint32_t>>> data = std::make_shared<std::pair<std::vector<VulkanHelper::Mesh::Vertex>, std::vector<uint32_t>>>();
+		data->first.resize(Mesh.GetVertexCount());
+		data->second.resize(Mesh.GetIndexCount());
+
+		if (Mesh.GetVertexLayout() == VulkanHelper::Mesh::VertexLayout::Packed)
+		{
+			// Packing is lossy, what comes back is what the GPU sees rather than the original vertices
+			std::vector<VulkanHelper::Mesh::PackedVertex> packedVertices(data->first.size());
+			Mesh.GetVertexBuffer()->ReadFromBuffer(packedVertices.data(), packedVertices.size() * sizeof(VulkanHelper::Mesh::PackedVertex), 0);
+
+			for (size_t i = 0; i < packedVertices.size(); i++)
+				data->first[i] = VulkanHelper::Mesh::UnpackVertex(packedVertices[i], Mesh.GetPositionCenter(), Mesh.GetPositionExtent());
+		}
+		else
+			Mesh.GetVertexBuffer()->ReadFromBuffer(data->first.data(), data->first.size() * sizeof(VulkanHelper::Mesh::Vertex), 0);
+		if (Mesh.HasIndexBuffer() && Mesh.GetIndexType() == VK_INDEX_TYPE_UINT16)
+		{
+			std::vector<uint16_t> narrowIndices(data->second.size());
+			Mesh.GetIndexBuffer()->ReadFromBuffer(narrowIndices.data(), narrowIndices.size() * sizeof(uint16_t), 0);
+			data->second.assign(narrowIndices.begin(), narrowIndices.end());
+		}
+		else if (Mesh.HasIndexBuffer())
+			Mesh.GetIndexBuffer()->ReadFromBuffer(data->second.data(), data->second.size() * sizeof(uint32_t), 0);
 
+		return { data->first, data->second, data };
+	}
+
+	uint64_t MeshAsset::GetMemorySize()
+	{
+		return Mesh.GetMemorySize();
 	}
 
 	TextureAsset::TextureAsset(const std::string& path, VulkanHelper::Image&& image)
-		: Asset(AssetManager::CreateHandleFromPath(path), path), Image(std::move(image))
+		: Asset(path), Image(std::move(image))
 	{
 
 	};
 
 	TextureAsset::TextureAsset(const std::string& path)
-		: Asset(AssetManager::CreateHandleFromPath(path), path)
+		: Asset(path)
 	{
 
 	}
 
 	TextureAsset::TextureAsset(TextureAsset&& other) noexcept
-		: Asset(other.GetHandle(), other.GetPath()), Image(std::move(other.Image))
+		: Asset(std::move(other)), Image(std::move(other.Image))
 	{
+		std::unique_lock<std::mutex> lock(other.m_BindingsMutex);
+		m_Bindings = std::move(other.m_Bindings);
+	}
+
+	void TextureAsset::TrackDescriptorBinding(VkDescriptorSet set, uint32_t binding, VkSampler sampler)
+	{
+		std::unique_lock<std::mutex> lock(m_BindingsMutex);
+
+		// Nothing left to stream, there's no need to keep track of the binding
+		if (Image.GetResidentMip() != 0)
+			m_Bindings.push_back({ set, binding, sampler });
+	}
+
+	void TextureAsset::UntrackDescriptorSet(VkDescriptorSet set)
+	{
+		std::unique_lock<std::mutex> lock(m_BindingsMutex);
+
+		m_Bindings.erase(std::remove_if(m_Bindings.begin(), m_Bindings.end(), [set](const DescriptorBinding& binding) { return binding.Set == set; }), m_Bindings.end());
+	}
+
+	void TextureAsset::SetResidentMip(uint32_t mip)
+	{
+		std::unique_lock<std::mutex> lock(m_BindingsMutex);
+
+		Image.SetResidentMip(mip);
+
+		std::vector<VkDescriptorImageInfo> imageInfos(m_Bindings.size());
+		std::vector<VkWriteDescriptorSet> writes(m_Bindings.size());
+		for (size_t i = 0; i < m_Bindings.size(); i++)
+		{
+			imageInfos[i] = { m_Bindings[i].Sampler, Image.GetImageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+			writes[i] = {};
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = m_Bindings[i].Set;
+			writes[i].dstBinding = m_Bindings[i].Binding;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[i].pImageInfo = &imageInfos[i];
+		}
+
+		vkUpdateDescriptorSets(Device::GetDevice(), (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+		if (mip == 0)
+			m_Bindings.clear();
+	}
+
+	uint64_t TextureAsset::GetMemorySize()
+	{
+		if (!Image.IsInitialized())
+			return 0;
+
+		uint64_t size = Image.GetAllocationInfo().size;
+		if (Image.GetAccelBuffer()->IsInitialized())
+			size += Image.GetAccelBuffer()->GetBufferSize();
 
+		return size;
 	}
 
 	MaterialAsset::MaterialAsset(const std::string& path)
-		: Asset(AssetManager::CreateHandleFromPath(path), path)
+		: Asset(path)
 	{
 
 	}
 
 	MaterialAsset::MaterialAsset(const std::string& path, VulkanHelper::Material&& material)
-		: Asset(AssetManager::CreateHandleFromPath(path), path), Material(std::move(material))
+		: Asset(path), Material(std::move(material))
 	{
 
 	};
 
 	MaterialAsset::MaterialAsset(MaterialAsset&& other) noexcept
-		: Asset(other.GetHandle(), other.GetPath()), Material(std::move(other.Material))
+		: Asset(std::move(other)), Material(std::move(other.Material))
 	{
 
 	}
 
 	SceneAsset::SceneAsset(const std::string& path, VulkanHelper::Scene&& scene)
-		: Asset(AssetManager::CreateHandleFromPath(path), path), Scene(std::move(scene))
+		: Asset(path), Scene(std::move(scene))
 	{
 
 	};
 
 	SceneAsset::SceneAsset(SceneAsset&& other) noexcept
-		: Asset(other.GetHandle(), other.GetPath()), Scene(std::move(other.Scene))
+		: Asset(std::move(other)), Scene(std::move(other.Scene))
 	{
 
 	}
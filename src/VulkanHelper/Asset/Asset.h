@@ -28,7 +28,8 @@ namespace VulkanHelper
 	public:
 		struct CreateInfo
 		{
-			uint64_t Handle;
+			uint32_t Index = 0;
+			uint32_t Generation = 0;
 		};
 
 		AssetHandle() = default;
@@ -53,6 +54,8 @@ namespace VulkanHelper
 		bool IsAssetLoaded() const;
 
 		inline bool IsInitialized() const { return m_Initialized; }
+		inline uint32_t GetIndex() const { return m_Index; }
+		inline uint32_t GetGeneration() const { return m_Generation; }
 
 		void Unload() const;
 		void WaitToLoad() const;
@@ -61,7 +64,8 @@ namespace VulkanHelper
 		bool operator==(uint64_t other) const;
 		size_t Hash() const;
 	private:
-		uint64_t m_Handle = 0;
+		uint32_t m_Index = 0;
+		uint32_t m_Generation = 0;
 
 		bool m_Initialized = false;
 
@@ -71,18 +75,26 @@ namespace VulkanHelper
 	class Asset
 	{
 	public:
-		Asset(const AssetHandle& handle, const std::string& path);
+		Asset(const std::string& path);
 		virtual ~Asset();
 
+		Asset(Asset&& other) noexcept = default;
+
 		virtual AssetType GetAssetType() = 0;
 
+		// Memory that stays allocated while the asset is resident, used for the AssetManager memory budget
+		virtual uint64_t GetMemorySize() { return 0; }
+
 		inline std::string GetPath() { return m_Path; }
-		inline AssetHandle GetHandle() { return m_AssetHandle; }
+		AssetHandle GetHandle();
 	private:
 		std::string m_Path = "";
-		AssetHandle m_AssetHandle;
+
+		// Not an AssetHandle because asset holding a reference to itself would never be unloaded
+		AssetHandle::CreateInfo m_HandleInfo{};
 
 		friend class AssetManager;
+		friend class AssetRegistry;
 	};
 
 	class MaterialProperties
@@ -125,6 +137,8 @@ namespace VulkanHelper
 		}
 		MaterialTextures& operator=(MaterialTextures&& other) noexcept
 		{
+			UntrackSet();
+
 			AlbedoTexture = std::move(other.AlbedoTexture);
 			NormalTexture = std::move(other.NormalTexture);
 			RoughnessTexture = std::move(other.RoughnessTexture);
@@ -142,6 +156,9 @@ namespace VulkanHelper
 		void SetRoughness(AssetHandle handle);
 		void SetMetallness(AssetHandle handle);
 
+		// Higher priority textures get their mip levels streamed in first, e.g. based on screen space size of the mesh
+		void SetStreamingPriority(float priority);
+
 		inline AssetHandle GetAlbedo() const { return AlbedoTexture; }
 		inline AssetHandle GetNormal() const { return NormalTexture; }
 		inline AssetHandle GetRoughness() const { return RoughnessTexture; }
@@ -152,6 +169,9 @@ namespace VulkanHelper
 		AssetHandle NormalTexture;
 		AssetHandle RoughnessTexture;
 		AssetHandle MetallnessTexture;
+
+		void UntrackTexture(const AssetHandle& texture);
+		void UntrackSet();
 	};
 
 	class Material
@@ -178,14 +198,54 @@ namespace VulkanHelper
 		explicit TextureAsset(TextureAsset&& other) noexcept;
 
 		virtual AssetType GetAssetType() override { return AssetType::Texture; }
+		virtual uint64_t GetMemorySize() override;
 		VulkanHelper::Image Image;
+
+		// Keeps track of a built set that samples the image, so that it's rewritten in place whenever streaming makes
+		// more mip levels resident. Has to be called on the thread that calls AssetManager::UpdateStreaming, so that
+		// the view written into the set can't change in between. Sets have to be untracked before they're destroyed.
+		void TrackDescriptorBinding(VkDescriptorSet set, uint32_t binding, VkSampler sampler);
+		void UntrackDescriptorSet(VkDescriptorSet set);
+	private:
+		struct DescriptorBinding
+		{
+			VkDescriptorSet Set = VK_NULL_HANDLE;
+			uint32_t Binding = 0;
+			VkSampler Sampler = VK_NULL_HANDLE;
+		};
+
+		// Called by the TextureStreamer once the GPU is idle, recreates the view and rewrites every tracked binding
+		void SetResidentMip(uint32_t mip);
+
+		std::mutex m_BindingsMutex;
+		std::vector<DescriptorBinding> m_Bindings;
+
+		friend class TextureStreamer;
 	};
 
 	class MeshAsset : public Asset
 	{
 	public:
+		// CPU side copy of the mesh data, scenes serialize meshes from it instead of reading the GPU buffers back.
+		// Spans point into memory kept alive by Owner, e.g. the cooked model file the mesh was created from
+		struct SourceData
+		{
+			std::span<const Mesh::Vertex> Vertices;
+			std::span<const uint32_t> Indices;
+			Ref<const void> Owner;
+
+			// Meshlets and LODs the mesh was cooked with, empty if it has none. All of them are kept, even the ones
+			// that weren't uploaded, so that scenes store them along with the mesh and don't have to rebuild them
+			std::span<const Mesh::Meshlet> Meshlets;
+			std::span<const uint32_t> MeshletVertices;
+			std::span<const uint8_t> MeshletTriangles;
+			std::span<const Mesh::Lod> Lods;
+			std::span<const uint32_t> LodIndices;
+		};
+
 		MeshAsset(const std::string& path);
 		explicit MeshAsset(const std::string& path, Mesh&& mesh);
+		explicit MeshAsset(const std::string& path, Mesh&& mesh, SourceData&& source);
 
 		virtual ~MeshAsset() {};
 		explicit MeshAsset(const MeshAsset& other) = delete;
@@ -195,7 +255,14 @@ namespace VulkanHelper
 		explicit MeshAsset(MeshAsset&& other) noexcept;
 
 		virtual AssetType GetAssetType() override { return AssetType::Mesh; }
+		virtual uint64_t GetMemorySize() override;
 		VulkanHelper::Mesh Mesh;
+
+		// Empty if the mesh was created without keeping its data around
+		SourceData Source;
+
+		// Returns Source, or reads the data back from the GPU buffers if there is no CPU side copy
+		SourceData GetSourceData();
 	};
 
 	class MaterialAsset : public Asset
@@ -225,7 +292,7 @@ namespace VulkanHelper
 		explicit ModelAsset(const ModelAsset& other) = delete;
 		ModelAsset& operator=(const ModelAsset& other) = delete;
 		ModelAsset(ModelAsset&& other) noexcept
-			: Asset(other.GetHandle(), other.GetPath())
+			: Asset(std::move(other))
 		{ 
 			Meshes = std::move(other.Meshes);
 			MeshNames = std::move(other.MeshNames);
@@ -5,13 +5,105 @@
 #include <stb_image.h>
 
 #include "AssetManager.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "Renderer/MeshOptimizer.h"
 
 #include <assimp/Importer.hpp>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOStream.hpp>
 #include <assimp/postprocess.h>
 
 namespace VulkanHelper
 {
-	Image AssetImporter::ImportTexture(std::string path, bool HDR)
+	namespace
+	{
+		// Read only stream over a file inside of a mounted asset pack, or over a file that was read ahead
+		class PackIOStream : public Assimp::IOStream
+		{
+		public:
+			PackIOStream(std::span<const char> data, Ref<const std::vector<char>> buffer = nullptr)
+				: m_Data(data), m_Buffer(std::move(buffer)) {}
+
+			size_t Read(void* buffer, size_t size, size_t count) override
+			{
+				if (size == 0)
+					return 0;
+
+				count = std::min(count, (m_Data.size() - m_Position) / size);
+				memcpy(buffer, m_Data.data() + m_Position, size * count);
+				m_Position += size * count;
+
+				return count;
+			}
+
+			size_t Write(const void* buffer, size_t size, size_t count) override { return 0; }
+
+			aiReturn Seek(size_t offset, aiOrigin origin) override
+			{
+				size_t position;
+				if (origin == aiOrigin_SET)
+					position = offset;
+				else if (origin == aiOrigin_CUR)
+					position = m_Position + offset;
+				else
+					position = offset <= m_Data.size() ? m_Data.size() - offset : SIZE_MAX;
+
+				if (position > m_Data.size())
+					return aiReturn_FAILURE;
+
+				m_Position = position;
+				return aiReturn_SUCCESS;
+			}
+
+			size_t Tell() const override { return m_Position; }
+			size_t FileSize() const override { return m_Data.size(); }
+			void Flush() override {}
+		private:
+			std::span<const char> m_Data;
+			Ref<const std::vector<char>> m_Buffer;
+			size_t m_Position = 0;
+		};
+
+		// Looks files up in mounted asset packs first, so that files referenced by the model (gltf buffers,
+		// obj materials) come from the pack as well. Anything that isn't packed or read ahead is read from the disk.
+		class PackIOSystem : public Assimp::DefaultIOSystem
+		{
+		public:
+			bool Exists(const char* file) const override
+			{
+				std::span<const char> data;
+				Ref<const std::vector<char>> preloaded;
+				return AssetManager::FindPreloadedFile(file, preloaded) || AssetManager::FindPackedFile(file, data) || DefaultIOSystem::Exists(file);
+			}
+
+			Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+			{
+				if (strchr(mode, 'w') != nullptr)
+					return DefaultIOSystem::Open(file, mode);
+
+				if (std::find(m_OpenedFiles.begin(), m_OpenedFiles.end(), file) == m_OpenedFiles.end())
+					m_OpenedFiles.push_back(file);
+
+				Ref<const std::vector<char>> preloaded;
+				if (AssetManager::FindPreloadedFile(file, preloaded))
+					return new PackIOStream({ preloaded->data(), preloaded->size() }, preloaded);
+
+				std::span<const char> data;
+				if (AssetManager::FindPackedFile(file, data))
+					return new PackIOStream(data);
+
+				return DefaultIOSystem::Open(file, mode);
+			}
+
+			// Every file read during the import, the model itself included. A model cache depends on all of them
+			inline const std::vector<std::string>& GetOpenedFiles() const { return m_OpenedFiles; }
+		private:
+			std::vector<std::string> m_OpenedFiles;
+		};
+	}
+
+	Image AssetImporter::ImportTexture(std::string path, bool HDR, const ImportSettings& settings)
 	{
 		for (int i = 0; i < path.size(); i++)
 		{
@@ -19,39 +111,106 @@ namespace VulkanHelper
 				path[i] = ' ';
 		}
 
-		int texChannels;
-		bool flipOnLoad = !HDR;
-		stbi_set_flip_vertically_on_load_thread(flipOnLoad);
-		int sizeX, sizeY;
-		void* pixels;
-		if (HDR)
+		TextureCache::Texture texture;
+		LoadCookedTexture(path, GetTextureFormat(HDR, settings), texture);
+
+		return CreateTextureImage(texture, HDR, 0);
+	}
+
+	Image AssetImporter::ImportStreamedTexture(std::string path, Ref<TextureCache::Texture>& outTexture, uint32_t& outResidentMip)
+	{
+		for (int i = 0; i < path.size(); i++)
+		{
+			if (path[i] == '%')
+				path[i] = ' ';
+		}
+
+		outTexture = std::make_shared<TextureCache::Texture>();
+		LoadCookedTexture(path, GetTextureFormat(false, {}), *outTexture);
+
+		outResidentMip = TextureStreamer::GetTailMip(*outTexture);
+		return CreateTextureImage(*outTexture, false, outResidentMip);
+	}
+
+	std::vector<std::string> AssetImporter::GetReadAheadFiles(std::string path, const ImportSettings& settings)
+	{
+		size_t dotPos = path.find_last_of('.');
+		std::string extension = dotPos != std::string::npos ? path.substr(dotPos) : "";
+
+		std::string cachePath;
+		if (extension == ".png" || extension == ".jpg" || extension == ".hdr")
 		{
-			pixels = stbi_loadf(path.c_str(), &sizeX, &sizeY, &texChannels, STBI_rgb_alpha);
+			// Same path fixup as in ImportTexture, files are looked up by the exact path the loader uses
+			for (int i = 0; i < path.size(); i++)
+			{
+				if (path[i] == '%')
+					path[i] = ' ';
+			}
+
+			cachePath = TextureCache::GetCachePath(path, GetTextureFormat(extension == ".hdr", settings));
+		}
+		else if (extension == ".gltf" || extension == ".obj" || extension == ".fbx")
+		{
+			cachePath = ModelCache::GetCachePath(path);
 		}
 		else
 		{
-			pixels = stbi_load(path.c_str(), &sizeX, &sizeY, &texChannels, STBI_rgb_alpha);
+			return {};
+		}
+
+		// Packed caches are trusted as they are, nothing is read from the disk at all
+		std::span<const char> packed;
+		if (AssetManager::FindPackedFile(cachePath, packed))
+			return {};
+
+		// Cache may not exist yet, in which case it simply fails to read. The source is needed either way,
+		// for cooking or for validating the cache against its hash
+		std::vector<std::string> files = { cachePath };
+		if (!AssetManager::FindPackedFile(path, packed))
+			files.push_back(path);
+
+		return files;
+	}
+
+	VkFormat AssetImporter::GetTextureFormat(bool HDR, const ImportSettings& settings)
+	{
+		if (HDR)
+			return settings.HDRFormat;
+
+		return AssetManager::s_CompressTextures ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	void AssetImporter::LoadCookedTexture(const std::string& path, VkFormat format, TextureCache::Texture& outTexture)
+	{
+		Timer timer;
+
+		bool cooked = TextureCache::Read(path, format, outTexture);
+		if (!cooked)
+		{
+			TextureCache::Cook(path, format, outTexture, &AssetManager::s_ThreadPool);
+			TextureCache::Write(path, outTexture);
 		}
 
-		std::filesystem::path cwd = std::filesystem::current_path();
-		VK_CORE_ASSERT(pixels, "failed to load texture image! Path: {0}, Current working directory: {1}", path, cwd.string());
-		uint64_t sizeOfPixel = HDR ? sizeof(float) * 4 : sizeof(uint8_t) * 4;
-		VkDeviceSize imageSize = (uint64_t)sizeX * (uint64_t)sizeY * sizeOfPixel;
+		VK_CORE_TRACE("{0} texture {1} in {2}ms", cooked ? "Loaded cooked" : "Cooked", path, timer.ElapsedMillis());
+	}
 
+	Image AssetImporter::CreateTextureImage(const TextureCache::Texture& texture, bool HDR, uint32_t residentMip)
+	{
 		Image::CreateInfo info{};
 		info.Aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-		info.Format = HDR ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
-		info.Height = sizeY;
-		info.Width = sizeX;
+		info.Format = texture.Format;
+		info.Height = texture.Height;
+		info.Width = texture.Width;
 		info.Properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		info.Usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		info.Data = (void*)pixels;
+		info.Data = (void*)texture.Pixels.data();
+		info.DataContainsMips = true;
+		info.MipMapCount = (int)texture.MipCount - 1;
 		info.HDR = HDR;
-		info.MipMapCount = glm::min(5, (int)glm::floor(glm::log2((float)glm::max(sizeX, sizeY))));
+		info.EnvAccelData = HDR ? texture.EnvAccel.data() : nullptr;
+		info.ResidentMip = residentMip;
 		Image image(info);
 
-		stbi_image_free(pixels);
-
 		return Image(std::move(image));
 	}
 
@@ -59,11 +218,24 @@ namespace VulkanHelper
 	{
 		Timer timer;
 
+		ModelAsset asset(path);
+
+		// Shared with the mesh assets, which keep it as the CPU side copy of their data
+		Ref<ModelCache::Model> model = std::make_shared<ModelCache::Model>();
+		if (ModelCache::Read(path, *model))
+		{
+			CreateModelAssets(model, path, &asset);
+
+			VK_CORE_INFO("Loaded cooked model {0} in {1}ms", path, timer.ElapsedMillis());
+			return asset;
+		}
+
 		Assimp::Importer importer;
+		PackIOSystem* ioSystem = new PackIOSystem();
+		importer.SetIOHandler(ioSystem); // Importer takes ownership
 		const aiScene* scene = importer.ReadFile(path,
 			aiProcess_CalcTangentSpace |
 			aiProcess_GenSmoothNormals |
-			aiProcess_ImproveCacheLocality |
 			aiProcess_RemoveRedundantMaterials |
 			aiProcess_SplitLargeMeshes |
 			aiProcess_Triangulate |
@@ -77,171 +249,208 @@ namespace VulkanHelper
 			VK_CORE_ASSERT(false, ""); // TODO: some error handling
 		}
 
-		ModelAsset asset(path);
+		ProcessAssimpScene(scene, *model);
 
-		int index = 0;
-		ProcessAssimpNode(scene->mRootNode, scene, path, &asset, index);
+		// Files referenced by the model, like gltf buffers or obj materials, invalidate the cache as well
+		ModelCache::Write(path, *model, ioSystem->GetOpenedFiles());
 
-		for (int i = 0; i < asset.Meshes.size(); i++)
-		{
-			asset.Meshes[i].WaitToLoad();
-		}
-		for (int i = 0; i < asset.Materials.size(); i++)
-		{
-			asset.Materials[i].WaitToLoad();
-		}
+		CreateModelAssets(model, path, &asset);
 
+		// Not waiting for meshes and materials here, AssetManager resolves the model once they are loaded
+		VK_CORE_INFO("Imported model {0} in {1}ms", path, timer.ElapsedMillis());
 		return asset;
 	}
 
-	void AssetImporter::ProcessAssimpNode(aiNode* node, const aiScene* scene, const std::string& filepath, ModelAsset* outAsset, int& index)
+	void AssetImporter::CreateModelAssets(const Ref<ModelCache::Model>& modelRef, const std::string& filepath, ModelAsset* outAsset)
 	{
-		// process each mesh located at the current node
-		for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		const ModelCache::Model& model = *modelRef;
+
+		std::vector<AssetHandle> materials(model.Materials.size());
+		for (size_t i = 0; i < model.Materials.size(); i++)
 		{
-			glm::mat4 transform = glm::transpose(*(glm::mat4*)(&node->mTransformation));
-			aiNode* currNode = node;
-			while (true)
+			const ModelCache::MaterialData& materialData = model.Materials[i];
+
+			std::string path = filepath + "::Material::" + materialData.Name;
+
+			AssetHandle handle = AssetManager::FindAsset(path);
+
+			if (!handle.IsInitialized())
 			{
-				if (currNode->mParent)
-				{
-					currNode = currNode->mParent;
-					transform = glm::transpose(*(glm::mat4*)(&currNode->mTransformation)) * transform;
-				}
-				else
-				{
-					break;
-				}
+				Material mat;
+				mat.MaterialName = materialData.Name;
+				mat.Properties = materialData.Properties;
+
+				mat.Textures.SetAlbedo(AssetManager::LoadAsset(materialData.TexturePaths[0]));
+				mat.Textures.SetNormal(AssetManager::LoadAsset(materialData.TexturePaths[1]));
+				mat.Textures.SetRoughness(AssetManager::LoadAsset(materialData.TexturePaths[2]));
+				mat.Textures.SetMetallness(AssetManager::LoadAsset(materialData.TexturePaths[3]));
+
+				std::vector<AssetHandle> textures = { mat.Textures.GetAlbedo(), mat.Textures.GetNormal(), mat.Textures.GetRoughness(), mat.Textures.GetMetallness() };
+
+				std::unique_ptr<Asset> materialAsset = std::make_unique<MaterialAsset>(path, std::move(mat));
+				handle = AssetManager::AddAsset(path, std::move(materialAsset), textures);
 			}
 
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			std::string meshName = node->mName.C_Str();
+			materials[i] = handle;
+		}
+
+		std::vector<MeshAsset::SourceData> sources(model.Meshes.size());
+		for (size_t i = 0; i < model.Meshes.size(); i++)
+		{
+			const ModelCache::MeshData& meshData = model.Meshes[i];
+			sources[i] = { meshData.Vertices, meshData.Indices, modelRef, meshData.Meshlets, meshData.MeshletVertices, meshData.MeshletTriangles, meshData.Lods, meshData.LodIndices };
+		}
 
+		// Uploads are independent of each other so they run across the whole pool, only registration below is serial
+		std::vector<Mesh> meshes(model.Meshes.size());
+		AssetManager::s_ThreadPool.ParallelFor((uint32_t)meshes.size(), [&sources, &meshes](uint32_t index)
 			{
-				std::string path = filepath + "::Mesh::" + meshName;
+				const MeshAsset::SourceData& source = sources[index];
+				meshes[index].Init(source.Vertices, source.Indices, 0, 0, nullptr, AssetManager::ChooseVertexLayout(source.Vertices));
+				AssetManager::UploadMeshletsAndLods(meshes[index], source);
+			});
 
-				std::hash<std::string> hash;
+		for (size_t i = 0; i < model.Meshes.size(); i++)
+		{
+			const ModelCache::MeshData& meshData = model.Meshes[i];
 
-				// For some models multiple meshes have the same name (for example due to using multiple materials on a single mesh in blender),
-				// otherwise the incorrect mesh will be used
-				int indexMesh = 0;
-				while (true)
-				{
-					AssetHandle handle(AssetHandle::CreateInfo{ hash(path + std::to_string(indexMesh)) });
-					if (handle.DoesHandleExist())
-						indexMesh++;
-					else break;
-				}
-				path += std::to_string(indexMesh);
+			std::string path = filepath + "::Mesh::" + meshData.Name;
 
-				AssetHandle handle(AssetHandle::CreateInfo{ hash(path) });
+			// For some models multiple meshes have the same name (for example due to using multiple materials on a single mesh in blender),
+			// otherwise the incorrect mesh will be used
+			int indexMesh = 0;
+			while (AssetManager::FindAsset(path + std::to_string(indexMesh)).IsInitialized())
+			{
+				indexMesh++;
+			}
+			path += std::to_string(indexMesh);
 
-				Mesh vlMesh(mesh, scene);
+			std::unique_ptr<Asset> meshAsset = std::make_unique<MeshAsset>(path, std::move(meshes[i]), std::move(sources[i]));
+			AssetHandle handle = AssetManager::AddAsset(path, std::move(meshAsset));
 
-				std::unique_ptr<Asset> meshAsset = std::make_unique<MeshAsset>(path, std::move(vlMesh));
-				AssetManager::AddAsset(path, std::move(meshAsset));
+			outAsset->MeshNames.push_back(meshData.Name);
+			outAsset->Meshes.push_back(handle);
+			outAsset->Materials.push_back(materials[meshData.MaterialIndex]);
+			outAsset->MeshTransfrorms.push_back(meshData.Transform);
+		}
+	}
 
-				outAsset->MeshNames.push_back(meshName);
-				outAsset->Meshes.push_back(handle);
-			}
+	ModelCache::MaterialData AssetImporter::ConvertAssimpMaterial(aiMaterial* material)
+	{
+		ModelCache::MaterialData mat;
+		mat.Name = material->GetName().C_Str();
 
-			aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-			Material mat;
+		aiColor4D emissiveColor(0.0f, 0.0f, 0.0f, 0.0f);
+		aiColor4D diffuseColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-			aiColor4D emissiveColor(0.0f, 0.0f, 0.0f, 0.0f);
-			aiColor4D diffuseColor(0.0f, 0.0f, 0.0f, 0.0f);
+		material->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor);
+		material->Get(AI_MATKEY_EMISSIVE_INTENSITY, emissiveColor.a);
+		material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
+		material->Get(AI_MATKEY_ROUGHNESS_FACTOR, mat.Properties.Roughness);
+		material->Get(AI_MATKEY_METALLIC_FACTOR, mat.Properties.Metallic);
+		material->Get(AI_MATKEY_REFRACTI, mat.Properties.Ior);
+		material->Get(AI_MATKEY_TRANSMISSION_FACTOR, mat.Properties.Transparency);
 
-			{
-				std::string matName = material->GetName().C_Str();
+		mat.Properties.Roughness = glm::pow(mat.Properties.Roughness, 1.0f / 4.0f);
 
-				mat.MaterialName = matName;
+		mat.Properties.Color = glm::vec4(diffuseColor.r, diffuseColor.g, diffuseColor.b, 1.0f);
+		mat.Properties.EmissiveColor = glm::vec4(emissiveColor.r, emissiveColor.g, emissiveColor.b, emissiveColor.a);
 
-				std::string path = filepath + "::Material::" + matName;
+		// Create Empty Texture if none are found
+		auto getTexturePath = [material](aiTextureType type, const std::string& defaultPath)
+		{
+			int count = (int)material->GetTextureCount(type);
+			if (count == 0)
+				return defaultPath;
 
-				std::hash<std::string> hash;
-				AssetHandle handle(AssetHandle::CreateInfo{ hash(path) });
+			aiString str;
+			material->GetTexture(type, count - 1, &str);
+			return std::string("assets/") + std::string(str.C_Str());
+		};
 
-				if (!handle.DoesHandleExist())
-				{
-					material->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor);
-					material->Get(AI_MATKEY_EMISSIVE_INTENSITY, emissiveColor.a);
-					material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
-					material->Get(AI_MATKEY_ROUGHNESS_FACTOR, mat.Properties.Roughness);
-					material->Get(AI_MATKEY_METALLIC_FACTOR, mat.Properties.Metallic);
-					material->Get(AI_MATKEY_REFRACTI, mat.Properties.Ior);
-					material->Get(AI_MATKEY_TRANSMISSION_FACTOR, mat.Properties.Transparency);
-
-					mat.Properties.Roughness = glm::pow(mat.Properties.Roughness, 1.0f / 4.0f);
-
-					for (int i = 0; i < (int)material->GetTextureCount(aiTextureType_DIFFUSE); i++)
-					{
-						aiString str;
-						material->GetTexture(aiTextureType_DIFFUSE, i, &str);
-						mat.Textures.SetAlbedo(AssetManager::LoadAsset(std::string("assets/") + std::string(str.C_Str())));
-					}
-
-					for (int i = 0; i < (int)material->GetTextureCount(aiTextureType_NORMALS); i++)
-					{
-						aiString str;
-						material->GetTexture(aiTextureType_NORMALS, i, &str);
-						mat.Textures.SetNormal(AssetManager::LoadAsset(std::string("assets/") + std::string(str.C_Str())));
-					}
-
-					for (int i = 0; i < (int)material->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS); i++)
-					{
-						aiString str;
-						material->GetTexture(aiTextureType_DIFFUSE_ROUGHNESS, i, &str);
-						mat.Textures.SetRoughness(AssetManager::LoadAsset(std::string("assets/") + std::string(str.C_Str())));
-					}
-
-					for (int i = 0; i < (int)material->GetTextureCount(aiTextureType_METALNESS); i++)
-					{
-						aiString str;
-						material->GetTexture(aiTextureType_METALNESS, i, &str);
-						mat.Textures.SetMetallness(AssetManager::LoadAsset(std::string("assets/") + std::string(str.C_Str())));
-					}
-
-					// Create Empty Texture if none are found
-					if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0)
-					{
-						mat.Textures.SetAlbedo(AssetManager::LoadAsset("assets/white.png"));
-					}
-					if (material->GetTextureCount(aiTextureType_NORMALS) == 0)
-					{
-						mat.Textures.SetNormal(AssetManager::LoadAsset("assets/empty_normal.png"));
-					}
-					if (material->GetTextureCount(aiTextureType_METALNESS) == 0)
-					{
-						mat.Textures.SetMetallness(AssetManager::LoadAsset("assets/white.png"));
-					}
-					if (material->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS) == 0)
-					{
-						mat.Textures.SetRoughness(AssetManager::LoadAsset("assets/white.png"));
-					}
-
-					mat.Properties.Color = glm::vec4(diffuseColor.r, diffuseColor.g, diffuseColor.b, 1.0f);
-					mat.Properties.EmissiveColor = glm::vec4(emissiveColor.r, emissiveColor.g, emissiveColor.b, emissiveColor.a);
-
-					std::unique_ptr<Asset> materialAsset = std::make_unique<MaterialAsset>(path, std::move(mat));
-					AssetManager::AddAsset(path, std::move(materialAsset));
-				}
+		mat.TexturePaths[0] = getTexturePath(aiTextureType_DIFFUSE, "assets/white.png");
+		mat.TexturePaths[1] = getTexturePath(aiTextureType_NORMALS, "assets/empty_normal.png");
+		mat.TexturePaths[2] = getTexturePath(aiTextureType_DIFFUSE_ROUGHNESS, "assets/white.png");
+		mat.TexturePaths[3] = getTexturePath(aiTextureType_METALNESS, "assets/white.png");
 
-				outAsset->Materials.push_back(handle);
-			}
+		return mat;
+	}
 
-			// Rotate every model 180 degrees
-			glm::mat4 rot = glm::rotate(glm::mat4{ 1.0f }, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-			transform = rot * transform;
-			outAsset->MeshTransfrorms.push_back(transform);
+	void AssetImporter::ProcessAssimpScene(const aiScene* scene, ModelCache::Model& outModel)
+	{
+		struct FlatNode
+		{
+			aiNode* Node;
+			glm::mat4 Transform;
+		};
+
+		// Flatten the node tree first so that the world transform of every node is computed only once
+		std::vector<FlatNode> nodes;
+		std::vector<FlatNode> stack = { { scene->mRootNode, glm::transpose(*(glm::mat4*)(&scene->mRootNode->mTransformation)) } };
+		while (!stack.empty())
+		{
+			FlatNode flatNode = stack.back();
+			stack.pop_back();
+			nodes.push_back(flatNode);
 
-			index++;
+			// Children are pushed in reverse so that meshes keep the order of a recursive walk
+			for (int i = (int)flatNode.Node->mNumChildren - 1; i >= 0; i--)
+			{
+				aiNode* child = flatNode.Node->mChildren[i];
+				stack.push_back({ child, flatNode.Transform * glm::transpose(*(glm::mat4*)(&child->mTransformation)) });
+			}
 		}
 
-		// process each of the children nodes
-		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		// Rotate every model 180 degrees
+		glm::mat4 rot = glm::rotate(glm::mat4{ 1.0f }, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+		std::unordered_map<uint32_t, uint32_t> materialIndices;
+		std::vector<aiMesh*> meshes;
+		for (const FlatNode& flatNode : nodes)
 		{
-			ProcessAssimpNode(node->mChildren[i], scene, filepath, outAsset, index);
+			for (unsigned int i = 0; i < flatNode.Node->mNumMeshes; i++)
+			{
+				aiMesh* mesh = scene->mMeshes[flatNode.Node->mMeshes[i]];
+
+				auto materialIter = materialIndices.find(mesh->mMaterialIndex);
+				if (materialIter == materialIndices.end())
+				{
+					materialIter = materialIndices.emplace(mesh->mMaterialIndex, (uint32_t)outModel.Materials.size()).first;
+					outModel.Materials.push_back(ConvertAssimpMaterial(scene->mMaterials[mesh->mMaterialIndex]));
+				}
+
+				ModelCache::MeshData& meshData = outModel.Meshes.emplace_back();
+				meshData.Name = flatNode.Node->mName.C_Str();
+				meshData.Transform = rot * flatNode.Transform;
+				meshData.MaterialIndex = materialIter->second;
+
+				meshes.push_back(mesh);
+			}
 		}
+
+		// Mesh conversion doesn't touch any shared state so every mesh can be processed on a different thread
+		outModel.VertexStorage.resize(meshes.size());
+		outModel.IndexStorage.resize(meshes.size());
+		outModel.MeshletStorage.resize(meshes.size());
+		outModel.LodStorage.resize(meshes.size());
+		outModel.LodIndexStorage.resize(meshes.size());
+		AssetManager::s_ThreadPool.ParallelFor((uint32_t)meshes.size(), [&meshes, &outModel](uint32_t index)
+			{
+				Mesh::ConvertAssimpMesh(meshes[index], glm::mat4(1.0f), outModel.VertexStorage[index], outModel.IndexStorage[index]);
+				MeshOptimizer::Optimize(outModel.VertexStorage[index], outModel.IndexStorage[index]);
+				Mesh::BuildMeshlets(outModel.VertexStorage[index], outModel.IndexStorage[index], outModel.MeshletStorage[index]);
+				MeshOptimizer::GenerateLods(outModel.VertexStorage[index], outModel.IndexStorage[index], AssetManager::s_MeshLodCount,
+					outModel.LodStorage[index], outModel.LodIndexStorage[index]);
+
+				ModelCache::MeshData& meshData = outModel.Meshes[index];
+				meshData.Vertices = outModel.VertexStorage[index];
+				meshData.Indices = outModel.IndexStorage[index];
+				meshData.Meshlets = outModel.MeshletStorage[index].Meshlets;
+				meshData.MeshletVertices = outModel.MeshletStorage[index].Vertices;
+				meshData.MeshletTriangles = outModel.MeshletStorage[index].Triangles;
+				meshData.Lods = outModel.LodStorage[index];
+				meshData.LodIndices = outModel.LodIndexStorage[index];
+			});
 	}
 
 }
\ No newline at end of file
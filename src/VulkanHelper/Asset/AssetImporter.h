@@ -3,29 +3,50 @@
 #include "Scene/Scene.h"
 
 #include "Serializer.h"
+#include "ModelCache.h"
+#include "TextureCache.h"
 
 namespace VulkanHelper
 {
 	class AssetManager;
 
+	struct ImportSettings
+	{
+		// Storage of HDR textures, one of VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT and VK_FORMAT_E5B9G9R9_UFLOAT_PACK32.
+		// Importance sampling data is always built from the full precision source. E5B9G9R9 has no alpha channel
+		// so the PDF that is normally stored there is lost, the importance sampling buffer is unaffected.
+		VkFormat HDRFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+	};
+
 	class AssetImporter
 	{
 	public:
-		static Image ImportTexture(std::string path, bool HDR);
+		static Image ImportTexture(std::string path, bool HDR, const ImportSettings& settings = {});
+		// LDR only, uploads just the mip tail. outTexture keeps the whole chain for the TextureStreamer
+		static Image ImportStreamedTexture(std::string path, Ref<TextureCache::Texture>& outTexture, uint32_t& outResidentMip);
 		static ModelAsset ImportModel(const std::string& path);
 
+		// Files on the disk that importing path reads, so that they can be read ahead before the import starts
+		static std::vector<std::string> GetReadAheadFiles(std::string path, const ImportSettings& settings = {});
+
 		template<typename ... T>
-		static Scene ImportScene(const std::string& path)
+		static Scene ImportScene(const std::string& path, ThreadPool* threadPool = nullptr)
 		{
 			Scene scene;
 
-			Serializer::DeserializeScene<T...>(path, &scene);
+			Serializer::DeserializeScene<T...>(path, &scene, threadPool);
 
 			return scene;
 		}
 	private:
 
-		static void ProcessAssimpNode(aiNode* node, const aiScene* scene, const std::string& filepath, ModelAsset* outAsset, int& index);
+		static VkFormat GetTextureFormat(bool HDR, const ImportSettings& settings);
+		static void LoadCookedTexture(const std::string& path, VkFormat format, TextureCache::Texture& outTexture);
+		static Image CreateTextureImage(const TextureCache::Texture& texture, bool HDR, uint32_t residentMip);
+
+		static void CreateModelAssets(const Ref<ModelCache::Model>& model, const std::string& filepath, ModelAsset* outAsset);
+		static ModelCache::MaterialData ConvertAssimpMaterial(aiMaterial* material);
+		static void ProcessAssimpScene(const aiScene* scene, ModelCache::Model& outModel);
 	};
 
 }
\ No newline at end of file
@@ -2,20 +2,44 @@
 #include "AssetManager.h"
 #include "AssetImporter.h"
 
+#include <thread>
+
 namespace VulkanHelper
 {
-	VulkanHelper::AssetHandle AssetManager::CreateHandleFromPath(const std::string& path)
-	{
-		std::hash<std::string> hash;
-		return AssetHandle::CreateInfo{ hash(path) };
-	}
-
 	void AssetManager::Init(const CreateInfo& createInfo)
 	{
 		if (s_Initialized)
 			Destroy();
 
 		s_ThreadPool.Init({ createInfo.ThreadCount });
+		s_FileReader.Init(createInfo.FileReader);
+
+		// A few more loads than threads, so that reading files of the next ones overlaps with decoding
+		s_MaxLoadsInFlight = std::max(createInfo.ThreadCount, 1u) * 2;
+		s_LoadsInFlight = 0;
+
+		s_Assets.SetMemoryBudget(createInfo.MemoryBudget);
+
+		for (const std::string& pack : createInfo.AssetPacks)
+		{
+			if (!MountPack(pack))
+				VK_CORE_ERROR("Failed to mount asset pack {}", pack);
+		}
+
+		s_StreamTextures = createInfo.StreamTextures;
+		s_TextureStreamer.Init(&s_ThreadPool);
+
+		s_PackVertices = createInfo.PackVertices;
+		s_VertexTolerance = createInfo.VertexTolerance;
+		s_UploadMeshlets = createInfo.UploadMeshlets;
+		s_MeshLodCount = createInfo.MeshLodCount;
+
+		s_CompressTextures = createInfo.CompressTextures;
+		if (s_CompressTextures && !Device::GetEnabledFeatures().features.textureCompressionBC)
+		{
+			VK_CORE_WARN("textureCompressionBC feature isn't enabled, textures won't be compressed");
+			s_CompressTextures = false;
+		}
 
 		s_Initialized = true;
 	}
@@ -25,162 +49,573 @@ namespace VulkanHelper
 		if (!s_Initialized)
 			return;
 
-		for (auto iterator = s_Assets.begin();;)
-		{
-			iterator = s_Assets.begin();
-
-			if (iterator == s_Assets.end())
-				break;
+		// Loads that haven't started are dropped, the ones that have are finished below
+		std::unique_lock<std::mutex> loadsLock(s_LoadsMutex);
+		s_MaxLoadsInFlight = 0;
+		std::map<LoadOrder, PendingLoad> pendingLoads = std::move(s_PendingLoads);
+		s_PendingLoads.clear();
+		s_PendingLoadOrders.clear();
+		loadsLock.unlock();
 
-			s_Assets.erase(iterator->first);
+		for (auto& [order, load] : pendingLoads)
+		{
+			CancelLoad(load);
 		}
 
+		// Reads that are still in flight push their load tasks to the pool, so the reader goes first
+		s_FileReader.Destroy();
 		s_ThreadPool.Destroy();
-		s_Assets.clear();
+		s_TextureStreamer.Destroy();
+		s_Assets.Clear();
+
+		std::unique_lock<std::shared_mutex> lock(s_PacksMutex);
+		s_Packs.clear();
+		lock.unlock();
+
+		std::unique_lock<std::shared_mutex> preloadedLock(s_PreloadedFilesMutex);
+		s_PreloadedFiles.clear();
 		s_Initialized = false;
 	}
 
 	Asset* AssetManager::GetAsset(const AssetHandle& handle)
 	{
-		auto iter = s_Assets.find(handle);
-		VK_CORE_ASSERT(iter != s_Assets.end(), "There is no such handle!");
-
-		return iter->second.Asset.get();
+		return s_Assets.GetAsset(handle);
 	}
 
 	bool AssetManager::DoesHandleExist(const AssetHandle& handle)
 	{
-		auto iter = s_Assets.find(handle);
-		return iter != s_Assets.end();
+		return s_Assets.Contains(handle);
+	}
+
+	AssetHandle AssetManager::FindAsset(const std::string& path)
+	{
+		return s_Assets.Find(path);
 	}
 
 	void AssetManager::WaitToLoad(const AssetHandle& handle)
 	{
-		auto iter = s_Assets.find(handle);
-		VK_CORE_ASSERT(iter != s_Assets.end(), "There is no such handle!");
+		std::shared_future<void> future;
+		bool found = s_Assets.GetFuture(handle, future);
+		VK_CORE_ASSERT(found, "There is no such handle!");
 
-		if (iter->second.Future.wait_for(std::chrono::duration<float>(0)) == std::future_status::ready)
+		if (future.wait_for(std::chrono::duration<float>(0)) == std::future_status::ready)
 			return;
 
-		iter->second.Future.wait();
+		future.wait();
 	}
 
 	bool AssetManager::IsAssetLoaded(const AssetHandle& handle)
 	{
-		auto iter = s_Assets.find(handle);
-		VK_CORE_ASSERT(iter != s_Assets.end(), "There is no such handle!");
+		std::shared_future<void> future;
+		bool found = s_Assets.GetFuture(handle, future);
+		VK_CORE_ASSERT(found, "There is no such handle!");
 
-		return iter->second.Future.wait_for(std::chrono::duration<float>(0)) == std::future_status::ready;
+		return future.wait_for(std::chrono::duration<float>(0)) == std::future_status::ready;
 	}
 
-	AssetHandle AssetManager::LoadAsset(const std::string& path)
+	AssetHandle AssetManager::LoadAsset(const std::string& path, const ImportSettings& settings, float priority)
 	{
-		std::hash<std::string> hash;
-		AssetHandle handle(AssetHandle::CreateInfo{hash(path)});
-		if (s_Assets.contains(handle))
-		{
-			// Asset with this path is already loaded
-			return AssetHandle(handle);
-		}
-
 		size_t dotPos = path.find_last_of('.');
 		VK_CORE_ASSERT(dotPos != std::string::npos, "Failed to get file extension! Path: {}", path);
 		std::string extension = path.substr(dotPos, path.size() - dotPos);
 
+		// Assets needed by a load that's running have to be there for it to finish, so they don't wait behind prefetching
+		priority = std::max(priority, s_TaskPriority);
+
 		std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
 
-		std::unique_lock<std::mutex> lock(s_AssetsMutex);
-		s_Assets[handle] = { promise->get_future(), nullptr };
-		lock.unlock();
+		// Check and insert in a single step so that two threads loading the same path can't both start the load.
+		// If the asset is still cached from an earlier load, it's handed out without loading it again
+		AssetWithFuture entry{ promise->get_future(), nullptr, {}, false, true };
+		bool created = false;
+		AssetHandle handle = s_Assets.Acquire(path, entry, created);
+		if (!created)
+		{
+			// Asset with this path is already loaded or queued, possibly by prefetching with lower priority
+			ChangeLoadPriority(handle, priority, true);
+			return handle;
+		}
+
+		// Files are read on the I/O thread first so that load tasks don't block pool threads on the disk
+		std::vector<std::string> files = AssetImporter::GetReadAheadFiles(path, settings);
+
+		if ((extension == ".png" || extension == ".jpg") && s_StreamTextures)
+		{
+			QueueLoad(path, handle, priority, std::move(files), promise, [](AssetHandle handle, std::string path, std::shared_ptr<std::promise<void>> promise)
+				{
+					VK_CORE_TRACE("Loading Texture: {}", path);
+					Ref<TextureCache::Texture> texture;
+					uint32_t residentMip = 0;
+					Scope<Asset> asset = std::make_unique<TextureAsset>(path, std::move(AssetImporter::ImportStreamedTexture(path, texture, residentMip)));
+					asset->m_Path = path;
 
-		if (extension == ".png" || extension == ".jpg")
+					s_Assets.SetAsset(handle, std::move(asset));
+
+					// Texture is usable with just the mip tail, the rest follows in the background
+					s_TextureStreamer.AddTexture(handle, std::move(texture), residentMip);
+
+					FinishLoading(handle, promise);
+				}, path, promise);
+		}
+		else if (extension == ".png" || extension == ".jpg")
 		{
-			s_ThreadPool.PushTask([](std::string path, std::shared_ptr<std::promise<void>> promise, AssetHandle handle)
+			QueueLoad(path, handle, priority, std::move(files), promise, [](AssetHandle handle, std::string path, std::shared_ptr<std::promise<void>> promise)
 				{
 					VK_CORE_TRACE("Loading Texture: {}", path);
 					Scope<Asset> asset = std::make_unique<TextureAsset>(path, std::move(AssetImporter::ImportTexture(path, false)));
 					asset->m_Path = path;
-		
-					std::unique_lock<std::mutex> lock(s_AssetsMutex);
-					s_Assets[handle].Asset = std::move(asset);
-					lock.unlock();
-		
-					promise->set_value();
-				}, path, promise, handle);
+
+					s_Assets.SetAsset(handle, std::move(asset));
+
+					FinishLoading(handle, promise);
+				}, path, promise);
 		}
 		else if (extension == ".gltf" || extension == ".obj" || extension == ".fbx")
 		{
-			s_ThreadPool.PushTask([](std::string path, std::shared_ptr<std::promise<void>> promise, AssetHandle handle)
+			QueueLoad(path, handle, priority, std::move(files), promise, [](AssetHandle handle, std::string path, std::shared_ptr<std::promise<void>> promise)
 				{
-					Scope<Asset> asset = std::make_unique<ModelAsset>(std::move(AssetImporter::ImportModel(path)));
+					Scope<ModelAsset> asset = std::make_unique<ModelAsset>(std::move(AssetImporter::ImportModel(path)));
 					asset->m_Path = path;
-		
-					std::unique_lock<std::mutex> lock(s_AssetsMutex);
-					s_Assets[handle].Asset = std::move(asset);
-					lock.unlock();
-		
-					promise->set_value();
-				}, path, promise, handle);
+
+					std::vector<AssetHandle> dependencies = asset->Meshes;
+					dependencies.insert(dependencies.end(), asset->Materials.begin(), asset->Materials.end());
+
+					s_Assets.SetAsset(handle, std::move(asset));
+
+					// Model is loaded once all of its meshes and materials are (and materials wait for their textures),
+					// the worker is free to pick up other tasks in the meantime
+					OnLoaded(dependencies, [handle, promise]() { FinishLoading(handle, promise); });
+				}, path, promise);
 		}
 		else if (extension == ".hdr")
 		{
-			s_ThreadPool.PushTask([](std::string path, std::shared_ptr<std::promise<void>> promise, AssetHandle handle)
+			QueueLoad(path, handle, priority, std::move(files), promise, [](AssetHandle handle, std::string path, std::shared_ptr<std::promise<void>> promise, ImportSettings settings)
 				{
-					Scope<Asset> asset = std::make_unique<TextureAsset>(path, std::move(AssetImporter::ImportTexture(path, true)));
+					Scope<Asset> asset = std::make_unique<TextureAsset>(path, std::move(AssetImporter::ImportTexture(path, true, settings)));
 					asset->m_Path = path;
-		
-					std::unique_lock<std::mutex> lock(s_AssetsMutex);
-					s_Assets[handle].Asset = std::move(asset);
-					lock.unlock();
-		
-					promise->set_value();
-				}, path, promise, handle);
+
+					s_Assets.SetAsset(handle, std::move(asset));
+
+					FinishLoading(handle, promise);
+				}, path, promise, settings);
 		}
 		else { VK_CORE_ASSERT(false, "Extension not supported! Extension: {}", extension); }
 
-		return AssetHandle(handle);
+		return handle;
 	}
 
-	VulkanHelper::AssetHandle AssetManager::AddAsset(const std::string& path, std::unique_ptr<Asset>&& asset)
+	AssetGroup AssetManager::LoadAssets(const std::vector<std::string>& paths, const ImportSettings& settings, float priority)
 	{
-		std::hash<std::string> hash;
-		AssetHandle handle(AssetHandle::CreateInfo{ hash(path) });
-		if (s_Assets.contains(handle))
+		AssetGroup group;
+		group.Handles.reserve(paths.size());
+		for (const std::string& path : paths)
 		{
-			// Asset with this path is already loaded
-			asset.reset();
-			return AssetHandle(handle);
+			group.Handles.push_back(LoadAsset(path, settings, priority));
 		}
 
 		std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+		group.Future = promise->get_future().share();
+
+		OnLoaded(group.Handles, [promise]() { promise->set_value(); });
+
+		return group;
+	}
+
+	void AssetManager::SetLoadPriority(const AssetHandle& handle, float priority)
+	{
+		ChangeLoadPriority(handle, priority, false);
+	}
+
+	void AssetManager::ChangeLoadPriority(const AssetHandle& handle, float priority, bool raiseOnly)
+	{
+		std::unique_lock<std::mutex> lock(s_LoadsMutex);
+
+		auto iter = s_PendingLoadOrders.find(GetLoadKey({ handle.GetIndex(), handle.GetGeneration() }));
+		if (iter == s_PendingLoadOrders.end() || (raiseOnly && iter->second.Priority >= priority))
+			return;
+
+		// Sequence is kept, so the load still goes before the ones with the same priority that were queued after it
+		auto node = s_PendingLoads.extract(iter->second);
+		node.key().Priority = priority;
+		iter->second = node.key();
+		s_PendingLoads.insert(std::move(node));
+	}
+
+	VulkanHelper::AssetHandle AssetManager::AddAsset(const std::string& path, std::unique_ptr<Asset>&& asset)
+	{
+		std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+		promise->set_value();
+
 		asset->m_Path = path;
 
-		std::unique_lock<std::mutex> lock(s_AssetsMutex);
-		s_Assets[handle] = { promise->get_future(), std::move(asset) };
-		lock.unlock();
+		// If asset with this path is already loaded the new one is rejected and destroyed at the end of this scope
+		AssetWithFuture entry{ promise->get_future(), std::move(asset), {}, true };
+		bool created = false;
+		return s_Assets.Acquire(path, entry, created);
+	}
+
+	AssetHandle AssetManager::AddAsset(const std::string& path, std::unique_ptr<Asset>&& asset, const std::vector<AssetHandle>& dependencies)
+	{
+		std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+
+		asset->m_Path = path;
+
+		AssetWithFuture entry{ promise->get_future(), std::move(asset) };
+		bool created = false;
+		AssetHandle handle = s_Assets.Acquire(path, entry, created);
+		if (!created)
+			return handle;
 
+		// Asset itself is already there, it's only considered loaded after everything it depends on is
+		OnLoaded(dependencies, [handle, promise]() { FinishLoading(handle, promise); });
+
+		return handle;
+	}
+
+	void AssetManager::OnLoaded(const AssetHandle& handle, std::function<void()>&& callback)
+	{
+		if (!handle.IsInitialized() || !s_Assets.AddContinuation(handle, std::move(callback)))
+			callback();
+	}
+
+	void AssetManager::OnLoaded(const std::vector<AssetHandle>& handles, std::function<void()>&& callback)
+	{
+		// One extra count so that the callback can't fire before every continuation is registered
+		Ref<std::atomic<uint32_t>> remaining = std::make_shared<std::atomic<uint32_t>>((uint32_t)handles.size() + 1);
+		Ref<std::function<void()>> sharedCallback = std::make_shared<std::function<void()>>(std::move(callback));
+
+		auto arrive = [remaining, sharedCallback]()
+		{
+			if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1)
+				(*sharedCallback)();
+		};
+
+		for (const AssetHandle& handle : handles)
+		{
+			OnLoaded(handle, arrive);
+		}
+
+		arrive();
+	}
+
+	void AssetManager::FinishLoading(const AssetHandle& handle, const std::shared_ptr<std::promise<void>>& promise)
+	{
+		std::vector<std::function<void()>> continuations;
+		s_Assets.MarkLoaded(handle, continuations);
+
+		// Resolve the future first so that continuations already see the asset as loaded
 		promise->set_value();
 
-		return AssetHandle(handle);
+		for (auto& continuation : continuations)
+		{
+			continuation();
+		}
+	}
+
+	void AssetManager::UpdateStreaming()
+	{
+		s_TextureStreamer.Update();
 	}
 
-	void AssetManager::UnloadAsset(const AssetHandle& handle)
+	void AssetManager::SetStreamingPriority(const AssetHandle& texture, float priority)
 	{
-		VK_CORE_TRACE("Unloading asset: {}", handle.GetAsset()->GetPath());
+		s_TextureStreamer.SetPriority(texture, priority);
+	}
+
+	bool AssetManager::MountPack(const std::string& path)
+	{
+		AssetPack pack;
+		if (!pack.Init({ path }))
+			return false;
+
+		VK_CORE_INFO("Mounted asset pack {0} with {1} files", path, pack.GetFileCount());
+
+		std::unique_lock<std::shared_mutex> lock(s_PacksMutex);
+		s_Packs.push_back(std::move(pack));
+		return true;
+	}
+
+	bool AssetManager::FindPackedFile(const std::string& path, std::span<const char>& outData)
+	{
+		std::shared_lock<std::shared_mutex> lock(s_PacksMutex);
+
+		for (const AssetPack& pack : s_Packs)
+		{
+			if (pack.Find(path, outData))
+				return true;
+		}
+
+		return false;
+	}
+
+	bool AssetManager::FindPreloadedFile(const std::string& path, Ref<const std::vector<char>>& outData)
+	{
+		std::shared_lock<std::shared_mutex> lock(s_PreloadedFilesMutex);
+
+		auto it = s_PreloadedFiles.find(path);
+		if (it == s_PreloadedFiles.end())
+			return false;
+
+		outData = it->second;
+		return true;
+	}
+
+	bool AssetManager::HashFile(const std::string& path, uint64_t& outHash, uint64_t& outSize)
+	{
+		Ref<const std::vector<char>> preloaded;
+		if (!FindPreloadedFile(path, preloaded))
+			return File::HashFile(path, outHash, outSize);
+
+		outHash = Bytes::Hash64(preloaded->data(), preloaded->size());
+		outSize = preloaded->size();
+		return true;
+	}
+
+	Mesh::VertexLayout AssetManager::ChooseVertexLayout(std::span<const Mesh::Vertex> vertices)
+	{
+		if (!s_PackVertices)
+			return Mesh::VertexLayout::Full;
+
+		return Mesh::ChooseVertexLayout(vertices, s_VertexTolerance);
+	}
+
+	void AssetManager::UploadMeshletsAndLods(Mesh& mesh, const MeshAsset::SourceData& source, UploadBatch* batch)
+	{
+		if (s_UploadMeshlets && !source.Meshlets.empty())
+			mesh.UploadMeshlets(source.Meshlets, source.MeshletVertices, source.MeshletTriangles, batch);
+
+		// Source may have more LODs than asked for, indices of the extra ones are stored last and left out
+		uint32_t lodCount = std::min((uint32_t)source.Lods.size(), s_MeshLodCount);
+		if (lodCount > 0 && !source.Indices.empty())
+		{
+			std::span<const Mesh::Lod> lods = source.Lods.subspan(0, lodCount);
+			mesh.UploadLods(lods, source.LodIndices.subspan(0, lods.back().IndexOffset + lods.back().IndexCount), batch);
+		}
+	}
+
+	void AssetManager::EnqueueLoad(PendingLoad&& load, float priority)
+	{
+		std::unique_lock<std::mutex> lock(s_LoadsMutex);
+
+		LoadOrder order{ priority, s_LoadSequence++ };
+		s_PendingLoadOrders[GetLoadKey(load.Handle)] = order;
+		s_PendingLoads.emplace(order, std::move(load));
+
+		lock.unlock();
+
+		DispatchLoads();
+	}
+
+	void AssetManager::DispatchLoads()
+	{
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(s_LoadsMutex);
+			if (s_LoadsInFlight >= s_MaxLoadsInFlight || s_PendingLoads.empty())
+				return;
+
+			auto node = s_PendingLoads.extract(s_PendingLoads.begin());
+			s_PendingLoadOrders.erase(GetLoadKey(node.mapped().Handle));
+			s_LoadsInFlight++;
+			lock.unlock();
+
+			// Cancelled loads give their slot right back to the next one
+			if (!StartLoad(std::move(node.mapped()), node.key().Priority))
+			{
+				lock.lock();
+				s_LoadsInFlight--;
+			}
+		}
+	}
+
+	bool AssetManager::StartLoad(PendingLoad&& load, float priority)
+	{
+		// Every handle could be gone already, there's no point in reading the files then
+		if (!s_Assets.Lock(load.Handle).IsInitialized())
+		{
+			CancelLoad(load);
+			return false;
+		}
+
+		// Handle isn't held while the files are read, so the load can still be cancelled until the task starts
+		Ref<PendingLoad> sharedLoad = std::make_shared<PendingLoad>(std::move(load));
+		ReadAhead(sharedLoad->Files, [sharedLoad, priority]()
+			{
+				AssetHandle handle = s_Assets.Lock(sharedLoad->Handle);
+				if (handle.IsInitialized())
+				{
+					s_TaskPriority = priority;
+					sharedLoad->Task(std::move(handle));
+					s_TaskPriority = std::numeric_limits<float>::lowest();
+				}
+				else
+				{
+					CancelLoad(*sharedLoad);
+				}
 
-		// Immediately remove asset from m_Assets and then destroy everything on separate thread
-		s_AssetsMutex.lock();
+				FinishLoadTask();
+			});
+
+		return true;
+	}
+
+	void AssetManager::FinishLoadTask()
+	{
+		std::unique_lock<std::mutex> lock(s_LoadsMutex);
+		s_LoadsInFlight--;
+		lock.unlock();
+
+		DispatchLoads();
+	}
+
+	void AssetManager::CancelLoad(const PendingLoad& load)
+	{
+		VK_CORE_TRACE("Load of {} cancelled, every handle is gone", load.Path);
+
+		// Nobody can wait on it anymore without a handle, it's resolved anyway so that stray futures don't break
+		load.Promise->set_value();
+	}
+
+	void AssetManager::ReadAhead(const std::vector<std::string>& files, std::function<void()>&& task)
+	{
+		if (files.empty())
+		{
+			s_ThreadPool.PushTask(std::move(task));
+			return;
+		}
+
+		s_FileReader.Read(files, [files, task = std::move(task)](std::vector<Ref<std::vector<char>>> data) mutable
+			{
+				// Runs on the I/O thread, decoding is handed over to the pool right away
+				s_ThreadPool.PushTask([files, data = std::move(data), task = std::move(task)]()
+					{
+						// Files that failed to read are simply read again by the loader, which reports the error.
+						// A file preloaded by another load that's in progress is left as it is
+						std::unique_lock<std::shared_mutex> lock(s_PreloadedFilesMutex);
+						for (size_t i = 0; i < files.size(); i++)
+						{
+							if (data[i] != nullptr)
+								s_PreloadedFiles.emplace(files[i], data[i]);
+						}
+						lock.unlock();
+
+						task();
+
+						lock.lock();
+						for (size_t i = 0; i < files.size(); i++)
+						{
+							auto it = s_PreloadedFiles.find(files[i]);
+							if (it != s_PreloadedFiles.end() && it->second == data[i])
+								s_PreloadedFiles.erase(it);
+						}
+					});
+			});
+	}
+
+	AssetManager::RegistryBenchmarkResult AssetManager::BenchmarkRegistry(uint32_t lookupThreads, uint32_t insertThreads, uint32_t insertsPerThread, uint32_t preloadedCount)
+	{
+		// Assets don't need any data, only their slots are exercised
+		auto acquire = [](const std::string& path)
+		{
+			std::promise<void> promise;
+			promise.set_value();
+
+			AssetWithFuture entry{ promise.get_future(), nullptr, {}, true };
+			bool created = false;
+			return s_Assets.Acquire(path, entry, created);
+		};
+
+		std::vector<AssetHandle> preloaded(std::max(preloadedCount, 1u));
+		for (uint32_t i = 0; i < (uint32_t)preloaded.size(); i++)
+			preloaded[i] = acquire("RegistryBenchmark::Preloaded" + std::to_string(i));
+
+		// Paths are built up front so that the inserting threads only measure the registry
+		std::vector<std::vector<std::string>> paths(insertThreads);
+		std::vector<std::vector<AssetHandle>> inserted(insertThreads);
+		for (uint32_t i = 0; i < insertThreads; i++)
+		{
+			paths[i].reserve(insertsPerThread);
+			inserted[i].reserve(insertsPerThread);
+			for (uint32_t j = 0; j < insertsPerThread; j++)
+				paths[i].push_back("RegistryBenchmark::" + std::to_string(i) + "::" + std::to_string(j));
+		}
 
-		Ref<AssetWithFuture> asset = std::make_shared<AssetWithFuture>(std::move(s_Assets[handle]));
-		s_Assets.erase(handle);
+		std::atomic<bool> stop = false;
+		std::atomic<uint64_t> lookups = 0;
+		std::vector<std::thread> threads;
 
-		s_AssetsMutex.unlock();
-		asset.reset();
+		Timer timer;
+		for (uint32_t i = 0; i < lookupThreads; i++)
+		{
+			threads.emplace_back([&preloaded, &stop, &lookups, i]()
+				{
+					uint64_t count = 0;
+					uint32_t index = i * 7919;
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						for (uint32_t j = 0; j < 64; j++)
+						{
+							index = (index + 1) % (uint32_t)preloaded.size();
+							s_Assets.GetAsset(preloaded[index]);
+						}
+
+						count += 64;
+					}
+
+					lookups.fetch_add(count, std::memory_order_relaxed);
+				});
+		}
+
+		for (uint32_t i = 0; i < insertThreads; i++)
+		{
+			threads.emplace_back([&paths, &inserted, &acquire, i]()
+				{
+					for (const std::string& path : paths[i])
+						inserted[i].push_back(acquire(path));
+				});
+		}
+
+		// Inserting threads are the last ones, lookups run until every one of them is done
+		for (uint32_t i = lookupThreads; i < (uint32_t)threads.size(); i++)
+			threads[i].join();
+
+		stop.store(true, std::memory_order_relaxed);
+		for (uint32_t i = 0; i < lookupThreads; i++)
+			threads[i].join();
+
+		double seconds = std::max((double)timer.ElapsedSeconds(), 1e-9);
+
+		RegistryBenchmarkResult result;
+		result.Lookups = lookups.load();
+		result.Inserts = (uint64_t)insertThreads * insertsPerThread;
+		result.LookupsPerSecond = (double)result.Lookups / seconds;
+		result.InsertsPerSecond = (double)result.Inserts / seconds;
+
+		VK_CORE_INFO("Asset registry: {0} lookup threads {1:.2f} M lookups/s, {2} insert threads {3:.2f} M inserts/s",
+			lookupThreads, result.LookupsPerSecond / 1e6, insertThreads, result.InsertsPerSecond / 1e6);
+
+		for (const std::vector<AssetHandle>& handles : inserted)
+		{
+			for (const AssetHandle& handle : handles)
+				s_Assets.Erase(handle);
+		}
+		for (const AssetHandle& handle : preloaded)
+			s_Assets.Erase(handle);
+
+		return result;
+	}
+
+	void AssetManager::SetMemoryBudget(uint64_t budget)
+	{
+		s_Assets.SetMemoryBudget(budget);
+	}
+
+	void AssetManager::UnloadAsset(const AssetHandle& handle)
+	{
+		VK_CORE_TRACE("Unloading asset: {}", handle.GetAsset()->GetPath());
 
-		//s_ThreadPool.PushTask([](Ref<AssetWithFuture> asset)
-		//	{
-		//		asset.reset();
-		//	}, asset);
+		// Registry retires the slot under its lock and destroys the asset only after the lock is released
+		s_Assets.Erase(handle);
 	}
 
 }
\ No newline at end of file
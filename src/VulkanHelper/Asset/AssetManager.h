@@ -1,17 +1,30 @@
 #pragma once
 #include "pch.h"
+#include <map>
+#include <shared_mutex>
+#include <span>
 
 #include "Asset.h"
 #include "Utility/Utility.h"
 
 #include "AssetImporter.h"
+#include "AssetPack.h"
+#include "AssetRegistry.h"
+#include "TextureStreamer.h"
 
 namespace VulkanHelper
 {
-	struct AssetWithFuture
+	// Assets requested together through AssetManager::LoadAssets
+	struct AssetGroup
 	{
+		std::vector<AssetHandle> Handles;
+
+		// Resolved once every asset of the group is loaded (or unloaded before it finished loading), handles have to
+		// be kept alive until then
 		std::shared_future<void> Future;
-		Scope<Asset> Asset;
+
+		inline bool IsLoaded() const { return Future.wait_for(std::chrono::duration<float>(0)) == std::future_status::ready; }
+		inline void WaitToLoad() const { Future.wait(); }
 	};
 
 	class AssetManager
@@ -20,73 +33,251 @@ namespace VulkanHelper
 		struct CreateInfo
 		{
 			uint32_t ThreadCount = 1;
+
+			// Cook LDR textures into BC7, requires textureCompressionBC device feature
+			bool CompressTextures = false;
+
+			// Bytes of memory that resident assets may use before unreferenced ones start getting evicted.
+			// Assets loaded from files stay cached after their last handle is gone until the budget runs out,
+			// 0 disables caching so assets are unloaded right away.
+			uint64_t MemoryBudget = 0;
+
+			// LDR textures are considered loaded as soon as their mip tail is uploaded, bigger levels are streamed
+			// in afterwards. Requires calling UpdateStreaming once per frame.
+			bool StreamTextures = false;
+
+			// Meshes are uploaded as Mesh::PackedVertex when the precision it loses stays within the tolerance,
+			// which halves their vertex memory. Shaders then have to handle both layouts, see Mesh::GetVertexLayout()
+			bool PackVertices = false;
+			Mesh::PackingTolerance VertexTolerance{};
+
+			// Meshlets of imported models are uploaded next to their vertex and index buffers, see Mesh::UploadMeshlets.
+			// Cooked model caches contain them either way
+			bool UploadMeshlets = false;
+
+			// Simplified LODs generated for every imported mesh, each with about half the triangles of the previous
+			// one, see Mesh::SelectLod. 0 disables them. Model caches cooked with fewer LODs are rebuilt when their
+			// source is available, caches shipped in packs keep the LODs they were cooked with
+			uint32_t MeshLodCount = 0;
+
+			// Packs are searched for files before the disk, in the order they're listed
+			std::vector<std::string> AssetPacks;
+
+			// Files are read on a separate I/O thread before the load task is queued, so that pool threads
+			// only decode. io_uring is used if it's available
+			AsyncFileReader::CreateInfo FileReader{};
 		};
 
-		AssetManager() = delete;
+		static constexpr float DefaultLoadPriority = 0.0f;
+
+		struct RegistryBenchmarkResult
+		{
+			uint64_t Lookups = 0;
+			uint64_t Inserts = 0;
+			double LookupsPerSecond = 0.0;
+			double InsertsPerSecond = 0.0;
+		};
 
-		static AssetHandle CreateHandleFromPath(const std::string& path);
+		AssetManager() = delete;
 
 		static void Init(const CreateInfo& createInfo);
 		static void Destroy();
 
 		static Asset* GetAsset(const AssetHandle& handle);
 		static bool DoesHandleExist(const AssetHandle& handle);
+		static AssetHandle FindAsset(const std::string& path);
 
 		static void WaitToLoad(const AssetHandle& handle);
 		static bool IsAssetLoaded(const AssetHandle& handle);
-		static AssetHandle LoadAsset(const std::string& path);
+		// Settings are used only if the asset isn't loaded yet, otherwise handle to the already loaded asset is returned.
+		// Queued loads with higher priority start first, e.g. assets that are on screen before prefetched ones. Loads
+		// started by another load, like textures of a model, never get lower priority than it. If every handle is gone
+		// before the load starts, it's cancelled.
+		static AssetHandle LoadAsset(const std::string& path, const ImportSettings& settings = {}, float priority = DefaultLoadPriority);
+		static AssetGroup LoadAssets(const std::vector<std::string>& paths, const ImportSettings& settings = {}, float priority = DefaultLoadPriority);
+		// Affects only loads that haven't started yet
+		static void SetLoadPriority(const AssetHandle& handle, float priority);
 		static AssetHandle AddAsset(const std::string& path, std::unique_ptr<Asset>&& asset);
+		static AssetHandle AddAsset(const std::string& path, std::unique_ptr<Asset>&& asset, const std::vector<AssetHandle>& dependencies);
 		static void UnloadAsset(const AssetHandle& handle);
 
+		// Files in packs that are mounted later don't override the ones mounted before
+		static bool MountPack(const std::string& path);
+		// Span points into the pack mapping and stays valid until AssetManager is destroyed
+		static bool FindPackedFile(const std::string& path, std::span<const char>& outData);
+
+		// Files read ahead for loads that are in progress, loaders check them before going to the disk.
+		// They are released once the load finishes, the data stays valid for as long as outData is held
+		static bool FindPreloadedFile(const std::string& path, Ref<const std::vector<char>>& outData);
+		// Same as File::HashFile, but hashes the preloaded copy of the file if there is one
+		static bool HashFile(const std::string& path, uint64_t& outHash, uint64_t& outSize);
+
+		// Layout that meshes created from these vertices are uploaded in, depends on CreateInfo::PackVertices
+		static Mesh::VertexLayout ChooseVertexLayout(std::span<const Mesh::Vertex> vertices);
+		// Uploads the meshlets and LODs of the source data that CreateInfo::UploadMeshlets and MeshLodCount ask for,
+		// mesh has to be initialized already
+		static void UploadMeshletsAndLods(Mesh& mesh, const MeshAsset::SourceData& source, UploadBatch* batch = nullptr);
+
+		// lookupThreads look assets up through their handles for as long as insertThreads keep adding insertsPerThread
+		// new assets, logs the throughput of both. Benchmark assets are unloaded again at the end
+		static RegistryBenchmarkResult BenchmarkRegistry(uint32_t lookupThreads, uint32_t insertThreads, uint32_t insertsPerThread = 100000, uint32_t preloadedCount = 10000);
+
+		static void SetMemoryBudget(uint64_t budget);
+		static inline uint64_t GetMemoryBudget() { return s_Assets.GetMemoryBudget(); }
+		// Memory used by every resident asset, referenced or cached
+		static inline uint64_t GetResidentMemory() { return s_Assets.GetResidentMemory(); }
+
+		// Makes streamed mip levels visible and schedules the next ones, call it outside of a frame
+		static void UpdateStreaming();
+		// Textures with higher priority are streamed first, e.g. based on their screen space size
+		static void SetStreamingPriority(const AssetHandle& texture, float priority);
+		static inline bool IsStreaming() { return s_TextureStreamer.IsStreaming(); }
+
+		// Callback is invoked on the thread that finishes the load, or immediately if the asset is already loaded.
+		// It's meant for short continuations, heavier work should be pushed back onto a thread pool. If the load is
+		// cancelled or the asset unloaded before it finishes, the callback is still invoked, but the handle doesn't
+		// exist anymore then, see DoesHandleExist.
+		static void OnLoaded(const AssetHandle& handle, std::function<void()>&& callback);
+		static void OnLoaded(const std::vector<AssetHandle>& handles, std::function<void()>&& callback);
+
 		static inline bool IsInitialized() { return s_Initialized; }
 
-		// T is list of types of components which to deserialize
+		// T is list of types of components which to deserialize. Queued with the other loads, so priority and
+		// cancellation work the same way as for LoadAsset
 		template<typename... T>
-		static AssetHandle LoadSceneAsset(const std::string& path)
+		static AssetHandle LoadSceneAsset(const std::string& path, float priority = DefaultLoadPriority)
 		{
-			std::hash<std::string> hash;
-			AssetHandle handle(AssetHandle::CreateInfo{ hash(path) });
-			if (s_Assets.contains(handle))
+			priority = std::max(priority, s_TaskPriority);
+
+			std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+
+			AssetWithFuture entry{ promise->get_future(), nullptr, {}, false, true };
+			bool created = false;
+			AssetHandle handle = s_Assets.Acquire(path, entry, created);
+			if (!created)
 			{
-				// Asset with this path is already loaded
-				return AssetHandle(handle);
+				// Asset with this path is already loaded or queued
+				ChangeLoadPriority(handle, priority, true);
+				return handle;
 			}
 
 			VK_CORE_TRACE("Loading asset: {}", path);
 
-			size_t dotPos = path.find_last_of('.');
-			VK_CORE_ASSERT(dotPos != std::string::npos, "Failed to get file extension! Path: {}", path);
-			std::string extension = path.substr(dotPos, path.size() - dotPos);
+			// Scenes are mapped by the serializer, so there's nothing to read ahead for them
+			QueueLoad(path, handle, priority, {}, promise, [](AssetHandle handle, std::string path, std::shared_ptr<std::promise<void>> promise)
+				{
+					Scope<Asset> asset = std::make_unique<SceneAsset>(path, std::move(AssetImporter::ImportScene<T...>(path, &s_ThreadPool)));
+					asset->m_Path = path;
 
-			std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+					s_Assets.SetAsset(handle, std::move(asset));
 
-			std::unique_lock<std::mutex> lock(s_AssetsMutex);
-			s_Assets[handle] = { promise->get_future(), nullptr };
-			lock.unlock();
+					FinishLoading(handle, promise);
+				}, path, promise);
 
-			s_ThreadPool.PushTask([](std::string path, std::shared_ptr<std::promise<void>> promise, AssetHandle handle)
-				{
-					Scope<Asset> asset = std::make_unique<SceneAsset>(path, std::move(AssetImporter::ImportScene<T...>(path)));
-					asset->m_Path = path;
-			
-					std::unique_lock<std::mutex> lock(s_AssetsMutex);
-					s_Assets[handle].Asset = std::move(asset);
-					lock.unlock();
-			
-					promise->set_value();
-				}, path, promise, handle);
-
-			return AssetHandle(handle);
+			return handle;
 		}
-		inline static std::unordered_map<uint64_t, std::atomic<uint32_t>> s_AssetsReferenceCount;
 	private:
+		static void FinishLoading(const AssetHandle& handle, const std::shared_ptr<std::promise<void>>& promise);
+
+		struct PendingLoad
+		{
+			std::string Path;
+
+			// Doesn't hold a reference, so that dropping every handle cancels the load
+			AssetHandle::CreateInfo Handle;
+
+			// Read ahead before the task runs, see FindPreloadedFile
+			std::vector<std::string> Files;
+
+			std::shared_ptr<std::promise<void>> Promise;
+			std::function<void(AssetHandle)> Task;
+		};
+
+		// Higher priority first, loads with the same priority start in the order they were queued
+		struct LoadOrder
+		{
+			float Priority = DefaultLoadPriority;
+			uint64_t Sequence = 0;
+
+			inline bool operator<(const LoadOrder& other) const
+			{
+				return Priority != other.Priority ? Priority > other.Priority : Sequence < other.Sequence;
+			}
+		};
 
-		inline static std::unordered_map<AssetHandle, AssetWithFuture> s_Assets;
+		// Task is invoked on the thread pool with a handle to the asset as its first argument, followed by args
+		template<typename T, typename ...Args>
+		static void QueueLoad(const std::string& path, const AssetHandle& handle, float priority, std::vector<std::string>&& files,
+			const std::shared_ptr<std::promise<void>>& promise, T&& task, Args&& ... args)
+		{
+			EnqueueLoad({ path, { handle.GetIndex(), handle.GetGeneration() }, std::move(files), promise,
+				std::bind(std::forward<T>(task), std::placeholders::_1, std::forward<Args>(args)...) }, priority);
+		}
+		// Same as AssetHandle::Hash
+		static inline uint64_t GetLoadKey(const AssetHandle::CreateInfo& handle) { return ((uint64_t)handle.Generation << 32) | (uint64_t)handle.Index; }
+		static void EnqueueLoad(PendingLoad&& load, float priority);
+		static void ChangeLoadPriority(const AssetHandle& handle, float priority, bool raiseOnly);
+		// Starts queued loads for as long as there are free slots
+		static void DispatchLoads();
+		// Returns false if the load was cancelled
+		static bool StartLoad(PendingLoad&& load, float priority);
+		static void FinishLoadTask();
+		static void CancelLoad(const PendingLoad& load);
+
+		static void ReadAhead(const std::vector<std::string>& files, std::function<void()>&& task);
+
+		inline static AssetRegistry s_Assets;
 		inline static ThreadPool s_ThreadPool;
-		inline static std::mutex s_AssetsMutex;
+		inline static TextureStreamer s_TextureStreamer;
+		inline static std::vector<AssetPack> s_Packs;
+		inline static std::shared_mutex s_PacksMutex;
+		inline static AsyncFileReader s_FileReader;
+		inline static std::unordered_map<std::string, Ref<const std::vector<char>>> s_PreloadedFiles;
+		inline static std::shared_mutex s_PreloadedFilesMutex;
+
+		// Only a few loads are started at once, the rest wait here so that new ones with higher priority can
+		// still get ahead of them. Loads are looked up by the hash of their handle for priority changes
+		inline static std::mutex s_LoadsMutex;
+		inline static std::map<LoadOrder, PendingLoad> s_PendingLoads;
+		inline static std::unordered_map<uint64_t, LoadOrder> s_PendingLoadOrders;
+		inline static uint64_t s_LoadSequence = 0;
+		inline static uint32_t s_LoadsInFlight = 0;
+		inline static uint32_t s_MaxLoadsInFlight = 0;
+
+		// Priority of the load that the thread is running right now
+		inline static thread_local float s_TaskPriority = std::numeric_limits<float>::lowest();
+		inline static bool s_CompressTextures = false;
+		inline static bool s_StreamTextures = false;
+		inline static bool s_PackVertices = false;
+		inline static Mesh::PackingTolerance s_VertexTolerance{};
+		inline static bool s_UploadMeshlets = false;
+		inline static uint32_t s_MeshLodCount = 0;
 
 		inline static bool s_Initialized = false;
 
 		friend class AssetImporter;
+		friend class ModelCache;
+		friend class AssetHandle;
+	};
+
+	/**
+	 * @brief Reference to an asset loaded from a file that doesn't keep it resident. Until it's locked the asset
+	 * counts as unreferenced, so it can be evicted when the memory budget runs out. Lock() hands out the cached
+	 * asset if it's still resident and transparently loads it again otherwise.
+	 */
+	class SoftAssetHandle
+	{
+	public:
+		SoftAssetHandle() = default;
+		SoftAssetHandle(const std::string& path, const ImportSettings& settings = {})
+			: m_Path(path), m_Settings(settings) {}
+
+		inline AssetHandle Lock(float priority = AssetManager::DefaultLoadPriority) const { return AssetManager::LoadAsset(m_Path, m_Settings, priority); }
+
+		inline const std::string& GetPath() const { return m_Path; }
+		inline bool IsInitialized() const { return !m_Path.empty(); }
+	private:
+		std::string m_Path = "";
+		ImportSettings m_Settings{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "pch.h"
+#include "AssetPack.h"
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		// File data is aligned so that cooked caches inside of the pack can be read in place
+		constexpr uint64_t DataAlignment = 16;
+
+		struct Header
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint64_t FileSize;
+			uint64_t EntryCount;
+			uint64_t EntriesOffset;
+			uint64_t StringsOffset;
+			uint64_t StringsSize;
+		};
+
+		uint64_t Align(uint64_t value)
+		{
+			return (value + DataAlignment - 1) & ~(DataAlignment - 1);
+		}
+
+		uint64_t HashPath(std::string_view path)
+		{
+			return Bytes::Hash64(path.data(), path.size());
+		}
+	}
+
+	AssetPack::~AssetPack()
+	{
+		Destroy();
+	}
+
+	bool AssetPack::Init(const CreateInfo& createInfo)
+	{
+		if (m_Initialized)
+			Destroy();
+
+		MappedFile file;
+		if (!file.Init({ createInfo.Filepath }))
+			return false;
+
+		const char* data = file.GetData();
+		const uint64_t fileSize = file.GetSize();
+
+		auto inRange = [fileSize](uint64_t offset, uint64_t size)
+		{
+			return offset <= fileSize && size <= fileSize - offset;
+		};
+
+		if (!inRange(0, sizeof(Header)))
+			return false;
+
+		Header header;
+		memcpy(&header, data, sizeof(Header));
+
+		if (header.Magic != Magic || header.Version != Version || header.FileSize != fileSize
+			|| header.EntryCount > fileSize / sizeof(Entry) || header.EntriesOffset % alignof(Entry) != 0
+			|| !inRange(header.EntriesOffset, header.EntryCount * sizeof(Entry)) || !inRange(header.StringsOffset, header.StringsSize))
+		{
+			VK_CORE_ERROR("Asset pack {0} is invalid or from a different version", createInfo.Filepath);
+			return false;
+		}
+
+		std::span<const Entry> entries((const Entry*)(data + header.EntriesOffset), (size_t)header.EntryCount);
+		for (const Entry& entry : entries)
+		{
+			if (!inRange(entry.Offset, entry.Size) || (uint64_t)entry.PathOffset + entry.PathSize > header.StringsSize)
+			{
+				VK_CORE_ERROR("Asset pack {0} is corrupted", createInfo.Filepath);
+				return false;
+			}
+		}
+
+		m_Entries = entries;
+		m_Strings = std::string_view(data + header.StringsOffset, (size_t)header.StringsSize);
+		m_File = std::move(file);
+		m_Filepath = createInfo.Filepath;
+
+		m_Initialized = true;
+		return true;
+	}
+
+	void AssetPack::Destroy()
+	{
+		if (!m_Initialized)
+			return;
+
+		m_File.Destroy();
+
+		Reset();
+	}
+
+	AssetPack::AssetPack(AssetPack&& other) noexcept
+	{
+		m_File = std::move(other.m_File);
+		m_Filepath = std::move(other.m_Filepath);
+		m_Entries = other.m_Entries;
+		m_Strings = other.m_Strings;
+		m_Initialized = other.m_Initialized;
+
+		other.Reset();
+	}
+
+	AssetPack& AssetPack::operator=(AssetPack&& other) noexcept
+	{
+		if (this == &other)
+			return *this;
+
+		Destroy();
+
+		m_File = std::move(other.m_File);
+		m_Filepath = std::move(other.m_Filepath);
+		m_Entries = other.m_Entries;
+		m_Strings = other.m_Strings;
+		m_Initialized = other.m_Initialized;
+
+		other.Reset();
+
+		return *this;
+	}
+
+	bool AssetPack::Find(const std::string& path, std::span<const char>& outData) const
+	{
+		if (!m_Initialized)
+			return false;
+
+		std::string normalized = NormalizePath(path);
+		uint64_t hash = HashPath(normalized);
+
+		auto iter = std::lower_bound(m_Entries.begin(), m_Entries.end(), hash, [](const Entry& entry, uint64_t hash) { return entry.PathHash < hash; });
+
+		// Paths are compared as well, so hash collisions only cost a few extra comparisons
+		for (; iter != m_Entries.end() && iter->PathHash == hash; iter++)
+		{
+			if (m_Strings.substr(iter->PathOffset, iter->PathSize) == normalized)
+			{
+				outData = { m_File.GetData() + iter->Offset, (size_t)iter->Size };
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool AssetPack::Build(const std::string& packPath, const std::vector<std::string>& paths)
+	{
+		std::vector<std::string> files;
+		for (const std::string& path : paths)
+		{
+			if (std::filesystem::is_directory(path))
+			{
+				for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+				{
+					if (entry.is_regular_file())
+						files.push_back(NormalizePath(entry.path().generic_string()));
+				}
+			}
+			else
+			{
+				files.push_back(NormalizePath(path));
+			}
+		}
+
+		std::sort(files.begin(), files.end());
+		files.erase(std::unique(files.begin(), files.end()), files.end());
+
+		// Files are only mapped one at a time while writing, mapping all of them at once runs out of file descriptors
+		std::vector<Entry> entries(files.size());
+		std::string strings;
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			std::error_code error;
+			uint64_t size = std::filesystem::file_size(files[i], error);
+			if (error)
+			{
+				VK_CORE_ERROR("Failed to open {0} while building asset pack {1}", files[i], packPath);
+				return false;
+			}
+
+			entries[i] = {};
+			entries[i].PathHash = HashPath(files[i]);
+			entries[i].Size = size;
+			entries[i].PathOffset = (uint32_t)strings.size();
+			entries[i].PathSize = (uint32_t)files[i].size();
+			strings += files[i];
+		}
+
+		Header header{};
+		header.Magic = Magic;
+		header.Version = Version;
+		header.EntryCount = entries.size();
+		header.EntriesOffset = Align(sizeof(Header));
+		header.StringsOffset = header.EntriesOffset + entries.size() * sizeof(Entry);
+		header.StringsSize = strings.size();
+
+		// Data is laid out in path order so that files of the same directory end up next to each other
+		uint64_t offset = Align(header.StringsOffset + header.StringsSize);
+		for (Entry& entry : entries)
+		{
+			entry.Offset = offset;
+			offset = Align(offset + entry.Size);
+		}
+		header.FileSize = offset;
+
+		// Table of contents is sorted by hash, entries still point to the data written in path order
+		std::vector<uint32_t> order(entries.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::vector<Entry> sortedEntries(entries.size());
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return entries[a].PathHash < entries[b].PathHash; });
+		for (size_t i = 0; i < order.size(); i++)
+			sortedEntries[i] = entries[order[i]];
+
+		if (std::filesystem::path(packPath).has_parent_path())
+			std::filesystem::create_directories(std::filesystem::path(packPath).parent_path());
+
+		// Write into temporary file first so that a crash mid way never leaves a broken pack behind
+		std::string tempPath = packPath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				VK_CORE_ERROR("Failed to write asset pack {0}", packPath);
+				return false;
+			}
+
+			const char zeros[DataAlignment] = {};
+			auto pad = [&]()
+			{
+				uint64_t position = (uint64_t)file.tellp();
+				file.write(zeros, Align(position) - position);
+			};
+
+			file.write((const char*)&header, sizeof(Header));
+			pad();
+			file.write((const char*)sortedEntries.data(), sortedEntries.size() * sizeof(Entry));
+			file.write(strings.data(), strings.size());
+			pad();
+
+			for (size_t i = 0; i < files.size(); i++)
+			{
+				// Size is checked again in case the file changed since the table of contents was built
+				MappedFile mappedFile;
+				if (!mappedFile.Init({ files[i] }) || mappedFile.GetSize() != entries[i].Size)
+				{
+					VK_CORE_ERROR("Failed to read {0} while building asset pack {1}", files[i], packPath);
+					file.close();
+					std::error_code error;
+					std::filesystem::remove(tempPath, error);
+					return false;
+				}
+
+				file.write(mappedFile.GetData(), mappedFile.GetSize());
+				pad();
+			}
+
+			if (!file.good())
+			{
+				VK_CORE_ERROR("Failed to write asset pack {0}", packPath);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, packPath, error);
+		if (error)
+		{
+			VK_CORE_ERROR("Failed to write asset pack {0}: {1}", packPath, error.message());
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		VK_CORE_INFO("Built asset pack {0} with {1} files", packPath, files.size());
+		return true;
+	}
+
+	std::string AssetPack::NormalizePath(const std::string& path)
+	{
+		std::string normalized = path;
+		std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+		while (normalized.rfind("./", 0) == 0)
+			normalized.erase(0, 2);
+
+		return normalized;
+	}
+
+	void AssetPack::Reset()
+	{
+		m_Filepath = "";
+		m_Entries = {};
+		m_Strings = {};
+		m_Initialized = false;
+	}
+}
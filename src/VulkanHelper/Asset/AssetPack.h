@@ -0,0 +1,69 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+#include "Utility/Utility.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Read only archive of asset files. Table of contents holds the hashes of the file paths sorted, so looking
+	 * a file up is a binary search, and the whole pack is memory mapped once. Files are handed out as spans pointing
+	 * straight into the mapping, nothing is opened or copied per file.
+	 *
+	 * Paths are stored normalized (forward slashes, no leading "./"), exactly as they're passed to AssetManager::LoadAsset.
+	 */
+	class AssetPack
+	{
+	public:
+		static constexpr uint32_t Magic = 0x50414856; // "VHAP"
+		static constexpr uint32_t Version = 1;
+
+		struct CreateInfo
+		{
+			std::string Filepath = "";
+		};
+
+		AssetPack() = default;
+		~AssetPack();
+
+		// Returns false if the file doesn't exist or isn't a valid pack
+		[[nodiscard]] bool Init(const CreateInfo& createInfo);
+		void Destroy();
+
+		AssetPack(const AssetPack& other) = delete;
+		AssetPack& operator=(const AssetPack& other) = delete;
+		AssetPack(AssetPack&& other) noexcept;
+		AssetPack& operator=(AssetPack&& other) noexcept;
+
+		// Span stays valid for as long as the pack is initialized
+		bool Find(const std::string& path, std::span<const char>& outData) const;
+
+		inline const std::string& GetFilepath() const { return m_Filepath; }
+		inline uint32_t GetFileCount() const { return (uint32_t)m_Entries.size(); }
+		inline bool IsInitialized() const { return m_Initialized; }
+
+		// Packs every file under its path, directories are added recursively. Returns false if writing failed.
+		static bool Build(const std::string& packPath, const std::vector<std::string>& paths);
+
+		static std::string NormalizePath(const std::string& path);
+	private:
+		struct Entry
+		{
+			uint64_t PathHash;
+			uint64_t Offset;
+			uint64_t Size;
+			uint32_t PathOffset;
+			uint32_t PathSize;
+		};
+
+		MappedFile m_File;
+		std::string m_Filepath = "";
+		std::span<const Entry> m_Entries;
+		std::string_view m_Strings;
+
+		bool m_Initialized = false;
+
+		void Reset();
+	};
+}
@@ -0,0 +1,410 @@
+#include "pch.h"
+#include "AssetRegistry.h"
+
+namespace VulkanHelper
+{
+	AssetRegistry::~AssetRegistry()
+	{
+		Clear();
+
+		for (auto& chunk : m_Chunks)
+		{
+			delete[] chunk.load(std::memory_order_relaxed);
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	AssetHandle AssetRegistry::Acquire(const std::string& path, AssetWithFuture& asset, bool& outCreated)
+	{
+		// Declared before the lock so that evicted assets are destroyed after it's released
+		std::vector<AssetWithFuture> evicted;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		auto iter = m_PathToIndex.find(path);
+		if (iter != m_PathToIndex.end())
+		{
+			outCreated = false;
+			return CreateHandle(iter->second);
+		}
+
+		uint32_t index = AllocateSlot();
+		Slot& slot = GetSlot(index);
+
+		uint32_t generation;
+		{
+			std::unique_lock<std::shared_mutex> stripeLock(GetStripe(index));
+			slot.Entry = std::move(asset);
+			generation = slot.Generation.fetch_add(1, std::memory_order_release) + 1;
+
+			if (slot.Entry.Asset)
+			{
+				slot.Entry.Asset->m_HandleInfo = { index, generation };
+				TrackMemory(slot);
+			}
+		}
+
+		slot.Path = path;
+		m_PathToIndex[path] = index;
+		m_LiveCount++;
+
+		EvictOverBudget(evicted);
+
+		outCreated = true;
+		return AssetHandle(AssetHandle::CreateInfo{ index, generation });
+	}
+
+	AssetHandle AssetRegistry::Find(const std::string& path)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		auto iter = m_PathToIndex.find(path);
+		if (iter == m_PathToIndex.end())
+			return AssetHandle();
+
+		return CreateHandle(iter->second);
+	}
+
+	AssetHandle AssetRegistry::Lock(const AssetHandle::CreateInfo& handleInfo)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		if (GetSlot(handleInfo.Index).Generation.load(std::memory_order_relaxed) != handleInfo.Generation)
+			return AssetHandle();
+
+		return CreateHandle(handleInfo.Index);
+	}
+
+	void AssetRegistry::AddReference(uint32_t index)
+	{
+		// Caller always holds a reference already (or the registry lock), so the slot can't be recycled here
+		GetSlot(index).ReferenceCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void AssetRegistry::RemoveReference(uint32_t index, uint32_t generation)
+	{
+		Slot& slot = GetSlot(index);
+		if (slot.ReferenceCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		AssetWithFuture entry;
+		std::vector<AssetWithFuture> evicted;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		// The asset could have been acquired again by path before the lock was taken
+		// or the slot could have been already released (or cached) by another thread
+		if (slot.ReferenceCount.load(std::memory_order_acquire) != 0 || slot.InFreeList || slot.InCache)
+			return;
+
+		// If the generation doesn't match the asset was unloaded explicitly and only the slot is left to free
+		if (slot.Generation.load(std::memory_order_relaxed) == generation)
+		{
+			bool cacheable = false;
+			if (m_MemoryBudget.load(std::memory_order_relaxed) != 0)
+			{
+				std::shared_lock<std::shared_mutex> stripeLock(GetStripe(index));
+				cacheable = slot.Entry.Reloadable && slot.Entry.Loaded;
+			}
+
+			if (cacheable)
+			{
+				// Keep the asset resident, it's either handed out again or evicted once the budget runs out
+				slot.CacheIterator = m_Cache.insert(m_Cache.end(), index);
+				slot.InCache = true;
+
+				EvictOverBudget(evicted);
+				lock.unlock();
+				return;
+			}
+
+			entry = RetireSlot(index);
+		}
+
+		slot.InFreeList = true;
+		m_FreeList.push_back(index);
+
+		lock.unlock();
+
+		// Load was cancelled, whoever waits on it would never be resolved otherwise
+		ResolveContinuations(entry);
+
+		// Entry is destroyed here, outside of the lock, because destroying an asset releases the handles it holds
+	}
+
+	bool AssetRegistry::Contains(const AssetHandle& handle)
+	{
+		return GetSlot(handle.GetIndex()).Generation.load(std::memory_order_acquire) == handle.GetGeneration();
+	}
+
+	Asset* AssetRegistry::GetAsset(const AssetHandle& handle)
+	{
+		Slot& slot = GetSlot(handle.GetIndex());
+		std::shared_lock<std::shared_mutex> lock(GetStripe(handle.GetIndex()));
+
+		VK_CORE_ASSERT(slot.Generation.load(std::memory_order_relaxed) == handle.GetGeneration(), "Asset handle is stale!");
+
+		return slot.Entry.Asset.get();
+	}
+
+	bool AssetRegistry::GetFuture(const AssetHandle& handle, std::shared_future<void>& outFuture)
+	{
+		Slot& slot = GetSlot(handle.GetIndex());
+		std::shared_lock<std::shared_mutex> lock(GetStripe(handle.GetIndex()));
+
+		if (slot.Generation.load(std::memory_order_relaxed) != handle.GetGeneration())
+			return false;
+
+		// Copy the future so that the caller can wait on it without holding the lock
+		outFuture = slot.Entry.Future;
+		return true;
+	}
+
+	void AssetRegistry::SetAsset(const AssetHandle& handle, Scope<Asset>&& asset)
+	{
+		Slot& slot = GetSlot(handle.GetIndex());
+		std::unique_lock<std::shared_mutex> lock(GetStripe(handle.GetIndex()));
+
+		// Asset was unloaded before it finished loading, drop it after the lock is released
+		if (slot.Generation.load(std::memory_order_relaxed) != handle.GetGeneration())
+		{
+			lock.unlock();
+			asset.reset();
+			return;
+		}
+
+		asset->m_HandleInfo = { handle.GetIndex(), handle.GetGeneration() };
+		slot.Entry.Asset = std::move(asset);
+		TrackMemory(slot);
+
+		lock.unlock();
+
+		uint64_t budget = m_MemoryBudget.load(std::memory_order_relaxed);
+		if (budget != 0 && m_ResidentMemory.load(std::memory_order_relaxed) > budget)
+		{
+			std::vector<AssetWithFuture> evicted;
+
+			std::unique_lock<std::mutex> registryLock(m_Mutex);
+			EvictOverBudget(evicted);
+			registryLock.unlock();
+		}
+	}
+
+	bool AssetRegistry::AddContinuation(const AssetHandle& handle, std::function<void()>&& continuation)
+	{
+		Slot& slot = GetSlot(handle.GetIndex());
+		std::unique_lock<std::shared_mutex> lock(GetStripe(handle.GetIndex()));
+
+		if (slot.Generation.load(std::memory_order_relaxed) != handle.GetGeneration() || slot.Entry.Loaded)
+			return false;
+
+		slot.Entry.Continuations.push_back(std::move(continuation));
+		return true;
+	}
+
+	void AssetRegistry::MarkLoaded(const AssetHandle& handle, std::vector<std::function<void()>>& outContinuations)
+	{
+		Slot& slot = GetSlot(handle.GetIndex());
+		std::unique_lock<std::shared_mutex> lock(GetStripe(handle.GetIndex()));
+
+		if (slot.Generation.load(std::memory_order_relaxed) != handle.GetGeneration())
+			return;
+
+		slot.Entry.Loaded = true;
+		outContinuations.swap(slot.Entry.Continuations);
+	}
+
+	bool AssetRegistry::Erase(const AssetHandle& handle)
+	{
+		AssetWithFuture entry;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		if (GetSlot(handle.GetIndex()).Generation.load(std::memory_order_relaxed) != handle.GetGeneration())
+			return false;
+
+		// Slot goes back to the free list once the last handle pointing to it is destroyed
+		entry = RetireSlot(handle.GetIndex());
+
+		lock.unlock();
+
+		ResolveContinuations(entry);
+
+		return true;
+	}
+
+	void AssetRegistry::Clear()
+	{
+		// Destroyed assets can release other assets so keep going until every slot is retired
+		while (true)
+		{
+			std::vector<AssetWithFuture> entries;
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			for (uint32_t i = 0; i < m_SlotCount; i++)
+			{
+				if (GetSlot(i).Generation.load(std::memory_order_relaxed) % 2 == 1)
+					entries.push_back(RetireSlot(i));
+			}
+			lock.unlock();
+
+			if (entries.empty())
+				break;
+
+			for (AssetWithFuture& entry : entries)
+			{
+				ResolveContinuations(entry);
+			}
+
+			entries.clear();
+		}
+	}
+
+	size_t AssetRegistry::GetSize()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		return m_LiveCount;
+	}
+
+	void AssetRegistry::SetMemoryBudget(uint64_t budget)
+	{
+		std::vector<AssetWithFuture> evicted;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_MemoryBudget.store(budget, std::memory_order_relaxed);
+
+		if (budget == 0)
+		{
+			// Caching is disabled, drop everything that isn't referenced anymore
+			while (!m_Cache.empty())
+				evicted.push_back(RetireSlot(m_Cache.front()));
+		}
+		else
+		{
+			EvictOverBudget(evicted);
+		}
+
+		lock.unlock();
+	}
+
+	size_t AssetRegistry::GetCachedCount()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		return m_Cache.size();
+	}
+
+	AssetRegistry::Slot& AssetRegistry::GetSlot(uint32_t index)
+	{
+		Slot* chunk = m_Chunks[index / SlotsPerChunk].load(std::memory_order_acquire);
+		return chunk[index % SlotsPerChunk];
+	}
+
+	uint32_t AssetRegistry::AllocateSlot()
+	{
+		if (!m_FreeList.empty())
+		{
+			uint32_t index = m_FreeList.back();
+			m_FreeList.pop_back();
+
+			GetSlot(index).InFreeList = false;
+			return index;
+		}
+
+		uint32_t index = m_SlotCount;
+		VK_CORE_ASSERT(index < SlotsPerChunk * MaxChunks, "Exceeded maximum asset count!");
+
+		if (index % SlotsPerChunk == 0)
+			m_Chunks[index / SlotsPerChunk].store(new Slot[SlotsPerChunk], std::memory_order_release);
+
+		m_SlotCount++;
+		return index;
+	}
+
+	AssetWithFuture AssetRegistry::RetireSlot(uint32_t index)
+	{
+		Slot& slot = GetSlot(index);
+
+		AssetWithFuture entry;
+		{
+			std::unique_lock<std::shared_mutex> stripeLock(GetStripe(index));
+			entry = std::move(slot.Entry);
+			slot.Entry = {};
+
+			m_ResidentMemory.fetch_sub(slot.MemorySize, std::memory_order_relaxed);
+			slot.MemorySize = 0;
+
+			// Even generation marks the slot as retired, every handle pointing to it is stale from now on
+			slot.Generation.fetch_add(1, std::memory_order_release);
+		}
+
+		m_PathToIndex.erase(slot.Path);
+		slot.Path.clear();
+		m_LiveCount--;
+
+		// Cached slots have no handles left that would free them, so they go back to the free list right away
+		if (slot.InCache)
+		{
+			m_Cache.erase(slot.CacheIterator);
+			slot.InCache = false;
+
+			slot.InFreeList = true;
+			m_FreeList.push_back(index);
+		}
+
+		return entry;
+	}
+
+	void AssetRegistry::ResolveContinuations(AssetWithFuture& entry)
+	{
+		// Only slots that never finished loading have any, e.g. groups from LoadAssets or models waiting on their meshes
+		std::vector<std::function<void()>> continuations = std::move(entry.Continuations);
+		entry.Continuations.clear();
+
+		for (auto& continuation : continuations)
+		{
+			continuation();
+		}
+	}
+
+	AssetHandle AssetRegistry::CreateHandle(uint32_t index)
+	{
+		// Handle is created under the lock so that the slot can't be released in the meantime
+		Slot& slot = GetSlot(index);
+		AssetHandle handle(AssetHandle::CreateInfo{ index, slot.Generation.load(std::memory_order_relaxed) });
+
+		// Referenced again, so it can't be evicted anymore
+		if (slot.InCache)
+		{
+			m_Cache.erase(slot.CacheIterator);
+			slot.InCache = false;
+		}
+
+		return handle;
+	}
+
+	void AssetRegistry::EvictOverBudget(std::vector<AssetWithFuture>& outEntries)
+	{
+		uint64_t budget = m_MemoryBudget.load(std::memory_order_relaxed);
+		if (budget == 0)
+			return;
+
+		// Memory of evicted assets is released once the entries are destroyed, not when they're retired here,
+		// but m_ResidentMemory already doesn't count them so the loop ends at the right spot
+		while (m_ResidentMemory.load(std::memory_order_relaxed) > budget && !m_Cache.empty())
+		{
+			uint32_t index = m_Cache.front();
+			VK_CORE_TRACE("Evicting asset: {}", GetSlot(index).Path);
+
+			outEntries.push_back(RetireSlot(index));
+		}
+	}
+
+	void AssetRegistry::TrackMemory(Slot& slot)
+	{
+		uint64_t size = slot.Entry.Asset ? slot.Entry.Asset->GetMemorySize() : 0;
+
+		m_ResidentMemory.fetch_add(size, std::memory_order_relaxed);
+		m_ResidentMemory.fetch_sub(slot.MemorySize, std::memory_order_relaxed);
+		slot.MemorySize = size;
+	}
+}
\ No newline at end of file
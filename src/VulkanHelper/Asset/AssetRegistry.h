@@ -0,0 +1,142 @@
+#pragma once
+#include "pch.h"
+#include <future>
+#include <list>
+#include <shared_mutex>
+
+#include "Asset.h"
+#include "Utility/Utility.h"
+
+namespace VulkanHelper
+{
+	struct AssetWithFuture
+	{
+		std::shared_future<void> Future;
+		Scope<Asset> Asset;
+
+		// Callbacks waiting for the asset to finish loading
+		std::vector<std::function<void()>> Continuations;
+		bool Loaded = false;
+
+		// Asset was loaded from its path and can be loaded again, so it may stay cached after its last handle is gone
+		bool Reloadable = false;
+	};
+
+	/**
+	 * @brief Thread safe generational slot map of assets. AssetHandle is an index into a dense slot array plus
+	 * the generation of the slot at the time the handle was created. Every slot has an intrusive reference count
+	 * so copying and destroying handles is a single atomic operation with no hashing involved.
+	 *
+	 * Live slots always have an odd generation. Unloading a slot bumps its generation so handles that still point
+	 * to it become stale and are detected on lookup. The slot itself is recycled only after its last handle is gone.
+	 *
+	 * Asset data of the slots is guarded by lock stripes, lookups take only a shared lock of a single stripe so readers
+	 * never block each other and only wait on a loader thread if it happens to write into the very same stripe.
+	 *
+	 * With a memory budget set, reloadable assets aren't unloaded when their last handle is gone. They stay resident
+	 * in an LRU list and are handed out again if their path is requested, until memory used by all resident assets
+	 * exceeds the budget. Least recently released assets are evicted first, referenced ones are never evicted.
+	 */
+	class AssetRegistry
+	{
+	public:
+		static constexpr uint32_t StripeCount = 32;
+		static constexpr uint32_t SlotsPerChunk = 1024;
+		static constexpr uint32_t MaxChunks = 4096;
+
+		AssetRegistry() = default;
+		~AssetRegistry();
+
+		AssetRegistry(const AssetRegistry& other) = delete;
+		AssetRegistry(AssetRegistry&& other) noexcept = delete;
+		AssetRegistry& operator=(const AssetRegistry& other) = delete;
+		AssetRegistry& operator=(AssetRegistry&& other) noexcept = delete;
+
+		// Returns handle to the asset registered under the path. If there is none, new slot is created and
+		// the asset is moved into it, outCreated tells which of these happened.
+		AssetHandle Acquire(const std::string& path, AssetWithFuture& asset, bool& outCreated);
+		AssetHandle Find(const std::string& path);
+		// Turns index and generation back into a handle, returns an uninitialized one if the slot was retired since
+		AssetHandle Lock(const AssetHandle::CreateInfo& handleInfo);
+
+		void AddReference(uint32_t index);
+		void RemoveReference(uint32_t index, uint32_t generation);
+
+		bool Contains(const AssetHandle& handle);
+		Asset* GetAsset(const AssetHandle& handle);
+		bool GetFuture(const AssetHandle& handle, std::shared_future<void>& outFuture);
+
+		void SetAsset(const AssetHandle& handle, Scope<Asset>&& asset);
+
+		// Returns false if the asset is already loaded (or gone), in that case the continuation isn't stored.
+		// If the slot is retired before the asset finishes loading, because the load got cancelled or the asset
+		// unloaded, waiting continuations are invoked anyway, after the registry locks are released. They can tell
+		// the two cases apart by checking whether the handle still exists
+		bool AddContinuation(const AssetHandle& handle, std::function<void()>&& continuation);
+		void MarkLoaded(const AssetHandle& handle, std::vector<std::function<void()>>& outContinuations);
+		bool Erase(const AssetHandle& handle);
+		void Clear();
+
+		size_t GetSize();
+
+		// 0 disables caching, assets are unloaded as soon as their last handle is gone
+		void SetMemoryBudget(uint64_t budget);
+		inline uint64_t GetMemoryBudget() const { return m_MemoryBudget.load(std::memory_order_relaxed); }
+		inline uint64_t GetResidentMemory() const { return m_ResidentMemory.load(std::memory_order_relaxed); }
+		size_t GetCachedCount();
+
+	private:
+		struct Slot
+		{
+			std::atomic<uint32_t> Generation = 0;
+			std::atomic<uint32_t> ReferenceCount = 0;
+
+			// Guarded by stripe lock
+			AssetWithFuture Entry;
+			uint64_t MemorySize = 0;
+
+			// Guarded by m_Mutex
+			std::string Path;
+			bool InFreeList = false;
+			bool InCache = false;
+			std::list<uint32_t>::iterator CacheIterator;
+		};
+
+		struct alignas(64) Stripe
+		{
+			std::shared_mutex Mutex;
+		};
+
+		Slot& GetSlot(uint32_t index);
+		inline std::shared_mutex& GetStripe(uint32_t index) { return m_Stripes[index % StripeCount].Mutex; }
+
+		uint32_t AllocateSlot();
+		AssetWithFuture RetireSlot(uint32_t index);
+		// Invokes continuations that were still waiting on a retired slot, has to be called without any lock held
+		static void ResolveContinuations(AssetWithFuture& entry);
+
+		// Both have to be called with m_Mutex held
+		AssetHandle CreateHandle(uint32_t index);
+		void EvictOverBudget(std::vector<AssetWithFuture>& outEntries);
+
+		// Called with the stripe lock of the slot held
+		void TrackMemory(Slot& slot);
+
+		// Chunks are never moved or freed while the registry is alive so slot references stay valid without locking
+		std::array<std::atomic<Slot*>, MaxChunks> m_Chunks{};
+		std::array<Stripe, StripeCount> m_Stripes;
+
+		// Guards slot allocation and the path lookup
+		std::mutex m_Mutex;
+		std::unordered_map<std::string, uint32_t> m_PathToIndex;
+		std::vector<uint32_t> m_FreeList;
+		uint32_t m_SlotCount = 0;
+		size_t m_LiveCount = 0;
+
+		// Unreferenced resident slots, least recently released at the front
+		std::list<uint32_t> m_Cache;
+
+		std::atomic<uint64_t> m_MemoryBudget = 0;
+		std::atomic<uint64_t> m_ResidentMemory = 0;
+	};
+}
\ No newline at end of file
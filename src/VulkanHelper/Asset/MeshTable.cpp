@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "MeshTable.h"
+#include "AssetManager.h"
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		// Vertex data is aligned in the file so that it's copied out from aligned addresses
+		constexpr uint64_t DataAlignment = 16;
+
+		// Vertex, index, meshlet, meshlet vertex, meshlet triangle, LOD and LOD index count, stored before the data of every mesh
+		constexpr size_t MeshCountsSize = 7;
+
+		uint64_t Align(uint64_t value)
+		{
+			return (value + DataAlignment - 1) & ~(DataAlignment - 1);
+		}
+
+		// Storage of the meshes read from a table, shared by their MeshAssets
+		struct OwnedMesh
+		{
+			std::vector<Mesh::Vertex> Vertices;
+			std::vector<uint32_t> Indices;
+			Mesh::MeshletData Meshlets;
+			std::vector<Mesh::Lod> Lods;
+			std::vector<uint32_t> LodIndices;
+		};
+
+		// Meshlets and LODs go to the GPU as they are, so everything they point to has to be in range
+		bool IsValid(const OwnedMesh& mesh)
+		{
+			if (mesh.Indices.size() % 3 != 0)
+				return false;
+
+			for (uint32_t index : mesh.Indices)
+			{
+				if (index >= mesh.Vertices.size())
+					return false;
+			}
+
+			for (const Mesh::Meshlet& meshlet : mesh.Meshlets.Meshlets)
+			{
+				if (meshlet.VertexCount > Mesh::MaxMeshletVertices || meshlet.TriangleCount > Mesh::MaxMeshletTriangles
+					|| (uint64_t)meshlet.VertexOffset + meshlet.VertexCount > mesh.Meshlets.Vertices.size()
+					|| (uint64_t)meshlet.TriangleOffset + meshlet.TriangleCount * 3 > mesh.Meshlets.Triangles.size())
+				{
+					return false;
+				}
+			}
+
+			for (uint32_t vertex : mesh.Meshlets.Vertices)
+			{
+				if (vertex >= mesh.Vertices.size())
+					return false;
+			}
+
+			for (const Mesh::Lod& lod : mesh.Lods)
+			{
+				if (lod.IndexCount == 0 || lod.IndexCount % 3 != 0 || (uint64_t)lod.IndexOffset + lod.IndexCount > mesh.LodIndices.size())
+					return false;
+			}
+
+			for (uint32_t index : mesh.LodIndices)
+			{
+				if (index >= mesh.Vertices.size())
+					return false;
+			}
+
+			return true;
+		}
+	}
+
+	void MeshTable::Add(const AssetHandle& mesh)
+	{
+		const std::string& path = mesh.GetAsset()->GetPath();
+		if (m_Indices.find(path) != m_Indices.end())
+			return;
+
+		Entry entry;
+		entry.Path = path;
+		entry.Handle = mesh;
+		entry.Source = dynamic_cast<MeshAsset*>(mesh.GetAsset())->GetSourceData();
+
+		m_Indices[path] = (uint32_t)m_Entries.size();
+		m_Entries.push_back(std::move(entry));
+	}
+
+	void MeshTable::Write(std::ostream& file) const
+	{
+		const char zeros[DataAlignment] = {};
+		auto pad = [&]()
+		{
+			uint64_t position = (uint64_t)file.tellp();
+			file.write(zeros, Align(position) - position);
+		};
+
+		uint32_t meshCount = (uint32_t)m_Entries.size();
+		file.write((const char*)&meshCount, sizeof(uint32_t));
+
+		for (const Entry& entry : m_Entries)
+		{
+			const MeshAsset::SourceData& source = entry.Source;
+
+			uint32_t pathSize = (uint32_t)entry.Path.size();
+			const std::array<uint64_t, MeshCountsSize> counts = { source.Vertices.size(), source.Indices.size(), source.Meshlets.size(),
+				source.MeshletVertices.size(), source.MeshletTriangles.size(), source.Lods.size(), source.LodIndices.size() };
+
+			file.write((const char*)&pathSize, sizeof(uint32_t));
+			file.write(entry.Path.data(), pathSize);
+			file.write((const char*)counts.data(), counts.size() * sizeof(uint64_t));
+
+			pad();
+			file.write((const char*)source.Vertices.data(), source.Vertices.size_bytes());
+			file.write((const char*)source.Indices.data(), source.Indices.size_bytes());
+			file.write((const char*)source.Meshlets.data(), source.Meshlets.size_bytes());
+			file.write((const char*)source.MeshletVertices.data(), source.MeshletVertices.size_bytes());
+			file.write((const char*)source.MeshletTriangles.data(), source.MeshletTriangles.size_bytes());
+			file.write((const char*)source.Lods.data(), source.Lods.size_bytes());
+			file.write((const char*)source.LodIndices.data(), source.LodIndices.size_bytes());
+		}
+	}
+
+	bool MeshTable::Read(std::span<const char> data, uint64_t position)
+	{
+		auto read = [&](void* dst, uint64_t size)
+		{
+			if (position > data.size() || size > data.size() - position)
+				return false;
+
+			memcpy(dst, data.data() + position, size);
+			position += size;
+			return true;
+		};
+
+		// Counts are checked against the remaining size before anything is allocated
+		auto readArray = [&](auto& outArray, uint64_t count)
+		{
+			using T = typename std::remove_reference_t<decltype(outArray)>::value_type;
+			if (position > data.size() || count > (data.size() - position) / sizeof(T))
+				return false;
+
+			outArray.resize((size_t)count);
+			return read(outArray.data(), count * sizeof(T));
+		};
+
+		uint32_t meshCount = 0;
+		if (!read(&meshCount, sizeof(uint32_t)))
+			return false;
+
+		// Every entry takes at least its path size and counts, so a corrupted count can't reserve more than the file holds
+		const uint64_t minimumEntrySize = sizeof(uint32_t) + MeshCountsSize * sizeof(uint64_t);
+		m_Entries.reserve((size_t)std::min<uint64_t>(meshCount, (data.size() - position) / minimumEntrySize));
+		for (uint32_t i = 0; i < meshCount; i++)
+		{
+			uint32_t pathSize = 0;
+			if (!read(&pathSize, sizeof(uint32_t)) || pathSize > data.size() - position)
+				return false;
+
+			Entry entry;
+			entry.Path = std::string(data.data() + position, pathSize);
+			position += pathSize;
+
+			std::array<uint64_t, MeshCountsSize> counts{};
+			if (!read(counts.data(), counts.size() * sizeof(uint64_t)))
+				return false;
+
+			// Copied so that meshes don't keep the file mapped, it might be rewritten while they are alive
+			Ref<OwnedMesh> owned = std::make_shared<OwnedMesh>();
+			position = Align(position);
+			if (!readArray(owned->Vertices, counts[0]) || !readArray(owned->Indices, counts[1]) || !readArray(owned->Meshlets.Meshlets, counts[2])
+				|| !readArray(owned->Meshlets.Vertices, counts[3]) || !readArray(owned->Meshlets.Triangles, counts[4])
+				|| !readArray(owned->Lods, counts[5]) || !readArray(owned->LodIndices, counts[6]) || !IsValid(*owned))
+			{
+				return false;
+			}
+
+			entry.Source = { owned->Vertices, owned->Indices, owned, owned->Meshlets.Meshlets, owned->Meshlets.Vertices,
+				owned->Meshlets.Triangles, owned->Lods, owned->LodIndices };
+
+			m_Indices[entry.Path] = (uint32_t)m_Entries.size();
+			m_Entries.push_back(std::move(entry));
+		}
+
+		return true;
+	}
+
+	void MeshTable::CreateMeshes(ThreadPool* threadPool)
+	{
+		std::vector<uint32_t> missing;
+		for (uint32_t i = 0; i < (uint32_t)m_Entries.size(); i++)
+		{
+			m_Entries[i].Handle = AssetManager::FindAsset(m_Entries[i].Path);
+			if (!m_Entries[i].Handle.IsInitialized())
+				missing.push_back(i);
+		}
+
+		// Meshes are registered only after their batch is submitted, so nobody can get a mesh that isn't uploaded yet
+		auto createBatch = [&](uint32_t batchIndex)
+		{
+			uint32_t first = batchIndex * MeshesPerBatch;
+			uint32_t count = glm::min(MeshesPerBatch, (uint32_t)missing.size() - first);
+
+			UploadBatch batch;
+			std::vector<Mesh> meshes(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const Entry& entry = m_Entries[missing[first + i]];
+				meshes[i].Init(entry.Source.Vertices, entry.Source.Indices, 0, 0, &batch, AssetManager::ChooseVertexLayout(entry.Source.Vertices));
+				AssetManager::UploadMeshletsAndLods(meshes[i], entry.Source, &batch);
+			}
+			batch.Submit();
+
+			for (uint32_t i = 0; i < count; i++)
+			{
+				Entry& entry = m_Entries[missing[first + i]];
+
+				MeshAsset::SourceData source = entry.Source;
+				std::unique_ptr<Asset> meshAsset = std::make_unique<MeshAsset>(entry.Path, std::move(meshes[i]), std::move(source));
+				entry.Handle = AssetManager::AddAsset(entry.Path, std::move(meshAsset));
+			}
+		};
+
+		uint32_t batchCount = ((uint32_t)missing.size() + MeshesPerBatch - 1) / MeshesPerBatch;
+		if (threadPool != nullptr)
+			threadPool->ParallelFor(batchCount, createBatch);
+		else
+		{
+			for (uint32_t i = 0; i < batchCount; i++)
+				createBatch(i);
+		}
+	}
+
+	AssetHandle MeshTable::Find(const std::string& path) const
+	{
+		auto iter = m_Indices.find(path);
+		if (iter == m_Indices.end())
+			return AssetHandle();
+
+		return m_Entries[iter->second].Handle;
+	}
+}
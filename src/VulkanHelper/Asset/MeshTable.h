@@ -0,0 +1,50 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+#include "Asset.h"
+#include "Utility/Utility.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Meshes referenced by a scene file. Every unique mesh is stored once no matter how many entities use it,
+	 * MeshComponents only store the path of their mesh.
+	 *
+	 * Saving takes the data from the CPU side copy kept by MeshAsset, so nothing is read back from the GPU. Loading
+	 * creates all meshes up front, before any components are decoded, and reuses meshes that are already loaded.
+	 *
+	 * Read copies the data into storage owned by the meshes, so they don't keep the scene file mapped and it can be
+	 * overwritten or truncated while they are alive.
+	 *
+	 * Meshlets and LODs are stored along with the vertices, so meshes loaded from a scene get the same ones as when
+	 * they were imported, uploaded according to AssetManager::CreateInfo::UploadMeshlets and MeshLodCount.
+	 */
+	class MeshTable
+	{
+	public:
+		static constexpr uint32_t MeshesPerBatch = 64;
+
+		void Add(const AssetHandle& mesh);
+		void Write(std::ostream& file) const;
+
+		// Mesh data is copied out, so data only has to stay alive until Read returns. Returns false if the table is corrupted
+		bool Read(std::span<const char> data, uint64_t position);
+		void CreateMeshes(ThreadPool* threadPool);
+
+		// Returns uninitialized handle if there is no such mesh
+		AssetHandle Find(const std::string& path) const;
+
+		inline uint32_t GetMeshCount() const { return (uint32_t)m_Entries.size(); }
+	private:
+		struct Entry
+		{
+			std::string Path;
+			AssetHandle Handle;
+			MeshAsset::SourceData Source;
+		};
+
+		std::vector<Entry> m_Entries;
+		std::unordered_map<std::string, uint32_t> m_Indices;
+	};
+}
@@ -0,0 +1,444 @@
+#include "pch.h"
+#include "ModelCache.h"
+
+#include "AssetManager.h"
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		// Mesh data is aligned so that it can be read in place from the mapping
+		constexpr uint64_t DataAlignment = 16;
+
+		struct Header
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint64_t SourceHash;
+			uint64_t SourceSize;
+			uint64_t FileSize;
+			uint32_t VertexSize;
+			uint32_t MeshCount;
+			uint32_t MaterialCount;
+			uint32_t MeshletSize;
+			uint32_t DependencyCount;
+			uint32_t LodCount; // AssetManager::CreateInfo::MeshLodCount the cache was cooked with
+			uint64_t StringsOffset;
+			uint64_t StringsSize;
+		};
+
+		struct StringRecord
+		{
+			uint32_t Offset;
+			uint32_t Size;
+		};
+
+		struct MeshRecord
+		{
+			glm::mat4 Transform;
+			uint64_t VertexOffset;
+			uint64_t VertexCount;
+			uint64_t IndexOffset;
+			uint64_t IndexCount;
+			uint64_t MeshletOffset;
+			uint64_t MeshletCount;
+			uint64_t MeshletVertexOffset;
+			uint64_t MeshletVertexCount;
+			uint64_t MeshletTriangleOffset;
+			uint64_t MeshletTriangleCount;
+			uint64_t LodOffset;
+			uint64_t LodCount;
+			uint64_t LodIndexOffset;
+			uint64_t LodIndexCount;
+			StringRecord Name;
+			uint32_t MaterialIndex;
+			uint32_t Padding;
+		};
+
+		struct MaterialRecord
+		{
+			MaterialProperties Properties;
+			StringRecord Name;
+			StringRecord TexturePaths[4];
+		};
+
+		// File other than the source that was read during the import
+		struct DependencyRecord
+		{
+			StringRecord Path;
+			uint64_t Hash;
+			uint64_t Size;
+		};
+
+		uint64_t Align(uint64_t value)
+		{
+			return (value + DataAlignment - 1) & ~(DataAlignment - 1);
+		}
+
+		StringRecord PushString(std::string& blob, const std::string& str)
+		{
+			StringRecord record{ (uint32_t)blob.size(), (uint32_t)str.size() };
+			blob += str;
+			return record;
+		}
+	}
+
+	std::string ModelCache::GetCachePath(const std::string& sourcePath)
+	{
+		// Hash has to be the same on every compiler, packs built with one toolchain are loaded by builds from others
+		std::string path = AssetPack::NormalizePath(sourcePath);
+		return "CachedModels/" + std::to_string(Bytes::Hash64(path.data(), path.size())) + ".cache";
+	}
+
+	bool ModelCache::Read(const std::string& sourcePath, Model& outModel)
+	{
+		// Caches shipped in an asset pack are trusted as they are, sources usually aren't shipped along with them
+		std::span<const char> packed;
+		if (AssetManager::FindPackedFile(GetCachePath(sourcePath), packed))
+			return Parse(packed, sourcePath, false, outModel);
+
+		// Cache read ahead by the asset manager, validated against the source like one read from the disk
+		Ref<const std::vector<char>> preloaded;
+		if (AssetManager::FindPreloadedFile(GetCachePath(sourcePath), preloaded))
+		{
+			if (!Parse({ preloaded->data(), preloaded->size() }, sourcePath, true, outModel))
+				return false;
+
+			outModel.Buffer = std::move(preloaded);
+			return true;
+		}
+
+		MappedFile file;
+		if (!file.Init({ GetCachePath(sourcePath) }))
+			return false;
+
+		if (!Parse(file.GetSpan(), sourcePath, true, outModel))
+			return false;
+
+		outModel.File = std::move(file);
+		return true;
+	}
+
+	bool ModelCache::Parse(std::span<const char> cache, const std::string& sourcePath, bool validateSource, Model& outModel)
+	{
+		const char* data = cache.data();
+		const uint64_t fileSize = cache.size();
+
+		auto inRange = [fileSize](uint64_t offset, uint64_t size)
+		{
+			return offset <= fileSize && size <= fileSize - offset;
+		};
+
+		if (!inRange(0, sizeof(Header)))
+			return false;
+
+		Header header;
+		memcpy(&header, data, sizeof(Header));
+
+		if (header.Magic != Magic || header.Version != Version || header.VertexSize != sizeof(Mesh::Vertex)
+			|| header.MeshletSize != sizeof(Mesh::Meshlet) || header.FileSize != fileSize)
+		{
+			VK_CORE_WARN("Model cache for {0} is from a different version, rebuilding", sourcePath);
+			return false;
+		}
+
+		if (validateSource)
+		{
+			uint64_t sourceHash, sourceSize;
+			if (!AssetManager::HashFile(sourcePath, sourceHash, sourceSize))
+				return false;
+
+			if (header.SourceHash != sourceHash || header.SourceSize != sourceSize)
+				return false;
+
+			if (header.LodCount < AssetManager::s_MeshLodCount)
+			{
+				VK_CORE_INFO("Model cache for {0} has {1} LODs out of {2}, rebuilding", sourcePath, header.LodCount, AssetManager::s_MeshLodCount);
+				return false;
+			}
+		}
+		else if (header.LodCount < AssetManager::s_MeshLodCount)
+			VK_CORE_WARN("Packed model cache for {0} was cooked with {1} LODs out of {2}, using them as they are", sourcePath, header.LodCount, AssetManager::s_MeshLodCount);
+
+		const uint64_t meshesOffset = sizeof(Header);
+		const uint64_t materialsOffset = meshesOffset + (uint64_t)header.MeshCount * sizeof(MeshRecord);
+		const uint64_t dependenciesOffset = materialsOffset + (uint64_t)header.MaterialCount * sizeof(MaterialRecord);
+		if (!inRange(meshesOffset, (uint64_t)header.MeshCount * sizeof(MeshRecord))
+			|| !inRange(materialsOffset, (uint64_t)header.MaterialCount * sizeof(MaterialRecord))
+			|| !inRange(dependenciesOffset, (uint64_t)header.DependencyCount * sizeof(DependencyRecord))
+			|| !inRange(header.StringsOffset, header.StringsSize))
+		{
+			VK_CORE_WARN("Model cache for {0} is corrupted, rebuilding", sourcePath);
+			return false;
+		}
+
+		const char* strings = data + header.StringsOffset;
+		bool valid = true;
+		auto readString = [&](const StringRecord& record) -> std::string
+		{
+			if ((uint64_t)record.Offset + record.Size > header.StringsSize)
+			{
+				valid = false;
+				return "";
+			}
+			return std::string(strings + record.Offset, record.Size);
+		};
+
+		for (uint32_t i = 0; i < header.DependencyCount && validateSource; i++)
+		{
+			DependencyRecord record;
+			memcpy(&record, data + dependenciesOffset + i * sizeof(DependencyRecord), sizeof(DependencyRecord));
+
+			std::string path = readString(record.Path);
+			uint64_t hash, size;
+			if (!valid || !AssetManager::HashFile(path, hash, size) || hash != record.Hash || size != record.Size)
+				return false;
+		}
+
+		Model model;
+		model.Materials.resize(header.MaterialCount);
+		for (uint32_t i = 0; i < header.MaterialCount; i++)
+		{
+			MaterialRecord record;
+			memcpy(&record, data + materialsOffset + i * sizeof(MaterialRecord), sizeof(MaterialRecord));
+
+			MaterialData& material = model.Materials[i];
+			material.Name = readString(record.Name);
+			material.Properties = record.Properties;
+			for (int j = 0; j < 4; j++)
+				material.TexturePaths[j] = readString(record.TexturePaths[j]);
+		}
+
+		model.Meshes.resize(header.MeshCount);
+		for (uint32_t i = 0; i < header.MeshCount; i++)
+		{
+			MeshRecord record;
+			memcpy(&record, data + meshesOffset + i * sizeof(MeshRecord), sizeof(MeshRecord));
+
+			if (record.VertexCount > fileSize / sizeof(Mesh::Vertex) || record.IndexCount > fileSize / sizeof(uint32_t)
+				|| !inRange(record.VertexOffset, record.VertexCount * sizeof(Mesh::Vertex))
+				|| !inRange(record.IndexOffset, record.IndexCount * sizeof(uint32_t))
+				|| record.MeshletCount > fileSize / sizeof(Mesh::Meshlet) || record.MeshletVertexCount > fileSize / sizeof(uint32_t)
+				|| !inRange(record.MeshletOffset, record.MeshletCount * sizeof(Mesh::Meshlet))
+				|| !inRange(record.MeshletVertexOffset, record.MeshletVertexCount * sizeof(uint32_t))
+				|| !inRange(record.MeshletTriangleOffset, record.MeshletTriangleCount)
+				|| record.LodCount > fileSize / sizeof(Mesh::Lod) || record.LodIndexCount > fileSize / sizeof(uint32_t)
+				|| !inRange(record.LodOffset, record.LodCount * sizeof(Mesh::Lod))
+				|| !inRange(record.LodIndexOffset, record.LodIndexCount * sizeof(uint32_t))
+				|| record.VertexOffset % DataAlignment != 0 || record.IndexOffset % DataAlignment != 0
+				|| record.MeshletOffset % DataAlignment != 0 || record.MeshletVertexOffset % DataAlignment != 0
+				|| record.MeshletTriangleOffset % DataAlignment != 0 || record.LodOffset % DataAlignment != 0
+				|| record.LodIndexOffset % DataAlignment != 0
+				|| record.MaterialIndex >= header.MaterialCount)
+			{
+				valid = false;
+				break;
+			}
+
+			// Indices go to the GPU as they are, an index past the vertex buffer reads out of bounds
+			const uint32_t* indices = (const uint32_t*)(data + record.IndexOffset);
+			if (record.IndexCount % 3 != 0)
+				valid = false;
+			for (uint64_t j = 0; j < record.IndexCount && valid; j++)
+			{
+				if (indices[j] >= record.VertexCount)
+					valid = false;
+			}
+
+			// Meshlets go to the GPU as they are, so everything they point to has to be in range
+			const Mesh::Meshlet* meshlets = (const Mesh::Meshlet*)(data + record.MeshletOffset);
+			const uint32_t* meshletVertices = (const uint32_t*)(data + record.MeshletVertexOffset);
+			for (uint64_t j = 0; j < record.MeshletCount && valid; j++)
+			{
+				const Mesh::Meshlet& meshlet = meshlets[j];
+				if (meshlet.VertexCount > Mesh::MaxMeshletVertices || meshlet.TriangleCount > Mesh::MaxMeshletTriangles
+					|| (uint64_t)meshlet.VertexOffset + meshlet.VertexCount > record.MeshletVertexCount
+					|| (uint64_t)meshlet.TriangleOffset + meshlet.TriangleCount * 3 > record.MeshletTriangleCount)
+				{
+					valid = false;
+				}
+			}
+			for (uint64_t j = 0; j < record.MeshletVertexCount && valid; j++)
+			{
+				if (meshletVertices[j] >= record.VertexCount)
+					valid = false;
+			}
+
+			// Same for LODs, they index the vertices of the full mesh
+			const Mesh::Lod* lods = (const Mesh::Lod*)(data + record.LodOffset);
+			const uint32_t* lodIndices = (const uint32_t*)(data + record.LodIndexOffset);
+			for (uint64_t j = 0; j < record.LodCount && valid; j++)
+			{
+				if (lods[j].IndexCount == 0 || lods[j].IndexCount % 3 != 0 || (uint64_t)lods[j].IndexOffset + lods[j].IndexCount > record.LodIndexCount)
+					valid = false;
+			}
+			for (uint64_t j = 0; j < record.LodIndexCount && valid; j++)
+			{
+				if (lodIndices[j] >= record.VertexCount)
+					valid = false;
+			}
+
+			if (!valid)
+				break;
+
+			MeshData& mesh = model.Meshes[i];
+			mesh.Name = readString(record.Name);
+			mesh.Transform = record.Transform;
+			mesh.MaterialIndex = record.MaterialIndex;
+			mesh.Vertices = { (const Mesh::Vertex*)(data + record.VertexOffset), (size_t)record.VertexCount };
+			mesh.Indices = { indices, (size_t)record.IndexCount };
+			mesh.Meshlets = { meshlets, (size_t)record.MeshletCount };
+			mesh.MeshletVertices = { meshletVertices, (size_t)record.MeshletVertexCount };
+			mesh.MeshletTriangles = { (const uint8_t*)(data + record.MeshletTriangleOffset), (size_t)record.MeshletTriangleCount };
+			mesh.Lods = { lods, (size_t)record.LodCount };
+			mesh.LodIndices = { lodIndices, (size_t)record.LodIndexCount };
+		}
+
+		if (!valid)
+		{
+			VK_CORE_WARN("Model cache for {0} is corrupted, rebuilding", sourcePath);
+			return false;
+		}
+
+		outModel = std::move(model);
+		return true;
+	}
+
+	void ModelCache::Write(const std::string& sourcePath, const Model& model, const std::vector<std::string>& dependencies)
+	{
+		Header header{};
+		header.Magic = Magic;
+		header.Version = Version;
+		header.VertexSize = sizeof(Mesh::Vertex);
+		header.MeshletSize = sizeof(Mesh::Meshlet);
+		header.MeshCount = (uint32_t)model.Meshes.size();
+		header.MaterialCount = (uint32_t)model.Materials.size();
+		header.LodCount = AssetManager::s_MeshLodCount;
+
+		if (!AssetManager::HashFile(sourcePath, header.SourceHash, header.SourceSize))
+			return;
+
+		std::string strings;
+
+		std::vector<MaterialRecord> materials(model.Materials.size());
+		for (size_t i = 0; i < model.Materials.size(); i++)
+		{
+			materials[i].Properties = model.Materials[i].Properties;
+			materials[i].Name = PushString(strings, model.Materials[i].Name);
+			for (int j = 0; j < 4; j++)
+				materials[i].TexturePaths[j] = PushString(strings, model.Materials[i].TexturePaths[j]);
+		}
+
+		std::vector<DependencyRecord> dependencyRecords;
+		for (const std::string& dependency : dependencies)
+		{
+			if (AssetPack::NormalizePath(dependency) == AssetPack::NormalizePath(sourcePath))
+				continue;
+
+			DependencyRecord record{};
+			if (!AssetManager::HashFile(dependency, record.Hash, record.Size))
+				return;
+
+			record.Path = PushString(strings, dependency);
+			dependencyRecords.push_back(record);
+		}
+		header.DependencyCount = (uint32_t)dependencyRecords.size();
+
+		std::vector<MeshRecord> meshes(model.Meshes.size());
+		for (size_t i = 0; i < model.Meshes.size(); i++)
+		{
+			meshes[i] = {};
+			meshes[i].Transform = model.Meshes[i].Transform;
+			meshes[i].VertexCount = model.Meshes[i].Vertices.size();
+			meshes[i].IndexCount = model.Meshes[i].Indices.size();
+			meshes[i].MeshletCount = model.Meshes[i].Meshlets.size();
+			meshes[i].MeshletVertexCount = model.Meshes[i].MeshletVertices.size();
+			meshes[i].MeshletTriangleCount = model.Meshes[i].MeshletTriangles.size();
+			meshes[i].LodCount = model.Meshes[i].Lods.size();
+			meshes[i].LodIndexCount = model.Meshes[i].LodIndices.size();
+			meshes[i].Name = PushString(strings, model.Meshes[i].Name);
+			meshes[i].MaterialIndex = model.Meshes[i].MaterialIndex;
+		}
+
+		header.StringsOffset = sizeof(Header) + meshes.size() * sizeof(MeshRecord) + materials.size() * sizeof(MaterialRecord)
+			+ dependencyRecords.size() * sizeof(DependencyRecord);
+		header.StringsSize = strings.size();
+
+		uint64_t offset = Align(header.StringsOffset + header.StringsSize);
+		for (MeshRecord& mesh : meshes)
+		{
+			mesh.VertexOffset = offset;
+			offset = Align(offset + mesh.VertexCount * sizeof(Mesh::Vertex));
+			mesh.IndexOffset = offset;
+			offset = Align(offset + mesh.IndexCount * sizeof(uint32_t));
+			mesh.MeshletOffset = offset;
+			offset = Align(offset + mesh.MeshletCount * sizeof(Mesh::Meshlet));
+			mesh.MeshletVertexOffset = offset;
+			offset = Align(offset + mesh.MeshletVertexCount * sizeof(uint32_t));
+			mesh.MeshletTriangleOffset = offset;
+			offset = Align(offset + mesh.MeshletTriangleCount);
+			mesh.LodOffset = offset;
+			offset = Align(offset + mesh.LodCount * sizeof(Mesh::Lod));
+			mesh.LodIndexOffset = offset;
+			offset = Align(offset + mesh.LodIndexCount * sizeof(uint32_t));
+		}
+		header.FileSize = offset;
+
+		std::string cachePath = GetCachePath(sourcePath);
+		std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path());
+
+		// Write into temporary file first so that a crash mid way never leaves a broken cache behind
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				VK_CORE_WARN("Failed to write model cache {0}", cachePath);
+				return;
+			}
+
+			const char zeros[DataAlignment] = {};
+			auto pad = [&]()
+			{
+				uint64_t position = (uint64_t)file.tellp();
+				file.write(zeros, Align(position) - position);
+			};
+
+			file.write((const char*)&header, sizeof(Header));
+			file.write((const char*)meshes.data(), meshes.size() * sizeof(MeshRecord));
+			file.write((const char*)materials.data(), materials.size() * sizeof(MaterialRecord));
+			file.write((const char*)dependencyRecords.data(), dependencyRecords.size() * sizeof(DependencyRecord));
+			file.write(strings.data(), strings.size());
+			pad();
+
+			for (const MeshData& mesh : model.Meshes)
+			{
+				file.write((const char*)mesh.Vertices.data(), mesh.Vertices.size_bytes());
+				pad();
+				file.write((const char*)mesh.Indices.data(), mesh.Indices.size_bytes());
+				pad();
+				file.write((const char*)mesh.Meshlets.data(), mesh.Meshlets.size_bytes());
+				pad();
+				file.write((const char*)mesh.MeshletVertices.data(), mesh.MeshletVertices.size_bytes());
+				pad();
+				file.write((const char*)mesh.MeshletTriangles.data(), mesh.MeshletTriangles.size_bytes());
+				pad();
+				file.write((const char*)mesh.Lods.data(), mesh.Lods.size_bytes());
+				pad();
+				file.write((const char*)mesh.LodIndices.data(), mesh.LodIndices.size_bytes());
+				pad();
+			}
+
+			if (!file.good())
+			{
+				VK_CORE_WARN("Failed to write model cache {0}", cachePath);
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error)
+			VK_CORE_WARN("Failed to write model cache {0}: {1}", cachePath, error.message());
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+#include "Asset.h"
+#include "Renderer/Mesh.h"
+#include "Utility/Utility.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Cooked binary representation of a model file. It holds everything that ImportModel would otherwise
+	 * get out of Assimp: final vertex and index data, material parameters, texture paths and node transforms,
+	 * along with meshlets and simplified LODs built for every mesh.
+	 *
+	 * Cache files are memory mapped and mesh data is uploaded straight from the mapping. Each file stores the hash
+	 * and size of the source file and of every other file read while importing it (gltf buffers, obj materials),
+	 * so it gets rebuilt automatically whenever any of them changes.
+	 */
+	class ModelCache
+	{
+	public:
+		static constexpr uint32_t Magic = 0x434D4856; // "VHMC"
+		static constexpr uint32_t Version = 5;
+
+		struct MeshData
+		{
+			std::string Name;
+			std::span<const Mesh::Vertex> Vertices;
+			std::span<const uint32_t> Indices;
+			std::span<const Mesh::Meshlet> Meshlets;
+			std::span<const uint32_t> MeshletVertices;
+			std::span<const uint8_t> MeshletTriangles;
+			std::span<const Mesh::Lod> Lods;
+			std::span<const uint32_t> LodIndices;
+			glm::mat4 Transform = glm::mat4(1.0f);
+			uint32_t MaterialIndex = 0;
+		};
+
+		struct MaterialData
+		{
+			std::string Name;
+			MaterialProperties Properties;
+
+			// Albedo, Normal, Roughness, Metallness
+			std::array<std::string, 4> TexturePaths;
+		};
+
+		struct Model
+		{
+			std::vector<MeshData> Meshes;
+			std::vector<MaterialData> Materials;
+
+			// Memory that mesh data points to, either vectors filled during import, the mapped cache file
+			// or the buffer the cache file was read ahead into
+			std::vector<std::vector<Mesh::Vertex>> VertexStorage;
+			std::vector<std::vector<uint32_t>> IndexStorage;
+			std::vector<Mesh::MeshletData> MeshletStorage;
+			std::vector<std::vector<Mesh::Lod>> LodStorage;
+			std::vector<std::vector<uint32_t>> LodIndexStorage;
+			MappedFile File;
+			Ref<const std::vector<char>> Buffer;
+		};
+
+		// Named after the hash of the normalized source path, so it's the same on every platform and compiler
+		static std::string GetCachePath(const std::string& sourcePath);
+
+		// Returns false if there is no valid cache for the source file, outModel is left empty in that case
+		static bool Read(const std::string& sourcePath, Model& outModel);
+		// dependencies are the files read while importing the source, the source itself may be among them
+		static void Write(const std::string& sourcePath, const Model& model, const std::vector<std::string>& dependencies = {});
+	private:
+		static bool Parse(std::span<const char> cache, const std::string& sourcePath, bool validateSource, Model& outModel);
+	};
+}
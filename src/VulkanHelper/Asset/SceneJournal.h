@@ -0,0 +1,526 @@
+#pragma once
+#include "pch.h"
+#include "Serializer.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Incremental saving of a scene. Next to a full snapshot written by Serializer::SerializeScene there is an
+	 * append only journal, and Save only appends the components that changed since the last save, so its cost depends
+	 * on the amount of changes instead of the scene size. Once the journal grows past CompactionRatio of the snapshot
+	 * size, the snapshot is rewritten and the journal emptied.
+	 *
+	 * Changes are tracked with registry signals. on_update is only emitted by patch, replace and emplace_or_replace,
+	 * components modified through a reference from get have to be marked with MarkDirty.
+	 *
+	 * Each save is appended as one transaction with a hash of its contents, a transaction that was cut off by a crash
+	 * is dropped when loading. Journal also stores the hash of the snapshot it was written against and is ignored if
+	 * the snapshot doesn't match, which happens when compaction is interrupted after the snapshot got replaced.
+	 */
+	template<typename... Components>
+	class SceneJournal
+	{
+	public:
+		static constexpr uint32_t Magic = 0x4A534856; // "VHSJ"
+		// 2 added meshlets and LODs to the mesh tables of transactions
+		static constexpr uint32_t Version = 2;
+
+		struct CreateInfo
+		{
+			// Has to outlive the journal
+			Scene* TargetScene = nullptr;
+			std::string Filepath = "";
+
+			float CompactionRatio = 0.5f;
+
+			// Snapshot is written compressed, the journal itself is always stored raw
+			bool Compress = false;
+		};
+
+		SceneJournal() = default;
+		~SceneJournal() { Destroy(); }
+
+		SceneJournal(const SceneJournal& other) = delete;
+		SceneJournal(SceneJournal&& other) noexcept = delete;
+		SceneJournal& operator=(const SceneJournal& other) = delete;
+		SceneJournal& operator=(SceneJournal&& other) noexcept = delete;
+
+		// Starts tracking a scene by writing a full snapshot of it. Returns false if writing failed
+		bool Init(const CreateInfo& createInfo)
+		{
+			if (m_Initialized)
+				Destroy();
+
+			m_Scene = createInfo.TargetScene;
+			m_Filepath = createInfo.Filepath;
+			m_JournalPath = createInfo.Filepath + ".journal";
+			m_CompactionRatio = createInfo.CompactionRatio;
+			m_Compress = createInfo.Compress;
+
+			if (!Compact())
+				return false;
+
+			Connect();
+			m_Initialized = true;
+			return true;
+		}
+
+		// Loads the snapshot into createInfo.TargetScene, replays the journal on top of it and starts tracking the scene
+		bool Load(const CreateInfo& createInfo, ThreadPool* threadPool = nullptr)
+		{
+			if (m_Initialized)
+				Destroy();
+
+			m_Scene = createInfo.TargetScene;
+			m_Filepath = createInfo.Filepath;
+			m_JournalPath = createInfo.Filepath + ".journal";
+			m_CompactionRatio = createInfo.CompactionRatio;
+			m_Compress = createInfo.Compress;
+
+			if (!Serializer::DeserializeScene<Components...>(m_Filepath, m_Scene, threadPool, &m_Entities))
+				return false;
+
+			m_Indices.clear();
+			for (uint32_t i = 0; i < (uint32_t)m_Entities.size(); i++)
+				m_Indices[m_Entities[i]] = i;
+
+			uint64_t snapshotHash = 0;
+			if (!File::HashFile(m_Filepath, snapshotHash, m_SnapshotSize))
+				return false;
+
+			m_SnapshotHash = snapshotHash;
+			if (!Replay(threadPool))
+				ResetJournal();
+
+			Connect();
+			m_Initialized = true;
+			return true;
+		}
+
+		void Destroy()
+		{
+			if (!m_Initialized)
+				return;
+
+			Disconnect();
+
+			m_Scene = nullptr;
+			m_Entities.clear();
+			m_Indices.clear();
+			for (uint32_t i = 0; i < sizeof...(Components); i++)
+			{
+				m_Dirty[i].clear();
+				m_Removed[i].clear();
+			}
+
+			m_Initialized = false;
+		}
+
+		// Appends everything that changed since the last save. Returns false if writing failed, changes are kept
+		// in that case and written by the next save
+		bool Save()
+		{
+			VK_CORE_ASSERT(m_Initialized, "SceneJournal Not Initialized!");
+
+			if (!HasChanges())
+				return true;
+
+			std::ostringstream body(std::ios::binary);
+			MeshTable meshes;
+			uint32_t recordCount = 0;
+			(WriteRecords<Components>(body, meshes, recordCount), ...);
+
+			TransactionHeader header{};
+			header.RecordCount = recordCount;
+			header.MeshTableOffset = (uint64_t)body.tellp();
+			meshes.Write(body);
+			Pad(body);
+
+			std::string bytes = body.str();
+			header.Size = bytes.size();
+			header.Hash = Bytes::Hash64(bytes.data(), bytes.size());
+
+			{
+				std::ofstream file(m_JournalPath, std::ios::binary | std::ios::app);
+				file.write((const char*)&header, sizeof(TransactionHeader));
+				file.write(bytes.data(), bytes.size());
+
+				if (!file.good())
+				{
+					VK_CORE_ERROR("Failed to write scene journal {0}", m_JournalPath);
+
+					// Cut off whatever part of the transaction got written so that the next one isn't appended after it
+					file.close();
+					std::error_code error;
+					std::filesystem::resize_file(m_JournalPath, m_JournalSize, error);
+					return false;
+				}
+			}
+
+			m_JournalSize += sizeof(TransactionHeader) + bytes.size();
+			for (uint32_t i = 0; i < sizeof...(Components); i++)
+			{
+				m_Dirty[i].clear();
+				m_Removed[i].clear();
+			}
+
+			if ((float)m_JournalSize > (float)m_SnapshotSize * m_CompactionRatio)
+				return Compact();
+
+			return true;
+		}
+
+		// Rewrites the snapshot with the current state of the scene and empties the journal
+		bool Compact()
+		{
+			if (!Serializer::SerializeScene<Components...>(m_Scene, m_Filepath, &m_Entities, m_Compress))
+				return false;
+
+			m_Indices.clear();
+			for (uint32_t i = 0; i < (uint32_t)m_Entities.size(); i++)
+				m_Indices[m_Entities[i]] = i;
+
+			uint64_t snapshotHash = 0;
+			if (!File::HashFile(m_Filepath, snapshotHash, m_SnapshotSize))
+				return false;
+
+			m_SnapshotHash = snapshotHash;
+			for (uint32_t i = 0; i < sizeof...(Components); i++)
+			{
+				m_Dirty[i].clear();
+				m_Removed[i].clear();
+			}
+
+			return ResetJournal();
+		}
+
+		// For components that were modified in place instead of through registry.patch
+		template<typename T>
+		void MarkDirty(entt::entity entity)
+		{
+			OnChanged<T>(m_Scene->GetRegistry(), entity);
+		}
+
+		bool HasChanges() const
+		{
+			for (uint32_t i = 0; i < sizeof...(Components); i++)
+			{
+				if (!m_Dirty[i].empty() || !m_Removed[i].empty())
+					return true;
+			}
+
+			return false;
+		}
+
+		inline uint64_t GetJournalSize() const { return m_JournalSize; }
+		inline uint64_t GetSnapshotSize() const { return m_SnapshotSize; }
+		inline bool IsInitialized() const { return m_Initialized; }
+
+	private:
+		enum class RecordType : uint32_t
+		{
+			Put,
+			Remove
+		};
+
+		struct JournalHeader
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint64_t SnapshotHash;
+		};
+
+		// Size is a multiple of 16 so that mesh data in the body stays aligned in the file
+		struct TransactionHeader
+		{
+			uint64_t Size;
+			uint64_t Hash;
+			uint64_t MeshTableOffset;
+			uint32_t RecordCount;
+			uint32_t Reserved;
+		};
+
+		struct RecordHeader
+		{
+			uint64_t TypeID;
+			uint32_t Entity;
+			RecordType Type;
+			uint64_t DataSize;
+		};
+
+		static constexpr uint64_t DataAlignment = 16;
+
+		static void Pad(std::ostream& stream)
+		{
+			const char zeros[DataAlignment] = {};
+			uint64_t position = (uint64_t)stream.tellp();
+			stream.write(zeros, ((position + DataAlignment - 1) & ~(DataAlignment - 1)) - position);
+		}
+
+		template<typename T, size_t I = 0>
+		static constexpr size_t IndexOf()
+		{
+			if constexpr (std::is_same_v<std::tuple_element_t<I, std::tuple<Components...>>, T>)
+				return I;
+			else
+				return IndexOf<T, I + 1>();
+		}
+
+		void Connect()
+		{
+			entt::registry& reg = m_Scene->GetRegistry();
+			(reg.template on_construct<Components>().template connect<&SceneJournal::OnChanged<Components>>(*this), ...);
+			(reg.template on_update<Components>().template connect<&SceneJournal::OnChanged<Components>>(*this), ...);
+			(reg.template on_destroy<Components>().template connect<&SceneJournal::OnDestroyed<Components>>(*this), ...);
+		}
+
+		void Disconnect()
+		{
+			entt::registry& reg = m_Scene->GetRegistry();
+			(reg.template on_construct<Components>().template disconnect<&SceneJournal::OnChanged<Components>>(*this), ...);
+			(reg.template on_update<Components>().template disconnect<&SceneJournal::OnChanged<Components>>(*this), ...);
+			(reg.template on_destroy<Components>().template disconnect<&SceneJournal::OnDestroyed<Components>>(*this), ...);
+		}
+
+		template<typename T>
+		void OnChanged(entt::registry& reg, entt::entity entity)
+		{
+			constexpr size_t index = IndexOf<T>();
+			m_Dirty[index].insert(entity);
+			m_Removed[index].erase(entity);
+		}
+
+		template<typename T>
+		void OnDestroyed(entt::registry& reg, entt::entity entity)
+		{
+			constexpr size_t index = IndexOf<T>();
+			m_Dirty[index].erase(entity);
+
+			// Entities that were never saved have nothing to remove
+			if (m_Indices.find(entity) != m_Indices.end())
+				m_Removed[index].insert(entity);
+		}
+
+		uint32_t GetEntityIndex(entt::entity entity)
+		{
+			auto iter = m_Indices.find(entity);
+			if (iter != m_Indices.end())
+				return iter->second;
+
+			uint32_t index = (uint32_t)m_Entities.size();
+			m_Indices[entity] = index;
+			m_Entities.push_back(entity);
+			return index;
+		}
+
+		template<typename T>
+		void WriteRecords(std::ostream& body, MeshTable& meshes, uint32_t& recordCount)
+		{
+			constexpr size_t index = IndexOf<T>();
+			entt::registry& reg = m_Scene->GetRegistry();
+
+			for (entt::entity entity : m_Removed[index])
+			{
+				RecordHeader record{ Serializer::GetTypeID<T>(), m_Indices[entity], RecordType::Remove, 0 };
+				body.write((const char*)&record, sizeof(RecordHeader));
+				recordCount++;
+			}
+
+			for (entt::entity entity : m_Dirty[index])
+			{
+				if (!reg.valid(entity) || !reg.template all_of<T>(entity))
+					continue;
+
+				m_Writer.Clear();
+				Serializer::WriteComponent(reg.template get<T>(entity), m_Writer, meshes);
+
+				RecordHeader record{ Serializer::GetTypeID<T>(), GetEntityIndex(entity), RecordType::Put, m_Writer.GetSize() };
+				body.write((const char*)&record, sizeof(RecordHeader));
+				body.write(m_Writer.GetData(), m_Writer.GetSize());
+				recordCount++;
+			}
+		}
+
+		// Returns false if the journal doesn't belong to the snapshot and has to be thrown away
+		bool Replay(ThreadPool* threadPool)
+		{
+			m_JournalSize = sizeof(JournalHeader);
+
+			// Nothing keeps a reference to the mapping, meshes copy their data out of it, so it's closed before the
+			// journal gets truncated here or written by ResetJournal and Save
+			MappedFile file;
+			if (!file.Init({ m_JournalPath }))
+				return false;
+
+			std::span<const char> data = file.GetSpan();
+
+			JournalHeader journalHeader{};
+			if (data.size() < sizeof(JournalHeader))
+				return false;
+
+			memcpy(&journalHeader, data.data(), sizeof(JournalHeader));
+			if (journalHeader.Magic != Magic || journalHeader.Version != Version || journalHeader.SnapshotHash != m_SnapshotHash)
+			{
+				VK_CORE_WARN("Scene journal {0} doesn't match the snapshot, ignoring it", m_JournalPath);
+				return false;
+			}
+
+			const std::array<uint64_t, sizeof...(Components)> typeIDs = { Serializer::GetTypeID<Components>()... };
+
+			using ApplyFn = bool(*)(entt::registry&, entt::entity, RecordType, std::span<const char>, const MeshTable&);
+			constexpr std::array<ApplyFn, sizeof...(Components)> appliers = { &ApplyRecord<Components>... };
+
+			entt::registry& reg = m_Scene->GetRegistry();
+
+			uint64_t position = sizeof(JournalHeader);
+			uint32_t transactionCount = 0;
+			while (position < data.size())
+			{
+				TransactionHeader header{};
+				if (data.size() - position < sizeof(TransactionHeader))
+					break;
+
+				memcpy(&header, data.data() + position, sizeof(TransactionHeader));
+
+				uint64_t bodyStart = position + sizeof(TransactionHeader);
+				if (header.Size > data.size() - bodyStart || header.MeshTableOffset > header.Size
+					|| Bytes::Hash64(data.data() + bodyStart, header.Size) != header.Hash)
+				{
+					break;
+				}
+
+				MeshTable meshes;
+				if (!meshes.Read(data.subspan(0, bodyStart + header.Size), bodyStart + header.MeshTableOffset))
+					break;
+				meshes.CreateMeshes(threadPool);
+
+				uint64_t recordPosition = bodyStart;
+				uint64_t recordsEnd = bodyStart + header.MeshTableOffset;
+				bool corrupted = false;
+				for (uint32_t i = 0; i < header.RecordCount; i++)
+				{
+					RecordHeader record{};
+					if (recordsEnd - recordPosition < sizeof(RecordHeader))
+					{
+						corrupted = true;
+						break;
+					}
+
+					memcpy(&record, data.data() + recordPosition, sizeof(RecordHeader));
+					recordPosition += sizeof(RecordHeader);
+
+					if (record.DataSize > recordsEnd - recordPosition || record.Entity > m_Entities.size() + header.RecordCount)
+					{
+						corrupted = true;
+						break;
+					}
+
+					std::span<const char> bytes = data.subspan(recordPosition, record.DataSize);
+					recordPosition += record.DataSize;
+
+					while (record.Entity >= m_Entities.size())
+					{
+						entt::entity entity = reg.create();
+						m_Indices[entity] = (uint32_t)m_Entities.size();
+						m_Entities.push_back(entity);
+					}
+
+					uint32_t component = Serializer::FindComponent(typeIDs, record.TypeID);
+					if (component != UINT32_MAX && !appliers[component](reg, m_Entities[record.Entity], record.Type, bytes, meshes))
+					{
+						corrupted = true;
+						break;
+					}
+				}
+
+				if (corrupted)
+					break;
+
+				position = bodyStart + header.Size;
+				transactionCount++;
+			}
+
+			uint64_t journalSize = data.size();
+			file.Destroy();
+
+			// Anything after the last complete transaction is dropped so that new ones aren't appended after garbage
+			if (position < journalSize)
+			{
+				VK_CORE_WARN("Scene journal {0} ends with an incomplete transaction, dropping it", m_JournalPath);
+
+				std::error_code error;
+				std::filesystem::resize_file(m_JournalPath, position, error);
+				if (error)
+					return false;
+			}
+
+			m_JournalSize = position;
+
+			VK_CORE_INFO("Replayed {0} transactions from scene journal {1}", transactionCount, m_JournalPath);
+			return true;
+		}
+
+		template<typename T>
+		static bool ApplyRecord(entt::registry& reg, entt::entity entity, RecordType type, std::span<const char> bytes, const MeshTable& meshes)
+		{
+			if (type == RecordType::Remove)
+			{
+				if (reg.template all_of<T>(entity))
+					reg.template remove<T>(entity);
+
+				return true;
+			}
+
+			T component;
+			if (!bytes.empty())
+			{
+				BinaryReader reader(bytes);
+				Serializer::ReadComponent(component, reader, meshes);
+				if (reader.HasFailed())
+					return false;
+			}
+
+			reg.template emplace_or_replace<T>(entity, std::move(component));
+			return true;
+		}
+
+		bool ResetJournal()
+		{
+			JournalHeader header{ Magic, Version, m_SnapshotHash };
+
+			std::ofstream file(m_JournalPath, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(JournalHeader));
+
+			if (!file.good())
+			{
+				VK_CORE_ERROR("Failed to write scene journal {0}", m_JournalPath);
+				return false;
+			}
+
+			m_JournalSize = sizeof(JournalHeader);
+			return true;
+		}
+
+		Scene* m_Scene = nullptr;
+		std::string m_Filepath = "";
+		std::string m_JournalPath = "";
+		float m_CompactionRatio = 0.5f;
+		bool m_Compress = false;
+
+		// Entities are referred to by their index in the snapshot, ones created afterwards are appended
+		std::vector<entt::entity> m_Entities;
+		std::unordered_map<entt::entity, uint32_t> m_Indices;
+
+		std::array<std::unordered_set<entt::entity>, sizeof...(Components)> m_Dirty;
+		std::array<std::unordered_set<entt::entity>, sizeof...(Components)> m_Removed;
+
+		// Reused for every record
+		BinaryWriter m_Writer;
+
+		uint64_t m_SnapshotHash = 0;
+		uint64_t m_SnapshotSize = 0;
+		uint64_t m_JournalSize = 0;
+
+		bool m_Initialized = false;
+	};
+}
@@ -1,21 +1,161 @@
 #pragma once
 #include "pch.h"
+#include <span>
 #include "Scene/Scene.h"
 #include "Scene/Components.h"
 
 namespace VulkanHelper
 {
+	/**
+	 * @brief Scene files are stored column wise. The header is followed by a table of component type IDs written
+	 * once, and then by chunks that each hold up to ChunkSize components of a single type:
+	 *
+	 *   ChunkHeader | entity index column | component size column | component data
+	 *
+	 * Mesh data is kept out of the components, every unique mesh is written once into a MeshTable at the end of
+	 * the file and MeshComponents only reference it by path.
+	 *
+	 * Loading maps the file, creates every entity in one call and then deserializes each chunk into a contiguous
+	 * array that is inserted into the registry in bulk, instead of adding components one entity at a time. Chunks
+	 * are decoded independently, in parallel if a thread pool is given, and only inserting touches the registry.
+	 *
+	 * Files in the old per entity format (version 1) are still loaded, SerializeSceneV1 is kept around so that
+	 * both formats can be compared.
+	 *
+	 * Components are identified by the hash of the name they were registered under with REGISTER_CLASS_IN_SERIALIZER,
+	 * so files don't depend on the compiler, and each type is dispatched through a jump table of its index.
+	 *
+	 * Whole file can optionally be wrapped by Compression, it's then decompressed into memory before loading.
+	 */
 	class Serializer
 	{
 	public:
+		static constexpr uint64_t Magic = 0x32454E4543534856; // "VHSCENE2"
+		// 4 added meshlets and LODs to the mesh table
+		static constexpr uint32_t Version = 4;
+
+		// Number of components of one type per chunk, chunks are the unit of work when loading in parallel
+		static constexpr uint32_t ChunkSize = 16384;
+
+		struct BenchmarkResult
+		{
+			uint64_t EntityCount = 0;
+			uint64_t FileSizeV1 = 0;
+			uint64_t FileSize = 0;
+			double SaveMillisV1 = 0.0;
+			double LoadMillisV1 = 0.0;
+			double SaveMillis = 0.0;
+			double LoadMillis = 0.0;
+		};
+
+		// outEntities receives the stored entities in file order. Compressed files are compressed in parallel if
+		// a thread pool is given. Returns false if writing failed
+		template <typename... Components>
+		static bool SerializeScene(Scene* scene, const std::string& filepath, std::vector<entt::entity>* outEntities = nullptr, bool compress = false, ThreadPool* threadPool = nullptr)
+		{
+			auto& reg = scene->GetRegistry();
+
+			// Only entities with at least one of the serialized components are stored, they are indexed in the order of iteration
+			std::vector<uint32_t> entityIndices;
+			std::vector<entt::entity> entities;
+			reg.each([&](entt::entity entity)
+			{
+				if (!reg.template any_of<Components...>(entity))
+					return;
+
+				uint32_t id = (uint32_t)entt::to_entity(entity);
+				if (id >= entityIndices.size())
+					entityIndices.resize(id + 1, UINT32_MAX);
+
+				entityIndices[id] = (uint32_t)entities.size();
+				entities.push_back(entity);
+			});
+			uint32_t entityCount = (uint32_t)entities.size();
+
+			std::string tempPath = filepath + ".tmp";
+			{
+				std::ofstream outputFile(tempPath, std::ios::binary | std::ios::trunc);
+				if (!outputFile.is_open())
+				{
+					VK_CORE_ERROR("Failed to write scene {0}", filepath);
+					return false;
+				}
+
+				// Compressed scenes are put together in memory first
+				std::ostringstream buffer(std::ios::binary);
+				std::ostream& file = compress ? (std::ostream&)buffer : (std::ostream&)outputFile;
+
+				SceneHeader header{};
+				header.Magic = Magic;
+				header.Version = Version;
+				header.TypeCount = (uint32_t)sizeof...(Components);
+				header.EntityCount = entityCount;
+
+				// Header is written again at the end once the chunk count and file size are known
+				file.write((const char*)&header, sizeof(SceneHeader));
+
+				// Names are only kept for diagnostics, types are matched by their IDs
+				const std::array<uint64_t, sizeof...(Components)> typeIDs = { GetTypeID<Components>()... };
+				const std::array<const std::string*, sizeof...(Components)> names = { &GetTypeName<Components>()... };
+				for (size_t i = 0; i < typeIDs.size(); i++)
+				{
+					uint32_t nameSize = (uint32_t)names[i]->size();
+					file.write((const char*)&typeIDs[i], sizeof(uint64_t));
+					file.write((const char*)&nameSize, sizeof(uint32_t));
+					file.write(names[i]->data(), nameSize);
+				}
+
+				MeshTable meshes;
+				uint32_t typeIndex = 0;
+				(SerializeColumn<Components>(reg, typeIndex++, entityIndices, meshes, file, header.ChunkCount), ...);
+
+				header.MeshTableOffset = (uint64_t)file.tellp();
+				meshes.Write(file);
+
+				header.FileSize = (uint64_t)file.tellp();
+				file.seekp(0);
+				file.write((const char*)&header, sizeof(SceneHeader));
+
+				if (compress)
+				{
+					std::string bytes = buffer.str();
+					std::vector<char> compressed = Compression::Compress(bytes, threadPool);
+					outputFile.write(compressed.data(), compressed.size());
+				}
+
+				if (!file.good() || !outputFile.good())
+				{
+					VK_CORE_ERROR("Failed to write scene {0}", filepath);
+					return false;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::rename(tempPath, filepath, error);
+			if (error)
+			{
+				VK_CORE_ERROR("Failed to write scene {0}: {1}", filepath, error.message());
+				return false;
+			}
+
+			if (outEntities != nullptr)
+				*outEntities = std::move(entities);
+
+			return true;
+		}
+
+		// Old per entity format, every component is stored with its type name
 		template <typename... Components>
-		static void SerializeScene(Scene* scene, const std::string& filepath)
+		static void SerializeSceneV1(Scene* scene, const std::string& filepath)
 		{
-			std::vector<char> bytesOut;
+			BinaryWriter writer;
+
+			// first 8 bytes are overall size of the file, filled in at the end
+			writer.Write((uint64_t)0);
 
 			auto& reg = scene->GetRegistry();
 
-			reg.each([&](entt::entity entity) 
+			reg.each([&](entt::entity entity)
 			{
 				std::tuple<Components*...> tuple = reg.try_get<Components...>(entity);
 
@@ -23,178 +163,526 @@ namespace VulkanHelper
 				TupleNonNullMemberCount(tuple, componentsCount);
 				if (componentsCount != 0)
 				{
-					std::vector<char> bytesSize = VulkanHelper::Bytes::ToBytes(&componentsCount, 4);
-					bytesOut.insert(bytesOut.end(), bytesSize.begin(), bytesSize.end()); // number of components on the entity
+					writer.Write(componentsCount); // number of components on the entity
 
-					SerializeComponents(tuple, bytesOut);
+					SerializeComponents(tuple, writer);
 				}
 			});
 
-			uint64_t size = (uint64_t)bytesOut.size() + 8; // + 8 to account for this 8 size bytes
-			std::vector<char> bytesSize = VulkanHelper::Bytes::ToBytes((char*)&size, 8);
-			bytesOut.insert(bytesOut.begin(), bytesSize.begin(), bytesSize.end()); // first 8 bytes are overall size of the file
+			writer.WriteAt(0, (uint64_t)writer.GetSize());
 
 			std::ofstream ofstream;
 			ofstream.open(filepath, std::ios_base::binary | std::ios_base::trunc);
 
-			ofstream.write(bytesOut.data(), bytesOut.size());
+			ofstream.write(writer.GetData(), writer.GetSize());
 			ofstream.flush();
 
 			ofstream.close();
 		}
 
+		// Chunks are decoded in parallel if a thread pool is given, version 1 files are always loaded sequentially.
+		// outEntities receives the created entities in file order. Returns false if the file couldn't be loaded
 		template <typename... Components>
-		static void DeserializeScene(const std::string& filepath, Scene* outScene)
+		static bool DeserializeScene(const std::string& filepath, Scene* outScene, ThreadPool* threadPool = nullptr, std::vector<entt::entity>* outEntities = nullptr)
 		{
-			std::ifstream ifstream(filepath, std::ios_base::binary);
-
-			uint64_t size = 0;
-			ifstream.read((char*)&size, 8);
-			ifstream.seekg(0);
+			// Only mapped while loading, meshes copy their data out so the file can be overwritten right after
+			MappedFile file;
+			if (!file.Init({ filepath }))
+			{
+				VK_CORE_ERROR("Failed to open scene {0}", filepath);
+				return false;
+			}
 
-			std::vector<char> bytes(size);
-			ifstream.read(bytes.data(), size);
+			std::span<const char> data = file.GetSpan();
 
-			ifstream.seekg(8); // skip first 8 bytes of size data
-			uint64_t currentPos = 8;
-			while (currentPos < size)
+			std::vector<char> decompressed;
+			if (Compression::IsCompressed(data))
 			{
-				// Get the component count on this entity
-				uint32_t componentCount = 0;
-				ifstream.read((char*)&componentCount, 4);
-				currentPos += 4;
+				if (!Compression::Decompress(data, decompressed, threadPool))
+				{
+					VK_CORE_ERROR("Scene {0} is corrupted", filepath);
+					return false;
+				}
 
-				VulkanHelper::Entity entity = outScene->CreateEntity();
+				data = decompressed;
+			}
 
-				for (uint64_t i = 0; i < componentCount; i++)
-				{
-					// Get the component name
-					std::string compName;
-					while (true)
-					{
-						char ch;
-						ifstream.read(&ch, 1);
-						currentPos += 1;
+			uint64_t magic = 0;
+			if (data.size() >= sizeof(uint64_t))
+				memcpy(&magic, data.data(), sizeof(uint64_t));
 
-						if (ch == '\0')
-						{
-							break;
-						}
+			std::vector<entt::entity> entities;
 
-						compName.push_back(ch);
-					}
+			// Version 1 files start with their size instead of a magic number
+			bool loaded = false;
+			if (magic == Magic)
+				loaded = DeserializeColumns<Components...>(data, filepath, outScene, threadPool, entities);
+			else if (magic == data.size())
+				loaded = DeserializeSceneV1<Components...>(data, outScene, entities);
+			else
+				VK_CORE_ERROR("Scene {0} is invalid or from a different version", filepath);
 
-					// Create a component from a registered constructor
-					void* component = CreateRegisteredClass(compName);
+			if (outEntities != nullptr)
+				*outEntities = std::move(entities);
 
-					// Read 8 bytes of data size
-					uint64_t componentDataSize = 0;
-					ifstream.read((char*)&componentDataSize, 8);
-					currentPos += 8;
+			return loaded;
+		}
 
-					// read the data
-					std::vector<char> componentByteData(componentDataSize);
-					ifstream.read(componentByteData.data(), componentDataSize);
-					currentPos += componentDataSize;
+		// Generates a scene with entityCount entities, each one filled by populate with its index, and times saving
+		// and loading it in the current format against version 1. Best of the iterations is kept. Files are written
+		// to directory and removed at the end
+		template <typename... Components>
+		static BenchmarkResult Benchmark(uint32_t entityCount, const std::function<void(Entity&, uint32_t)>& populate, const std::string& directory,
+			ThreadPool* threadPool = nullptr, uint32_t iterations = 3)
+		{
+			Scene scene;
+			for (uint32_t i = 0; i < entityCount; i++)
+			{
+				Entity entity = scene.CreateEntity();
+				populate(entity, i);
+			}
 
-					// Push component onto the entity
-					DeduceObjectTypeAndAddToEntity<Components...>(component, compName, entity, componentByteData);
+			const std::string pathV1 = directory + "/SerializerBenchmarkV1.scene";
+			const std::string path = directory + "/SerializerBenchmark.scene";
+
+			BenchmarkResult result;
+			result.EntityCount = entityCount;
+			result.SaveMillisV1 = result.LoadMillisV1 = result.SaveMillis = result.LoadMillis = std::numeric_limits<double>::max();
+			for (uint32_t i = 0; i < std::max(iterations, 1u); i++)
+			{
+				Timer timer;
+				SerializeSceneV1<Components...>(&scene, pathV1);
+				result.SaveMillisV1 = std::min(result.SaveMillisV1, (double)timer.ElapsedMillis());
+
+				timer.Reset();
+				bool saved = SerializeScene<Components...>(&scene, path, nullptr, false, threadPool);
+				result.SaveMillis = std::min(result.SaveMillis, (double)timer.ElapsedMillis());
 
-					delete component;
+				// Scenes are destroyed outside of the timed part
+				{
+					Scene loaded;
+					timer.Reset();
+					bool loadedV1 = DeserializeScene<Components...>(pathV1, &loaded, threadPool);
+					result.LoadMillisV1 = std::min(result.LoadMillisV1, (double)timer.ElapsedMillis());
+
+					VK_CORE_ASSERT(loadedV1, "Failed to load version 1 benchmark scene!");
+				}
+				{
+					Scene loaded;
+					timer.Reset();
+					bool loadedColumns = DeserializeScene<Components...>(path, &loaded, threadPool);
+					result.LoadMillis = std::min(result.LoadMillis, (double)timer.ElapsedMillis());
+
+					VK_CORE_ASSERT(saved && loadedColumns, "Failed to save or load benchmark scene!");
 				}
 			}
+
+			std::error_code error;
+			result.FileSizeV1 = std::filesystem::file_size(pathV1, error);
+			result.FileSize = std::filesystem::file_size(path, error);
+			std::filesystem::remove(pathV1, error);
+			std::filesystem::remove(path, error);
+
+			VK_CORE_INFO("Scene with {0} entities, version 1: {1} bytes, save {2:.1f}ms, load {3:.1f}ms", entityCount, result.FileSizeV1, result.SaveMillisV1, result.LoadMillisV1);
+			VK_CORE_INFO("Scene with {0} entities, version {1}: {2} bytes, save {3:.1f}ms, load {4:.1f}ms", entityCount, Version, result.FileSize, result.SaveMillis, result.LoadMillis);
+
+			return result;
 		}
 
 #define REGISTER_CLASS_IN_SERIALIZER(className) VulkanHelper::Serializer::RegisterClass<className>(#className)
 
+		// Every serialized component has to be registered, its type ID is derived from the registered name
 		template<typename T>
 		static void RegisterClass(const std::string& className)
 		{
+			uint64_t typeID = GetTypeID(className);
+
+			auto iter = s_RegisteredNames.find(typeID);
+			VK_CORE_ASSERT(iter == s_RegisteredNames.end() || iter->second == className, "classes {} and {} have the same type ID!", className, iter->second);
+
 			s_ReflectionMap[className] = []() { return (void*)(new T()); };
+			s_RegisteredNames[typeID] = className;
+
+			s_TypeIDs<T> = typeID;
+			s_TypeNames<T> = className;
+		}
+
+		// Stable across runs and compilers since it only depends on the registered name
+		static uint64_t GetTypeID(const std::string& className)
+		{
+			return Bytes::Hash64(className.data(), className.size());
+		}
+
+		template<typename T>
+		static uint64_t GetTypeID()
+		{
+			VK_CORE_ASSERT(s_TypeIDs<T> != 0, "class {} wasn't registered!", typeid(T).name());
+			return s_TypeIDs<T>;
+		}
+
+		template<typename T>
+		static const std::string& GetTypeName()
+		{
+			return s_TypeNames<T>;
 		}
 
 		static void* CreateRegisteredClass(const std::string& className)
 		{
-			VK_CORE_ASSERT(s_ReflectionMap.find(className) != s_ReflectionMap.end(), "class {} wasn't registered!", className);
+			auto iter = s_ReflectionMap.find(className);
+			VK_CORE_ASSERT(iter != s_ReflectionMap.end(), "class {} wasn't registered!", className);
 
-			return s_ReflectionMap[className]();
+			// Scenes are deserialized on multiple threads so the map is only ever looked up here
+			return iter->second();
 		}
 
 	private:
 
+		struct SceneHeader
+		{
+			uint64_t Magic;
+			uint32_t Version;
+			uint32_t TypeCount;
+			uint64_t EntityCount;
+			uint64_t ChunkCount;
+			uint64_t MeshTableOffset;
+			uint64_t FileSize;
+		};
+
+		struct ChunkHeader
+		{
+			uint32_t TypeIndex;
+			uint32_t ComponentCount;
+			uint64_t DataSize;
+		};
+
+		struct ChunkInfo
+		{
+			uint32_t Component;
+			uint32_t Count;
+			const char* Entities;
+			const char* Sizes;
+			const char* Data;
+			uint64_t DataSize;
+		};
+
+		// Components of one chunk decoded off the registry, waiting to be inserted
+		struct StagedColumn
+		{
+			virtual ~StagedColumn() = default;
+			virtual void Commit(entt::registry& reg) = 0;
+		};
+
 		template<typename T>
-		static void PushComponent(T&& comp, VulkanHelper::Entity& entity)
+		struct StagedComponents : StagedColumn
 		{
-			entity.AddComponent<T>(std::move(comp));
-		}
+			std::vector<entt::entity> Entities;
+			std::vector<T> Components;
+
+			void Commit(entt::registry& reg) override
+			{
+				reg.insert<T>(Entities.begin(), Entities.end(), std::make_move_iterator(Components.begin()));
+			}
+		};
 
 		template<typename T>
-		static T* TryCast(void* obj, const std::string& compName)
+		static void SerializeColumn(entt::registry& reg, uint32_t typeIndex, const std::vector<uint32_t>& entityIndices, MeshTable& meshes, std::ostream& file, uint64_t& chunkCount)
 		{
-			// Check and parse the name
-			std::string name = typeid(T).name();
-			if (name.find("class ") != std::string::npos)
-				name = name.substr(6, name.size() - 6);
+			auto view = reg.view<T>();
 
-			if (name.find(" * __ptr64") != std::string::npos)
-				name = name.substr(0, name.size() - 10);
+			// Reused for every chunk of the column, so they stop allocating after the first one
+			std::vector<uint32_t> entities;
+			std::vector<uint32_t> sizes;
+			BinaryWriter data;
 
-			if (name.find(" * __ptr32") != std::string::npos)
-				name = name.substr(0, name.size() - 10);
+			auto flush = [&]()
+			{
+				ChunkHeader header{};
+				header.TypeIndex = typeIndex;
+				header.ComponentCount = (uint32_t)entities.size();
+				header.DataSize = data.GetSize();
+
+				file.write((const char*)&header, sizeof(ChunkHeader));
+				file.write((const char*)entities.data(), entities.size() * sizeof(uint32_t));
+				file.write((const char*)sizes.data(), sizes.size() * sizeof(uint32_t));
+				file.write(data.GetData(), data.GetSize());
+
+				entities.clear();
+				sizes.clear();
+				data.Clear();
+				chunkCount++;
+			};
+
+			for (entt::entity entity : view)
+			{
+				uint64_t start = data.GetSize();
+				WriteComponent(view.template get<T>(entity), data, meshes);
 
-			if (name.find("VulkanHelper::") != std::string::npos)
-				name = name.substr(14, name.size() - 14);
+				entities.push_back(entityIndices[(uint32_t)entt::to_entity(entity)]);
+				sizes.push_back((uint32_t)(data.GetSize() - start));
 
-			// If the name matches that of a component then return it
-			if (name == compName)
-				return (T*)(obj);
-			else
-				return nullptr;
+				if (entities.size() == ChunkSize)
+					flush();
+			}
 
-			//return dynamic_cast<T*>(obj);
+			if (!entities.empty())
+				flush();
 		}
 
-		template<typename... T>
-		static void DeduceObjectTypeAndAddToEntity(void* obj, const std::string& compName, VulkanHelper::Entity& entity, const std::vector<char>& deserializedData)
+		template <typename... Components>
+		static bool DeserializeColumns(std::span<const char> data, const std::string& filepath, Scene* outScene, ThreadPool* threadPool, std::vector<entt::entity>& entities)
 		{
-			if constexpr (sizeof...(T) == 0)
-				return;
+			uint64_t position = 0;
+			auto read = [&](void* dst, uint64_t size)
+			{
+				if (size > data.size() - position)
+					return false;
+
+				memcpy(dst, data.data() + position, size);
+				position += size;
+				return true;
+			};
+
+			SceneHeader header{};
+			if (!read(&header, sizeof(SceneHeader)) || header.Version != Version || header.FileSize != data.size() || header.EntityCount > UINT32_MAX)
+			{
+				VK_CORE_ERROR("Scene {0} is invalid or from a different version", filepath);
+				return false;
+			}
+
+			// Map types stored in the file onto the requested components, types that weren't requested are skipped
+			const std::array<uint64_t, sizeof...(Components)> typeIDs = { GetTypeID<Components>()... };
+			std::vector<uint32_t> typeMapping(header.TypeCount, UINT32_MAX);
+			for (uint32_t i = 0; i < header.TypeCount; i++)
+			{
+				uint64_t typeID = 0;
+				uint32_t nameSize = 0;
+				if (!read(&typeID, sizeof(uint64_t)) || !read(&nameSize, sizeof(uint32_t)) || nameSize > data.size() - position)
+				{
+					VK_CORE_ERROR("Scene {0} is corrupted", filepath);
+					return false;
+				}
+
+				std::string_view name(data.data() + position, nameSize);
+				position += nameSize;
+
+				uint32_t component = FindComponent(typeIDs, typeID);
+				if (component != UINT32_MAX)
+					typeMapping[i] = component;
+				else
+					VK_CORE_WARN("Scene {0} contains component {1} which wasn't requested, skipping it", filepath, name);
+			}
+
+			// Only headers are read here, chunks are decoded later and independently of each other
+			std::vector<ChunkInfo> chunks;
+			chunks.reserve((size_t)header.ChunkCount);
+			for (uint64_t i = 0; i < header.ChunkCount; i++)
+			{
+				ChunkHeader chunk{};
+				if (!read(&chunk, sizeof(ChunkHeader)) || chunk.TypeIndex >= header.TypeCount)
+				{
+					VK_CORE_ERROR("Scene {0} is corrupted", filepath);
+					return false;
+				}
+
+				uint64_t columnsSize = (uint64_t)chunk.ComponentCount * sizeof(uint32_t) * 2;
+				if (columnsSize > data.size() - position || chunk.DataSize > data.size() - position - columnsSize)
+				{
+					VK_CORE_ERROR("Scene {0} is corrupted", filepath);
+					return false;
+				}
+
+				ChunkInfo info{};
+				info.Component = typeMapping[chunk.TypeIndex];
+				info.Count = chunk.ComponentCount;
+				info.Entities = data.data() + position;
+				info.Sizes = info.Entities + chunk.ComponentCount * sizeof(uint32_t);
+				info.Data = info.Entities + columnsSize;
+				info.DataSize = chunk.DataSize;
+				position += columnsSize + chunk.DataSize;
+
+				if (info.Component != UINT32_MAX)
+					chunks.push_back(info);
+			}
+
+			// Meshes are created before any component is decoded so that components only look them up
+			MeshTable meshes;
+			if (!meshes.Read(data, header.MeshTableOffset))
+			{
+				VK_CORE_ERROR("Scene {0} is corrupted", filepath);
+				return false;
+			}
+			meshes.CreateMeshes(threadPool);
+
+			entt::registry& reg = outScene->GetRegistry();
+
+			entities.resize((size_t)header.EntityCount);
+			reg.create(entities.begin(), entities.end());
+
+			using DecodeFn = Scope<StagedColumn>(*)(const std::vector<entt::entity>&, const ChunkInfo&, const MeshTable&);
+			constexpr std::array<DecodeFn, sizeof...(Components)> decoders = { &DecodeColumn<Components>... };
+
+			// Registry isn't touched while decoding, so chunks can be decoded on any thread
+			std::vector<Scope<StagedColumn>> staged(chunks.size());
+			auto decode = [&](uint32_t i)
+			{
+				staged[i] = decoders[chunks[i].Component](entities, chunks[i], meshes);
+			};
+
+			if (threadPool != nullptr)
+				threadPool->ParallelFor((uint32_t)chunks.size(), decode);
 			else
 			{
-				// Try casting the obj into one of the components given in T
-				// It will fill the tuple with nullptrs except for the original obj type
-				std::tuple<T*...> tuple = { TryCast<T>(obj, compName)... };
+				for (uint32_t i = 0; i < (uint32_t)chunks.size(); i++)
+					decode(i);
+			}
 
-				IterateTupleAndAddComponent(tuple, entity, deserializedData);
+			for (const Scope<StagedColumn>& column : staged)
+			{
+				if (column == nullptr)
+				{
+					VK_CORE_ERROR("Scene {0} is corrupted", filepath);
+					return false;
+				}
 			}
+
+			for (const Scope<StagedColumn>& column : staged)
+				column->Commit(reg);
+
+			return true;
 		}
 
-		template<size_t I = 0, typename... T>
-		constexpr static void IterateTupleAndAddComponent(const std::tuple<T...>& tuple, VulkanHelper::Entity& entity, const std::vector<char>& deserializedData)
+		template<typename T>
+		static Scope<StagedColumn> DecodeColumn(const std::vector<entt::entity>& entities, const ChunkInfo& chunk, const MeshTable& meshes)
 		{
-			// Iterate the tuple and check if the component != nullptr. If true then add the component to the entity
-			// otherwise keep iterating
+			Scope<StagedComponents<T>> column = std::make_unique<StagedComponents<T>>();
+			column->Entities.resize(chunk.Count);
+			column->Components.resize(chunk.Count);
+
+			// Columns are copied out since the mapping doesn't guarantee their alignment
+			std::vector<uint32_t> entityColumn(chunk.Count);
+			std::vector<uint32_t> sizeColumn(chunk.Count);
+			memcpy(entityColumn.data(), chunk.Entities, entityColumn.size() * sizeof(uint32_t));
+			memcpy(sizeColumn.data(), chunk.Sizes, sizeColumn.size() * sizeof(uint32_t));
+
+			uint64_t offset = 0;
+			for (uint32_t i = 0; i < chunk.Count; i++)
+			{
+				if (entityColumn[i] >= entities.size() || sizeColumn[i] > chunk.DataSize - offset)
+					return nullptr;
 
-			if constexpr (I == sizeof...(T))
-				return;
+				column->Entities[i] = entities[entityColumn[i]];
+
+				std::span<const char> bytes(chunk.Data + offset, sizeColumn[i]);
+				offset += sizeColumn[i];
+
+				if (bytes.empty())
+					continue;
+
+				BinaryReader reader(bytes);
+				ReadComponent(column->Components[i], reader, meshes);
+				if (reader.HasFailed())
+					return nullptr;
+			}
+
+			return column;
+		}
+
+		// Components that keep their meshes in the mesh table are serialized through it when they support it
+		template<typename T>
+		static void WriteComponent(T& component, BinaryWriter& writer, MeshTable& meshes)
+		{
+			if constexpr (requires { component.Serialize(writer, meshes); })
+				component.Serialize(writer, meshes);
 			else
+				component.Serialize(writer);
+		}
+
+		template<typename T>
+		static void ReadComponent(T& component, BinaryReader& reader, const MeshTable& meshes)
+		{
+			if constexpr (requires { component.Deserialize(reader, meshes); })
+				component.Deserialize(reader, meshes);
+			else
+				component.Deserialize(reader);
+		}
+
+		template <typename... Components>
+		static bool DeserializeSceneV1(std::span<const char> data, Scene* outScene, std::vector<entt::entity>& entities)
+		{
+			const std::array<uint64_t, sizeof...(Components)> typeIDs = { GetTypeID<Components>()... };
+
+			using AddFn = void(*)(VulkanHelper::Entity&, std::span<const char>);
+			constexpr std::array<AddFn, sizeof...(Components)> adders = { &AddComponent<Components>... };
+
+			BinaryReader reader(data);
+
+			// skip first 8 bytes of size data, it's checked by the caller
+			uint64_t size = 0;
+			reader.Read(size);
+
+			std::string name;
+			while (reader.GetRemaining() >= sizeof(uint32_t))
 			{
-				auto comp = std::get<I>(tuple);
-				if (comp != nullptr)
+				// Get the component count on this entity
+				uint32_t componentCount = 0;
+				reader.Read(componentCount);
+
+				VulkanHelper::Entity entity = outScene->CreateEntity();
+				entities.push_back(entity.GetHandle());
+
+				for (uint64_t i = 0; i < componentCount; i++)
 				{
-					if (!deserializedData.empty())
-						comp->Deserialize(deserializedData);
+					// Get the component name, version 1 names are the same as the registered ones on MSVC
+					uint64_t componentDataSize = 0;
+					reader.ReadString(name);
+					reader.Read(componentDataSize);
+					std::span<const char> componentData = reader.ReadSpan(componentDataSize);
 
-					PushComponent(std::move(*comp), entity);
-					return;
+					if (reader.HasFailed())
+					{
+						VK_CORE_ERROR("Scene is corrupted");
+						return false;
+					}
+
+					// Push component onto the entity
+					uint32_t component = FindComponent(typeIDs, Bytes::Hash64(name.data(), name.size()));
+					if (component != UINT32_MAX)
+						adders[component](entity, componentData);
+					else
+						VK_CORE_WARN("Scene contains component {} which wasn't requested, skipping it", name);
 				}
+			}
 
-				IterateTupleAndAddComponent<I + 1>(tuple, entity, deserializedData);
+			return true;
+		}
+
+		template<typename T>
+		static void AddComponent(VulkanHelper::Entity& entity, std::span<const char> deserializedData)
+		{
+			T component;
+			if (!deserializedData.empty())
+			{
+				BinaryReader reader(deserializedData);
+				component.Deserialize(reader);
 			}
+
+			entity.AddComponent<T>(std::move(component));
+		}
+
+		template<size_t Count>
+		static uint32_t FindComponent(const std::array<uint64_t, Count>& typeIDs, uint64_t typeID)
+		{
+			for (uint32_t i = 0; i < Count; i++)
+			{
+				if (typeIDs[i] == typeID)
+					return i;
+			}
+
+			return UINT32_MAX;
 		}
 
 		template<size_t I = 0, typename... T>
-		constexpr static void SerializeComponents(const std::tuple<T...>& tuple, std::vector<char>& bytesOut)
+		constexpr static void SerializeComponents(const std::tuple<T...>& tuple, BinaryWriter& writer)
 		{
 			if constexpr(I == sizeof...(T))
 				return;
@@ -204,9 +692,9 @@ namespace VulkanHelper
 				// so iterate over the tuple and check if they are nullptr or not
 				auto comp = std::get<I>(tuple);
 				if (comp != nullptr)
-					SerializeComponent(comp, bytesOut);
+					SerializeComponent(comp, writer);
 
-				SerializeComponents<I + 1>(tuple, bytesOut);
+				SerializeComponents<I + 1>(tuple, writer);
 			}
 		}
 
@@ -218,7 +706,7 @@ namespace VulkanHelper
 			else
 			{
 				auto obj = std::get<I>(tuple);
-				if (obj != nullptr) 
+				if (obj != nullptr)
 					outSize += 1;
 
 				TupleNonNullMemberCount<I + 1>(tuple, outSize);
@@ -226,50 +714,31 @@ namespace VulkanHelper
 		}
 
 		template<typename T>
-		static void SerializeComponent(T component, std::vector<char>& bytesOut)
+		static void SerializeComponent(T* component, BinaryWriter& writer)
 		{
-			std::string name = typeid(T).name();
-			if (name.find("class ") != std::string::npos)
-				name = name.substr(6, name.size() - 6);
-
-			if (name.find(" * __ptr64") != std::string::npos)
-				name = name.substr(0, name.size() - 10);
-
-			if (name.find(" * __ptr32") != std::string::npos)
-				name = name.substr(0, name.size() - 10);
-
-			if (name.find("VulkanHelper::") != std::string::npos)
-				name = name.substr(14, name.size() - 14);
-
-			std::vector<char> nameBytes;
-			for (int i = 0; i < name.size(); i++)
-			{
-				nameBytes.push_back(name[i]);
-			}
-			nameBytes.push_back('\0');
-
-			std::vector<char> componentBytes = component->Serialize();
-
-			std::vector<char> combinedBytes;
-			combinedBytes.reserve(nameBytes.size() + 8 + componentBytes.size());
-
 			// First the name of the component class
-			combinedBytes.insert(combinedBytes.end(), nameBytes.begin(), nameBytes.end());
+			writer.WriteString(GetTypeName<T>());
 
-			// Size of the component data bytes
-			uint64_t size = (uint64_t)componentBytes.size();
-			std::vector<char> bytesSize = VulkanHelper::Bytes::ToBytes((char*)&size, 8);
-			combinedBytes.insert(combinedBytes.end(), bytesSize.begin(), bytesSize.end()); // first 8 bytes are overall size of the file
+			// Size of the component data bytes, filled in once the component is written
+			uint64_t sizeOffset = writer.GetSize();
+			writer.Write((uint64_t)0);
 
 			// Component Data
-			combinedBytes.insert(combinedBytes.end(), componentBytes.begin(), componentBytes.end());
+			component->Serialize(writer);
 
-			// Push the data out
-			bytesOut.reserve(bytesOut.size() + combinedBytes.size());
-			bytesOut.insert(bytesOut.end(), combinedBytes.begin(), combinedBytes.end());
+			writer.WriteAt(sizeOffset, (uint64_t)(writer.GetSize() - sizeOffset - sizeof(uint64_t)));
 		}
 
+		template<typename... Components>
+		friend class SceneJournal;
+
 		static inline std::unordered_map<std::string, std::function<void* ()>> s_ReflectionMap;
+		static inline std::unordered_map<uint64_t, std::string> s_RegisteredNames;
+
+		template<typename T>
+		static inline uint64_t s_TypeIDs = 0;
+		template<typename T>
+		static inline std::string s_TypeNames = "";
 	};
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,528 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include "AssetManager.h"
+
+#include <stb_image.h>
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		constexpr uint64_t DataAlignment = 16;
+
+		struct Header
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint64_t SourceHash;
+			uint64_t SourceSize;
+			uint64_t FileSize;
+			uint32_t Width;
+			uint32_t Height;
+			uint32_t MipCount;
+			uint32_t Format;
+			uint64_t PixelsOffset;
+			uint64_t PixelsSize;
+			uint64_t EnvAccelOffset;
+			uint64_t EnvAccelCount;
+		};
+
+		uint64_t Align(uint64_t value)
+		{
+			return (value + DataAlignment - 1) & ~(DataAlignment - 1);
+		}
+
+		uint32_t GetFullMipCount(uint32_t width, uint32_t height)
+		{
+			return (uint32_t)glm::floor(glm::log2((float)glm::max(width, height))) + 1;
+		}
+
+		void ParallelFor(ThreadPool* threadPool, uint32_t count, const std::function<void(uint32_t)>& function)
+		{
+			if (threadPool != nullptr && threadPool->IsInitialized())
+			{
+				threadPool->ParallelFor(count, function);
+				return;
+			}
+
+			for (uint32_t i = 0; i < count; i++)
+				function(i);
+		}
+
+		// 2x2 box filter over RGBA texels, edge texels are repeated for odd sizes
+		template<typename T>
+		void DownsampleLevel(const T* src, uint32_t srcWidth, uint32_t srcHeight, T* dst, ThreadPool* threadPool)
+		{
+			uint32_t dstWidth = glm::max(srcWidth / 2, 1u);
+			uint32_t dstHeight = glm::max(srcHeight / 2, 1u);
+
+			ParallelFor(threadPool, dstHeight, [=](uint32_t y)
+				{
+					uint32_t y0 = glm::min(y * 2, srcHeight - 1);
+					uint32_t y1 = glm::min(y * 2 + 1, srcHeight - 1);
+
+					for (uint32_t x = 0; x < dstWidth; x++)
+					{
+						uint32_t x0 = glm::min(x * 2, srcWidth - 1);
+						uint32_t x1 = glm::min(x * 2 + 1, srcWidth - 1);
+
+						const T* texels[4] = {
+							src + ((uint64_t)y0 * srcWidth + x0) * 4,
+							src + ((uint64_t)y0 * srcWidth + x1) * 4,
+							src + ((uint64_t)y1 * srcWidth + x0) * 4,
+							src + ((uint64_t)y1 * srcWidth + x1) * 4,
+						};
+
+						T* out = dst + ((uint64_t)y * dstWidth + x) * 4;
+						for (int c = 0; c < 4; c++)
+						{
+							if constexpr (std::is_same_v<T, float>)
+								out[c] = (texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c]) * 0.25f;
+							else
+								out[c] = (T)(((uint32_t)texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+						}
+					}
+				});
+		}
+
+		constexpr uint32_t BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		class BitWriter
+		{
+		public:
+			BitWriter(uint8_t* data)
+				: m_Data(data)
+			{
+				memset(m_Data, 0, 16);
+			}
+
+			void Write(uint32_t value, uint32_t bitCount)
+			{
+				for (uint32_t i = 0; i < bitCount; i++, m_Position++)
+					m_Data[m_Position / 8] |= (uint8_t)(((value >> i) & 1) << (m_Position % 8));
+			}
+
+		private:
+			uint8_t* m_Data;
+			uint32_t m_Position = 0;
+		};
+
+		// Encodes a 4x4 block in BC7 mode 6: single subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices.
+		// Endpoints are picked along the principal axis of the block colors.
+		void EncodeBC7Block(const glm::vec4 texels[16], uint8_t* out)
+		{
+			glm::vec4 mean(0.0f);
+			for (int i = 0; i < 16; i++)
+				mean += texels[i];
+			mean /= 16.0f;
+
+			glm::mat4 covariance(0.0f);
+			for (int i = 0; i < 16; i++)
+				covariance += glm::outerProduct(texels[i] - mean, texels[i] - mean);
+
+			// Power iteration, converges to the eigenvector with the biggest eigenvalue
+			glm::vec4 axis(1.0f);
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec4 next = covariance * axis;
+				float length = glm::length(next);
+				if (length < 1e-6f)
+					break;
+				axis = next / length;
+			}
+			axis = glm::normalize(axis);
+
+			float minT = std::numeric_limits<float>::max();
+			float maxT = std::numeric_limits<float>::lowest();
+			for (int i = 0; i < 16; i++)
+			{
+				float t = glm::dot(texels[i] - mean, axis);
+				minT = glm::min(minT, t);
+				maxT = glm::max(maxT, t);
+			}
+
+			glm::vec4 endpoints[2] = { glm::clamp(mean + axis * minT, 0.0f, 255.0f), glm::clamp(mean + axis * maxT, 0.0f, 255.0f) };
+
+			// Quantize endpoints to 7 bits, p-bit is the shared lowest bit of every channel
+			uint32_t quantized[2][4];
+			uint32_t pBits[2];
+			for (int e = 0; e < 2; e++)
+			{
+				float bestError = std::numeric_limits<float>::max();
+				for (uint32_t p = 0; p < 2; p++)
+				{
+					uint32_t candidate[4];
+					float error = 0.0f;
+					for (int c = 0; c < 4; c++)
+					{
+						candidate[c] = (uint32_t)glm::clamp(glm::round((endpoints[e][c] - (float)p) / 2.0f), 0.0f, 127.0f);
+						float difference = (float)((candidate[c] << 1) | p) - endpoints[e][c];
+						error += difference * difference;
+					}
+
+					if (error < bestError)
+					{
+						bestError = error;
+						pBits[e] = p;
+						memcpy(quantized[e], candidate, sizeof(candidate));
+					}
+				}
+			}
+
+			int palette[16][4];
+			for (int w = 0; w < 16; w++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					int e0 = (int)((quantized[0][c] << 1) | pBits[0]);
+					int e1 = (int)((quantized[1][c] << 1) | pBits[1]);
+					palette[w][c] = ((64 - (int)BC7Weights[w]) * e0 + (int)BC7Weights[w] * e1 + 32) >> 6;
+				}
+			}
+
+			uint32_t indices[16];
+			for (int i = 0; i < 16; i++)
+			{
+				float bestError = std::numeric_limits<float>::max();
+				for (uint32_t w = 0; w < 16; w++)
+				{
+					float error = 0.0f;
+					for (int c = 0; c < 4; c++)
+					{
+						float difference = (float)palette[w][c] - texels[i][c];
+						error += difference * difference;
+					}
+
+					if (error < bestError)
+					{
+						bestError = error;
+						indices[i] = w;
+					}
+				}
+			}
+
+			// Most significant bit of the first index is implicitly 0, swap the endpoints if it isn't
+			if (indices[0] & 8)
+			{
+				std::swap(quantized[0], quantized[1]);
+				std::swap(pBits[0], pBits[1]);
+				for (int i = 0; i < 16; i++)
+					indices[i] = 15 - indices[i];
+			}
+
+			BitWriter writer(out);
+			writer.Write(1 << 6, 7); // Mode 6
+			for (int c = 0; c < 4; c++)
+			{
+				writer.Write(quantized[0][c], 7);
+				writer.Write(quantized[1][c], 7);
+			}
+			writer.Write(pBits[0], 1);
+			writer.Write(pBits[1], 1);
+
+			writer.Write(indices[0], 3);
+			for (int i = 1; i < 16; i++)
+				writer.Write(indices[i], 4);
+		}
+
+		void EncodeBC7(const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* out, ThreadPool* threadPool)
+		{
+			uint32_t blocksX = (width + 3) / 4;
+			uint32_t blocksY = (height + 3) / 4;
+
+			ParallelFor(threadPool, blocksY, [=](uint32_t blockY)
+				{
+					for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+					{
+						// Texels outside of the image are clamped to the edge
+						glm::vec4 texels[16];
+						for (uint32_t y = 0; y < 4; y++)
+						{
+							for (uint32_t x = 0; x < 4; x++)
+							{
+								uint32_t pixelX = glm::min(blockX * 4 + x, width - 1);
+								uint32_t pixelY = glm::min(blockY * 4 + y, height - 1);
+								const uint8_t* texel = pixels + ((uint64_t)pixelY * width + pixelX) * 4;
+								texels[y * 4 + x] = glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+							}
+						}
+
+						EncodeBC7Block(texels, out + ((uint64_t)blockY * blocksX + blockX) * 16);
+					}
+				});
+		}
+	}
+
+	std::string TextureCache::GetCachePath(const std::string& sourcePath, VkFormat format)
+	{
+		// Same hash as ModelCache::GetCachePath, it doesn't depend on the compiler
+		std::string path = AssetPack::NormalizePath(sourcePath);
+		return "CachedTextures/" + std::to_string(Bytes::Hash64(path.data(), path.size())) + "_" + std::to_string((int)format) + ".cache";
+	}
+
+	bool TextureCache::IsHDRFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_R32G32B32A32_SFLOAT || format == VK_FORMAT_R16G16B16A16_SFLOAT || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+	}
+
+	uint64_t TextureCache::GetMipChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount)
+	{
+		uint64_t size = 0;
+		for (uint32_t i = 0; i < mipCount; i++)
+			size += Image::GetImageDataSize(format, glm::max(width >> i, 1u), glm::max(height >> i, 1u));
+
+		return size;
+	}
+
+	bool TextureCache::Read(const std::string& sourcePath, VkFormat format, Texture& outTexture)
+	{
+		// Caches shipped in an asset pack are trusted as they are, sources usually aren't shipped along with them
+		std::span<const char> packed;
+		if (AssetManager::FindPackedFile(GetCachePath(sourcePath, format), packed))
+			return Parse(packed, sourcePath, format, false, outTexture);
+
+		// Cache read ahead by the asset manager, validated against the source like one read from the disk
+		Ref<const std::vector<char>> preloaded;
+		if (AssetManager::FindPreloadedFile(GetCachePath(sourcePath, format), preloaded))
+		{
+			if (!Parse({ preloaded->data(), preloaded->size() }, sourcePath, format, true, outTexture))
+				return false;
+
+			outTexture.Buffer = std::move(preloaded);
+			return true;
+		}
+
+		MappedFile file;
+		if (!file.Init({ GetCachePath(sourcePath, format) }))
+			return false;
+
+		if (!Parse(file.GetSpan(), sourcePath, format, true, outTexture))
+			return false;
+
+		outTexture.File = std::move(file);
+		return true;
+	}
+
+	bool TextureCache::Parse(std::span<const char> cache, const std::string& sourcePath, VkFormat format, bool validateSource, Texture& outTexture)
+	{
+		const char* data = cache.data();
+		const uint64_t fileSize = cache.size();
+
+		auto inRange = [fileSize](uint64_t offset, uint64_t size)
+		{
+			return offset <= fileSize && size <= fileSize - offset;
+		};
+
+		if (!inRange(0, sizeof(Header)))
+			return false;
+
+		Header header;
+		memcpy(&header, data, sizeof(Header));
+
+		if (header.Magic != Magic || header.Version != Version || header.FileSize != fileSize || header.Format != (uint32_t)format)
+			return false;
+
+		if (validateSource)
+		{
+			uint64_t sourceHash, sourceSize;
+			if (!AssetManager::HashFile(sourcePath, sourceHash, sourceSize))
+				return false;
+
+			if (header.SourceHash != sourceHash || header.SourceSize != sourceSize)
+				return false;
+		}
+
+		bool HDR = IsHDRFormat(format);
+		uint64_t envAccelCount = HDR ? (uint64_t)header.Width * header.Height : 0;
+		if (header.Width == 0 || header.Height == 0 || header.MipCount == 0 || header.MipCount > GetFullMipCount(header.Width, header.Height)
+			|| header.PixelsSize != GetMipChainSize(format, header.Width, header.Height, header.MipCount)
+			|| !inRange(header.PixelsOffset, header.PixelsSize) || header.PixelsOffset % DataAlignment != 0
+			|| header.EnvAccelCount != envAccelCount || header.EnvAccelOffset % DataAlignment != 0
+			|| !inRange(header.EnvAccelOffset, header.EnvAccelCount * sizeof(Image::EnvAccel)))
+		{
+			VK_CORE_WARN("Texture cache for {0} is corrupted, rebuilding", sourcePath);
+			return false;
+		}
+
+		Texture texture;
+		texture.Width = header.Width;
+		texture.Height = header.Height;
+		texture.MipCount = header.MipCount;
+		texture.Format = format;
+		texture.Pixels = { data + header.PixelsOffset, (size_t)header.PixelsSize };
+		texture.EnvAccel = { (const Image::EnvAccel*)(data + header.EnvAccelOffset), (size_t)header.EnvAccelCount };
+
+		outTexture = std::move(texture);
+		return true;
+	}
+
+	void TextureCache::Write(const std::string& sourcePath, const Texture& texture)
+	{
+		Header header{};
+		header.Magic = Magic;
+		header.Version = Version;
+		header.Width = texture.Width;
+		header.Height = texture.Height;
+		header.MipCount = texture.MipCount;
+		header.Format = (uint32_t)texture.Format;
+
+		if (!AssetManager::HashFile(sourcePath, header.SourceHash, header.SourceSize))
+			return;
+
+		header.PixelsOffset = Align(sizeof(Header));
+		header.PixelsSize = texture.Pixels.size();
+		header.EnvAccelOffset = Align(header.PixelsOffset + header.PixelsSize);
+		header.EnvAccelCount = texture.EnvAccel.size();
+		header.FileSize = header.EnvAccelOffset + texture.EnvAccel.size_bytes();
+
+		std::string cachePath = GetCachePath(sourcePath, texture.Format);
+		std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path());
+
+		// Write into temporary file first so that a crash mid way never leaves a broken cache behind
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				VK_CORE_WARN("Failed to write texture cache {0}", cachePath);
+				return;
+			}
+
+			const char zeros[DataAlignment] = {};
+
+			file.write((const char*)&header, sizeof(Header));
+			file.write(zeros, header.PixelsOffset - sizeof(Header));
+			file.write(texture.Pixels.data(), texture.Pixels.size());
+			file.write(zeros, header.EnvAccelOffset - (header.PixelsOffset + header.PixelsSize));
+			file.write((const char*)texture.EnvAccel.data(), texture.EnvAccel.size_bytes());
+
+			if (!file.good())
+			{
+				VK_CORE_WARN("Failed to write texture cache {0}", cachePath);
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error)
+			VK_CORE_WARN("Failed to write texture cache {0}: {1}", cachePath, error.message());
+	}
+
+	void TextureCache::Cook(const std::string& sourcePath, VkFormat format, Texture& outTexture, ThreadPool* threadPool)
+	{
+		VK_CORE_ASSERT(format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_BC7_UNORM_BLOCK || IsHDRFormat(format), "Unsupported cooked texture format! Format: {}", (int)format);
+
+		bool HDR = IsHDRFormat(format);
+
+		int texChannels;
+		bool flipOnLoad = !HDR;
+		stbi_set_flip_vertically_on_load_thread(flipOnLoad);
+		int sizeX, sizeY;
+		void* pixels = nullptr;
+
+		// Source is decoded straight from the pack mapping if it's packed, or from the buffer it was read ahead into.
+		// Otherwise it's decoded from a mapping of the file itself instead of going through stdio buffers
+		std::span<const char> source;
+		Ref<const std::vector<char>> preloaded;
+		MappedFile file;
+		if (AssetManager::FindPreloadedFile(sourcePath, preloaded))
+			source = { preloaded->data(), preloaded->size() };
+		else if (!AssetManager::FindPackedFile(sourcePath, source) && file.Init({ sourcePath }))
+			source = file.GetSpan();
+
+		// stb_image takes the size as int
+		if (!source.empty() && source.size() <= (size_t)std::numeric_limits<int>::max())
+		{
+			const stbi_uc* sourceData = (const stbi_uc*)source.data();
+			if (HDR)
+				pixels = stbi_loadf_from_memory(sourceData, (int)source.size(), &sizeX, &sizeY, &texChannels, STBI_rgb_alpha);
+			else
+				pixels = stbi_load_from_memory(sourceData, (int)source.size(), &sizeX, &sizeY, &texChannels, STBI_rgb_alpha);
+		}
+
+		std::filesystem::path cwd = std::filesystem::current_path();
+		VK_CORE_ASSERT(pixels, "failed to load texture image! Path: {0}, Current working directory: {1}", sourcePath, cwd.string());
+
+		Texture texture;
+		texture.Width = (uint32_t)sizeX;
+		texture.Height = (uint32_t)sizeY;
+		texture.MipCount = GetFullMipCount(texture.Width, texture.Height);
+		texture.Format = format;
+
+		// Importance sampling data comes from the full resolution source, this also writes the PDF into the alpha channel
+		if (HDR)
+		{
+			float average, integral;
+			texture.EnvAccelStorage = Image::CreateEnvAccel((float*)pixels, texture.Width, texture.Height, average, integral);
+		}
+
+		VkFormat uncompressedFormat = HDR ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+		std::vector<char> chain(GetMipChainSize(uncompressedFormat, texture.Width, texture.Height, texture.MipCount));
+		memcpy(chain.data(), pixels, Image::GetImageDataSize(uncompressedFormat, texture.Width, texture.Height));
+
+		stbi_image_free(pixels);
+
+		uint64_t offset = 0;
+		for (uint32_t i = 1; i < texture.MipCount; i++)
+		{
+			uint32_t width = glm::max(texture.Width >> (i - 1), 1u);
+			uint32_t height = glm::max(texture.Height >> (i - 1), 1u);
+			uint64_t size = Image::GetImageDataSize(uncompressedFormat, width, height);
+
+			if (HDR)
+				DownsampleLevel((const float*)(chain.data() + offset), width, height, (float*)(chain.data() + offset + size), threadPool);
+			else
+				DownsampleLevel((const uint8_t*)(chain.data() + offset), width, height, (uint8_t*)(chain.data() + offset + size), threadPool);
+
+			offset += size;
+		}
+
+		if (format == VK_FORMAT_R16G16B16A16_SFLOAT || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+		{
+			// Whole chain is converted at once, conversion is per texel so level boundaries don't matter
+			uint64_t texelCount = chain.size() / (sizeof(float) * 4);
+			texture.PixelStorage.resize(GetMipChainSize(format, texture.Width, texture.Height, texture.MipCount));
+
+			const uint64_t texelsPerTask = 64 * 1024;
+			uint32_t taskCount = (uint32_t)((texelCount + texelsPerTask - 1) / texelsPerTask);
+			ParallelFor(threadPool, taskCount, [&chain, &texture, texelCount, texelsPerTask, format](uint32_t task)
+				{
+					uint64_t first = task * texelsPerTask;
+					uint64_t count = glm::min(texelsPerTask, texelCount - first);
+					const float* src = (const float*)chain.data() + first * 4;
+
+					if (format == VK_FORMAT_R16G16B16A16_SFLOAT)
+						PixelConversion::RGBA32FToRGBA16F(src, (uint16_t*)texture.PixelStorage.data() + first * 4, count);
+					else
+						PixelConversion::RGBA32FToE5B9G9R9(src, (uint32_t*)texture.PixelStorage.data() + first, count);
+				});
+		}
+		else if (format == VK_FORMAT_BC7_UNORM_BLOCK)
+		{
+			texture.PixelStorage.resize(GetMipChainSize(format, texture.Width, texture.Height, texture.MipCount));
+
+			uint64_t srcOffset = 0;
+			uint64_t dstOffset = 0;
+			for (uint32_t i = 0; i < texture.MipCount; i++)
+			{
+				uint32_t width = glm::max(texture.Width >> i, 1u);
+				uint32_t height = glm::max(texture.Height >> i, 1u);
+
+				EncodeBC7((const uint8_t*)(chain.data() + srcOffset), width, height, (uint8_t*)(texture.PixelStorage.data() + dstOffset), threadPool);
+
+				srcOffset += Image::GetImageDataSize(uncompressedFormat, width, height);
+				dstOffset += Image::GetImageDataSize(format, width, height);
+			}
+		}
+		else
+		{
+			texture.PixelStorage = std::move(chain);
+		}
+
+		texture.Pixels = texture.PixelStorage;
+		texture.EnvAccel = texture.EnvAccelStorage;
+
+		outTexture = std::move(texture);
+	}
+}
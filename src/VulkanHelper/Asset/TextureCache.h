@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+#include "Vulkan/Image.h"
+#include "Utility/Utility.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Cooked representation of a texture file. It stores the full mip chain generated on the CPU, optionally
+	 * block compressed, so loading a cooked texture is a single upload with no decoding and no blit pass.
+	 * HDR textures also store their importance sampling data, computed from the full resolution source.
+	 *
+	 * Cache files are memory mapped and store the hash and size of the source so they are rebuilt whenever it changes.
+	 */
+	class TextureCache
+	{
+	public:
+		static constexpr uint32_t Magic = 0x43544856; // "VHTC"
+		static constexpr uint32_t Version = 1;
+
+		struct Texture
+		{
+			uint32_t Width = 0;
+			uint32_t Height = 0;
+			uint32_t MipCount = 0;
+			VkFormat Format = VK_FORMAT_MAX_ENUM;
+
+			// Every mip level packed one after another, starting with the biggest one
+			std::span<const char> Pixels;
+
+			// HDR only
+			std::span<const Image::EnvAccel> EnvAccel;
+
+			// Memory that the spans point to, either vectors filled during cooking, the mapped cache file
+			// or the buffer the cache file was read ahead into
+			std::vector<char> PixelStorage;
+			std::vector<Image::EnvAccel> EnvAccelStorage;
+			MappedFile File;
+			Ref<const std::vector<char>> Buffer;
+		};
+
+		// Every format is cached separately so switching formats of a texture doesn't throw away the other ones
+		static std::string GetCachePath(const std::string& sourcePath, VkFormat format);
+
+		// Returns false if there is no valid cache for the source file in the requested format
+		static bool Read(const std::string& sourcePath, VkFormat format, Texture& outTexture);
+		static void Write(const std::string& sourcePath, const Texture& texture);
+
+		// Decodes the source, generates mips and encodes them into format. Supported formats are
+		// VK_FORMAT_R8G8B8A8_UNORM and VK_FORMAT_BC7_UNORM_BLOCK for LDR sources, VK_FORMAT_R32G32B32A32_SFLOAT,
+		// VK_FORMAT_R16G16B16A16_SFLOAT and VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 for HDR ones.
+		// Work is spread across the thread pool if one is provided.
+		static void Cook(const std::string& sourcePath, VkFormat format, Texture& outTexture, ThreadPool* threadPool = nullptr);
+
+		static bool IsHDRFormat(VkFormat format);
+		static uint64_t GetMipChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount);
+	private:
+		static bool Parse(std::span<const char> cache, const std::string& sourcePath, VkFormat format, bool validateSource, Texture& outTexture);
+	};
+}
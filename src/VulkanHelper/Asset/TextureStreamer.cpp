@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+
+namespace VulkanHelper
+{
+	TextureStreamer::~TextureStreamer()
+	{
+		Destroy();
+	}
+
+	void TextureStreamer::Init(ThreadPool* threadPool)
+	{
+		if (m_Initialized)
+			Destroy();
+
+		m_ThreadPool = threadPool;
+		m_Initialized = true;
+	}
+
+	void TextureStreamer::Destroy()
+	{
+		if (!m_Initialized)
+			return;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_UploadFinished.wait(lock, [this]() { return m_UploadsInFlight == 0; });
+
+		// Handles are released outside of the lock since that can unload the textures
+		std::unordered_map<AssetHandle, Stream> streams = std::move(m_Streams);
+		m_Streams.clear();
+		lock.unlock();
+
+		streams.clear();
+
+		m_ThreadPool = nullptr;
+		m_Initialized = false;
+	}
+
+	uint32_t TextureStreamer::GetTailMip(const TextureCache::Texture& texture)
+	{
+		uint32_t mip = 0;
+		while (mip + 1 < texture.MipCount && glm::max(texture.Width >> mip, texture.Height >> mip) > MipTailSize)
+			mip++;
+
+		return mip;
+	}
+
+	void TextureStreamer::AddTexture(const AssetHandle& handle, Ref<TextureCache::Texture> data, uint32_t residentMip)
+	{
+		VK_CORE_ASSERT(m_Initialized, "TextureStreamer Not Initialized!");
+
+		if (residentMip == 0)
+			return;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		Stream& stream = m_Streams[handle];
+		stream.Texture = handle;
+		stream.Data = std::move(data);
+		stream.ResidentMip = residentMip;
+	}
+
+	void TextureStreamer::SetPriority(const AssetHandle& handle, float priority)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		auto iter = m_Streams.find(handle);
+		if (iter != m_Streams.end())
+			iter->second.Priority = priority;
+	}
+
+	void TextureStreamer::Update()
+	{
+		if (!m_Initialized)
+			return;
+
+		std::vector<std::pair<AssetHandle, uint32_t>> landed;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			for (auto& [handle, stream] : m_Streams)
+			{
+				if (stream.Uploaded)
+					landed.emplace_back(handle, stream.ResidentMip - 1);
+			}
+		}
+
+		if (!landed.empty())
+		{
+			// Old views are destroyed and descriptors rewritten, nothing on the GPU can be using them
+			{
+				std::unique_lock<std::mutex> queueLock(Device::GetGraphicsQueueMutex());
+				vkQueueWaitIdle(Device::GetGraphicsQueue());
+			}
+
+			for (auto& [handle, mip] : landed)
+			{
+				if (handle.DoesHandleExist())
+					dynamic_cast<TextureAsset*>(handle.GetAsset())->SetResidentMip(mip);
+			}
+
+			std::vector<Stream> finished;
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			for (auto& [handle, mip] : landed)
+			{
+				auto iter = m_Streams.find(handle);
+
+				iter->second.ResidentMip = mip;
+				iter->second.Uploaded = false;
+
+				if (mip == 0 || !handle.DoesHandleExist())
+				{
+					finished.push_back(std::move(iter->second));
+					m_Streams.erase(iter);
+				}
+			}
+			lock.unlock();
+
+			// Finished streams release their handles here, outside of the lock
+		}
+
+		ScheduleUploads();
+	}
+
+	bool TextureStreamer::IsStreaming()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		return !m_Streams.empty();
+	}
+
+	void TextureStreamer::ScheduleUploads()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (m_UploadsInFlight < MaxUploadsInFlight)
+		{
+			Stream* next = nullptr;
+			for (auto& [handle, stream] : m_Streams)
+			{
+				if (stream.Uploading || stream.Uploaded)
+					continue;
+
+				if (next == nullptr || stream.Priority > next->Priority)
+					next = &stream;
+			}
+
+			if (next == nullptr)
+				break;
+
+			next->Uploading = true;
+			m_UploadsInFlight++;
+
+			m_ThreadPool->PushTask([this](AssetHandle handle, Ref<TextureCache::Texture> data, uint32_t mip)
+				{
+					// Texture could have been unloaded explicitly, in that case the stream is dropped in the next Update
+					if (handle.DoesHandleExist())
+					{
+						uint64_t offset = TextureCache::GetMipChainSize(data->Format, data->Width, data->Height, mip);
+						handle.GetImage()->WriteMipRange(data->Pixels.data() + offset, mip, 1);
+					}
+
+					std::unique_lock<std::mutex> lock(m_Mutex);
+
+					Stream& stream = m_Streams[handle];
+					stream.Uploading = false;
+					stream.Uploaded = true;
+
+					m_UploadsInFlight--;
+					m_UploadFinished.notify_all();
+				}, next->Texture, next->Data, next->ResidentMip - 1);
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "pch.h"
+
+#include "Asset.h"
+#include "TextureCache.h"
+#include "Utility/Utility.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Streams mip levels of textures that were loaded with only their mip tail resident. Levels are uploaded
+	 * one at a time on the thread pool, going from the smallest missing one up, and textures with higher priority
+	 * are served first.
+	 *
+	 * Uploaded levels become visible in Update, which swaps the image view and rewrites every tracked descriptor in
+	 * place. Since descriptors of sets that are in flight can't be touched, Update waits for the graphics queue to go
+	 * idle first, but only when there is something to swap. Pending levels are batched so that happens rarely.
+	 */
+	class TextureStreamer
+	{
+	public:
+		// Levels this big or smaller are uploaded when the texture is loaded, everything above is streamed
+		static constexpr uint32_t MipTailSize = 128;
+		static constexpr uint32_t MaxUploadsInFlight = 2;
+
+		TextureStreamer() = default;
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer& other) = delete;
+		TextureStreamer(TextureStreamer&& other) noexcept = delete;
+		TextureStreamer& operator=(const TextureStreamer& other) = delete;
+		TextureStreamer& operator=(TextureStreamer&& other) noexcept = delete;
+
+		void Init(ThreadPool* threadPool);
+		void Destroy();
+
+		// Returns the first level that has to be resident when the texture is created
+		static uint32_t GetTailMip(const TextureCache::Texture& texture);
+
+		// Texture has to be created with ResidentMip set to residentMip, data keeps the rest of the levels
+		void AddTexture(const AssetHandle& handle, Ref<TextureCache::Texture> data, uint32_t residentMip);
+		void SetPriority(const AssetHandle& handle, float priority);
+
+		// Has to be called outside of a frame, from the thread that records the command buffers
+		void Update();
+
+		bool IsStreaming();
+
+		inline bool IsInitialized() const { return m_Initialized; }
+	private:
+		struct Stream
+		{
+			// Holds the texture alive until every level is streamed in
+			AssetHandle Texture;
+			Ref<TextureCache::Texture> Data;
+
+			uint32_t ResidentMip = 0;
+			float Priority = 0.0f;
+
+			bool Uploading = false;
+
+			// Level ResidentMip - 1 is on the GPU and waits for Update to make it visible
+			bool Uploaded = false;
+		};
+
+		void ScheduleUploads();
+
+		ThreadPool* m_ThreadPool = nullptr;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_UploadFinished;
+		std::unordered_map<AssetHandle, Stream> m_Streams;
+		uint32_t m_UploadsInFlight = 0;
+
+		bool m_Initialized = false;
+	};
+}
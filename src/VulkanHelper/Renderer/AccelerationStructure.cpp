@@ -22,14 +22,21 @@ namespace VulkanHelper
 
 		uint32_t primitiveCount			= (uint32_t)mesh->GetIndexCount() / 3;
 
-		// Describe buffer as array of Mesh::Vertex.
+		// Describe buffer as array of Mesh::Vertex or Mesh::PackedVertex.
 		VkAccelerationStructureGeometryTrianglesDataKHR triangles{ VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR };
 		triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
 		triangles.vertexData.deviceAddress = vertexAddress;
-		triangles.vertexStride = sizeof(Mesh::Vertex);
-		triangles.indexType = VK_INDEX_TYPE_UINT32;
+		triangles.vertexStride = mesh->GetVertexSize();
+		triangles.indexType = mesh->GetIndexType();
 		triangles.indexData.deviceAddress = indexAddress;
 		triangles.transformData = {};
+
+		// Packed positions are snorm, the build dequantizes them with the transform so the BLAS is in mesh space
+		if (mesh->GetVertexLayout() == Mesh::VertexLayout::Packed)
+		{
+			triangles.vertexFormat = VK_FORMAT_R16G16B16A16_SNORM;
+			triangles.transformData.deviceAddress = mesh->GetDequantizationBuffer()->GetDeviceAddress();
+		}
 		triangles.maxVertex = (uint32_t)mesh->GetVertexCount() - 1;
 
 		// Identify the above data as opaque triangles.
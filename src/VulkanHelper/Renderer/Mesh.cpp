@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "Mesh.h"
 
+#include "glm/gtc/packing.hpp"
+
 namespace VulkanHelper
 {
 
@@ -13,6 +15,16 @@ namespace VulkanHelper
 		m_Initialized = true;
 	}
 
+	void Mesh::Init(std::span<const Vertex> vertices, std::span<const uint32_t> indices, VkBufferUsageFlags vertexUsageFlags, VkBufferUsageFlags indexUsageFlags, UploadBatch* batch, VertexLayout layout)
+	{
+		if (m_Initialized)
+			Destroy();
+
+		CreateVertexBuffer(vertices, vertexUsageFlags, batch, layout);
+		CreateIndexBuffer(indices, indexUsageFlags, batch);
+		m_Initialized = true;
+	}
+
 	void Mesh::Init(aiMesh* mesh, const aiScene* scene, const glm::mat4& mat, VkBufferUsageFlags customUsageFlags)
 	{
 		if (m_Initialized)
@@ -28,8 +40,18 @@ namespace VulkanHelper
 			return;
 
 		m_VertexBuffer.Destroy();
+		if (m_DequantizationBuffer.IsInitialized())
+			m_DequantizationBuffer.Destroy();
 		if (m_HasIndexBuffer)
 			m_IndexBuffer.Destroy();
+		if (m_MeshletCount > 0)
+		{
+			m_MeshletBuffer.Destroy();
+			m_MeshletVertexBuffer.Destroy();
+			m_MeshletTriangleBuffer.Destroy();
+		}
+		if (!m_Lods.empty())
+			m_LodIndexBuffer.Destroy();
 
 		Reset();
 	}
@@ -41,8 +63,16 @@ namespace VulkanHelper
 
 	void Mesh::CreateMesh(const CreateInfo& createInfo)
 	{
-		CreateVertexBuffer(createInfo.Vertices, createInfo.VertexUsageFlags);
-		CreateIndexBuffer(createInfo.Indices, createInfo.IndexUsageFlags);
+		std::span<const Vertex> vertices;
+		if (createInfo.Vertices != nullptr)
+			vertices = *createInfo.Vertices;
+
+		std::span<const uint32_t> indices;
+		if (createInfo.Indices != nullptr)
+			indices = *createInfo.Indices;
+
+		CreateVertexBuffer(vertices, createInfo.VertexUsageFlags, createInfo.Batch, createInfo.Layout);
+		CreateIndexBuffer(indices, createInfo.IndexUsageFlags, createInfo.Batch);
 	}
 
 	void Mesh::CreateMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 mat, VkBufferUsageFlags customUsageFlags)
@@ -50,6 +80,22 @@ namespace VulkanHelper
 		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
 
+		ConvertAssimpMesh(mesh, mat, vertices, indices);
+
+		CreateVertexBuffer(vertices);
+		CreateIndexBuffer(indices);
+	}
+
+	void Mesh::ConvertAssimpMesh(aiMesh* mesh, const glm::mat4& mat, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices)
+	{
+		std::vector<Vertex>& vertices = outVertices;
+		std::vector<uint32_t>& indices = outIndices;
+
+		vertices.clear();
+		indices.clear();
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve((size_t)mesh->mNumFaces * 3);
+
 		// vertices
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
@@ -94,84 +140,727 @@ namespace VulkanHelper
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
-
-		CreateVertexBuffer(&vertices);
-		CreateIndexBuffer(&indices);
 	}
 
-	void Mesh::CreateVertexBuffer(const std::vector<Vertex>* const vertices, VkBufferUsageFlags customUsageFlags)
+	void Mesh::CreateVertexBuffer(std::span<const Vertex> vertices, VkBufferUsageFlags customUsageFlags, UploadBatch* batch, VertexLayout layout)
 	{
-		m_VertexCount = (uint64_t)vertices->size();
-		VkDeviceSize bufferSize = sizeof(Vertex) * m_VertexCount;
-		uint32_t vertexSize = sizeof(Vertex);
+		m_VertexCount = (uint64_t)vertices.size();
+		m_Layout = layout;
+
+		// Sphere around the center of the bounding box, it's used to pick LODs so it doesn't have to be the tightest
+		m_BoundsCenter = glm::vec3(0.0f);
+		m_BoundsRadius = 0.0f;
+		if (!vertices.empty())
+		{
+			glm::vec3 min = vertices[0].Position;
+			glm::vec3 max = vertices[0].Position;
+			for (const Vertex& vertex : vertices)
+			{
+				min = glm::min(min, vertex.Position);
+				max = glm::max(max, vertex.Position);
+			}
+
+			m_BoundsCenter = (min + max) * 0.5f;
+			for (const Vertex& vertex : vertices)
+				m_BoundsRadius = glm::max(m_BoundsRadius, glm::length(vertex.Position - m_BoundsCenter));
+		}
+
+		// Packed vertices only exist for the upload, the data that's kept on the CPU stays in the full layout
+		const void* vertexData = vertices.data();
+		std::vector<PackedVertex> packedVertices;
+		if (m_Layout == VertexLayout::Packed)
+		{
+			GetPackingBounds(vertices, m_PositionCenter, m_PositionExtent);
+
+			packedVertices.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				packedVertices[i] = PackVertex(vertices[i], m_PositionCenter, m_PositionExtent);
+
+			vertexData = packedVertices.data();
+		}
+
+		uint32_t vertexSize = GetVertexSize();
+		VkDeviceSize bufferSize = (VkDeviceSize)vertexSize * m_VertexCount;
+
+		VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		if (Device::UseRayTracing())
+			usageFlags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
 		Buffer::CreateInfo bufferInfo{};
 		bufferInfo.InstanceSize = vertexSize;
 		bufferInfo.InstanceCount = m_VertexCount;
+		bufferInfo.UsageFlags = usageFlags | customUsageFlags;
+		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		m_VertexBuffer.Init(bufferInfo);
+
+		if (m_Layout == VertexLayout::Packed && Device::UseRayTracing())
+			CreateDequantizationBuffer();
+
+		if (batch != nullptr)
+		{
+			batch->UploadToBuffer(vertexData, bufferSize, m_VertexBuffer);
+			return;
+		}
+
 		bufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 		Buffer stagingBuffer;
 		stagingBuffer.Init(bufferInfo);
 
 		stagingBuffer.Map();
-		stagingBuffer.WriteToBuffer((void*)vertices->data());
+		stagingBuffer.WriteToBuffer((void*)vertexData);
 		stagingBuffer.Flush();
 
-		VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-		if (Device::UseRayTracing())
-			usageFlags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		
-		bufferInfo.UsageFlags = usageFlags | customUsageFlags;
-		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		m_VertexBuffer.Init(bufferInfo);
-
 		Buffer::CopyBuffer(stagingBuffer.GetBuffer(), m_VertexBuffer.GetBuffer(), bufferSize, 0, 0, Device::GetGraphicsQueue(), 0, Device::GetGraphicsCommandPool());
 	}
 
-	void Mesh::CreateIndexBuffer(const std::vector<uint32_t>* const  indices, VkBufferUsageFlags customUsageFlags)
+	void Mesh::CreateDequantizationBuffer()
+	{
+		// Row major 3x4, positions are scaled by the extent and moved to the center
+		VkTransformMatrixKHR transform{};
+		transform.matrix[0][0] = m_PositionExtent.x;
+		transform.matrix[1][1] = m_PositionExtent.y;
+		transform.matrix[2][2] = m_PositionExtent.z;
+		transform.matrix[0][3] = m_PositionCenter.x;
+		transform.matrix[1][3] = m_PositionCenter.y;
+		transform.matrix[2][3] = m_PositionCenter.z;
+
+		// Small enough that it's simply kept in host visible memory
+		Buffer::CreateInfo bufferInfo{};
+		bufferInfo.InstanceSize = sizeof(VkTransformMatrixKHR);
+		bufferInfo.InstanceCount = 1;
+		bufferInfo.MinMemoryAlignment = 16;
+		bufferInfo.UsageFlags = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		m_DequantizationBuffer.Init(bufferInfo);
+
+		m_DequantizationBuffer.Map();
+		m_DequantizationBuffer.WriteToBuffer(&transform);
+		m_DequantizationBuffer.Flush();
+		m_DequantizationBuffer.Unmap();
+	}
+
+	static glm::vec2 EncodeOctahedral(glm::vec3 normal)
 	{
-		if (indices == nullptr)
+		normal /= glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+
+		glm::vec2 encoded(normal.x, normal.y);
+		if (normal.z < 0.0f)
 		{
-			m_HasIndexBuffer = false;
+			glm::vec2 sign(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+			encoded = (1.0f - glm::abs(glm::vec2(normal.y, normal.x))) * sign;
+		}
+
+		return encoded;
+	}
+
+	// Same as DecodeOctahedral in Shaders/PackedVertex.glsl
+	static glm::vec3 DecodeOctahedral(glm::vec2 encoded)
+	{
+		glm::vec3 normal(encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+		float t = glm::max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -t : t;
+		normal.y += normal.y >= 0.0f ? -t : t;
+
+		return glm::normalize(normal);
+	}
+
+	void Mesh::GetPackingBounds(std::span<const Vertex> vertices, glm::vec3& outCenter, glm::vec3& outExtent)
+	{
+		if (vertices.empty())
+		{
+			outCenter = glm::vec3(0.0f);
+			outExtent = glm::vec3(1.0f);
 			return;
 		}
-		m_IndexCount = (uint32_t)indices->size();
-		m_HasIndexBuffer = m_IndexCount > 0;
-		if (!m_HasIndexBuffer) { return; }
 
-		VkDeviceSize bufferSize = sizeof(uint32_t) * m_IndexCount;
-		uint32_t indexSize = sizeof(uint32_t);
+		glm::vec3 min = vertices[0].Position;
+		glm::vec3 max = vertices[0].Position;
+		for (const Vertex& vertex : vertices)
+		{
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+
+		outCenter = (min + max) * 0.5f;
+		outExtent = (max - min) * 0.5f;
+
+		// Flat axes would divide by zero, every position on them is the center anyway
+		for (int i = 0; i < 3; i++)
+		{
+			if (outExtent[i] <= 0.0f)
+				outExtent[i] = 1.0f;
+		}
+	}
+
+	Mesh::PackedVertex Mesh::PackVertex(const Vertex& vertex, const glm::vec3& center, const glm::vec3& extent)
+	{
+		PackedVertex packed{};
+
+		glm::vec3 position = (vertex.Position - center) / extent;
+		for (int i = 0; i < 3; i++)
+			packed.Position[i] = (int16_t)glm::packSnorm1x16(position[i]);
+
+		// Zero length normals are left as zero, they decode to +Z
+		float length = glm::length(vertex.Normal);
+		if (length > 0.0f)
+		{
+			glm::vec2 normal = EncodeOctahedral(vertex.Normal / length);
+			packed.Normal[0] = (int16_t)glm::packSnorm1x16(normal.x);
+			packed.Normal[1] = (int16_t)glm::packSnorm1x16(normal.y);
+		}
+
+		packed.TexCoord[0] = glm::packHalf1x16(vertex.TexCoord.x);
+		packed.TexCoord[1] = glm::packHalf1x16(vertex.TexCoord.y);
+
+		return packed;
+	}
+
+	Mesh::Vertex Mesh::UnpackVertex(const PackedVertex& vertex, const glm::vec3& center, const glm::vec3& extent)
+	{
+		Vertex unpacked{};
+
+		for (int i = 0; i < 3; i++)
+			unpacked.Position[i] = glm::unpackSnorm1x16((uint16_t)vertex.Position[i]);
+		unpacked.Position = unpacked.Position * extent + center;
+
+		unpacked.Normal = DecodeOctahedral({ glm::unpackSnorm1x16((uint16_t)vertex.Normal[0]), glm::unpackSnorm1x16((uint16_t)vertex.Normal[1]) });
+
+		unpacked.TexCoord.x = glm::unpackHalf1x16(vertex.TexCoord[0]);
+		unpacked.TexCoord.y = glm::unpackHalf1x16(vertex.TexCoord[1]);
+
+		return unpacked;
+	}
+
+	Mesh::VertexLayout Mesh::ChooseVertexLayout(std::span<const Vertex> vertices, const PackingTolerance& tolerance)
+	{
+		if (vertices.empty())
+			return VertexLayout::Full;
+
+		glm::vec3 center;
+		glm::vec3 extent;
+		GetPackingBounds(vertices, center, extent);
+
+		// Errors are measured on the exact round trip rather than estimated from the bounds, that catches half
+		// float overflow as well. Comparisons are negated so that NaNs fail them
+		for (const Vertex& vertex : vertices)
+		{
+			Vertex unpacked = UnpackVertex(PackVertex(vertex, center, extent), center, extent);
+
+			glm::vec3 positionError = glm::abs(unpacked.Position - vertex.Position);
+			if (!(glm::max(positionError.x, glm::max(positionError.y, positionError.z)) <= tolerance.Position))
+				return VertexLayout::Full;
+
+			glm::vec2 texCoordError = glm::abs(unpacked.TexCoord - vertex.TexCoord);
+			if (!(glm::max(texCoordError.x, texCoordError.y) <= tolerance.TexCoord))
+				return VertexLayout::Full;
+
+			// Meshes without normals have them zeroed, there is nothing to lose there
+			float length = glm::length(vertex.Normal);
+			if (length > 0.0f && !(glm::length(unpacked.Normal - vertex.Normal / length) <= tolerance.Normal))
+				return VertexLayout::Full;
+		}
+
+		return VertexLayout::Packed;
+	}
+
+	namespace
+	{
+		// Bounding sphere and normal cone of a finished meshlet
+		void ComputeMeshletBounds(std::span<const Mesh::Vertex> vertices, const Mesh::MeshletData& data, Mesh::Meshlet& meshlet)
+		{
+			const uint32_t* meshletVertices = data.Vertices.data() + meshlet.VertexOffset;
+			const uint8_t* triangles = data.Triangles.data() + meshlet.TriangleOffset;
+
+			glm::vec3 min = vertices[meshletVertices[0]].Position;
+			glm::vec3 max = min;
+			for (uint32_t i = 1; i < meshlet.VertexCount; i++)
+			{
+				min = glm::min(min, vertices[meshletVertices[i]].Position);
+				max = glm::max(max, vertices[meshletVertices[i]].Position);
+			}
+
+			meshlet.Center = (min + max) * 0.5f;
+			meshlet.Radius = 0.0f;
+			for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+				meshlet.Radius = glm::max(meshlet.Radius, glm::length(vertices[meshletVertices[i]].Position - meshlet.Center));
+
+			// Cone around the average normal that contains the normal of every triangle
+			std::array<glm::vec3, Mesh::MaxMeshletTriangles> normals;
+			std::array<glm::vec3, Mesh::MaxMeshletTriangles> corners;
+			uint32_t normalCount = 0;
+			glm::vec3 axis(0.0f);
+			for (uint32_t i = 0; i < meshlet.TriangleCount; i++)
+			{
+				glm::vec3 a = vertices[meshletVertices[triangles[i * 3 + 0]]].Position;
+				glm::vec3 b = vertices[meshletVertices[triangles[i * 3 + 1]]].Position;
+				glm::vec3 c = vertices[meshletVertices[triangles[i * 3 + 2]]].Position;
+
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float length = glm::length(normal);
+				if (!(length > 0.0f))
+					continue;
+
+				normals[normalCount] = normal / length;
+				corners[normalCount] = a;
+				axis += normals[normalCount];
+				normalCount++;
+			}
+
+			meshlet.ConeApex = meshlet.Center;
+			meshlet.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+			meshlet.ConeCutoff = 1.0f;
+
+			float axisLength = glm::length(axis);
+			if (normalCount == 0 || !(axisLength > 1e-6f))
+				return;
+
+			axis /= axisLength;
+			meshlet.ConeAxis = axis;
+
+			float minDot = 1.0f;
+			for (uint32_t i = 0; i < normalCount; i++)
+				minDot = glm::min(minDot, glm::dot(normals[i], axis));
+
+			// Cones close to a half space would cull next to nothing and push the apex far away
+			if (minDot <= 0.1f)
+				return;
+
+			// Apex is moved back along the axis until it's behind the plane of every triangle
+			float maxDistance = 0.0f;
+			for (uint32_t i = 0; i < normalCount; i++)
+				maxDistance = glm::max(maxDistance, glm::dot(meshlet.Center - corners[i], normals[i]) / glm::dot(axis, normals[i]));
+
+			meshlet.ConeApex = meshlet.Center - axis * maxDistance;
+			meshlet.ConeCutoff = glm::sqrt(1.0f - minDot * minDot);
+		}
+	}
+
+	void Mesh::BuildMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices, MeshletData& outMeshlets)
+	{
+		outMeshlets.Meshlets.clear();
+		outMeshlets.Vertices.clear();
+		outMeshlets.Triangles.clear();
+
+		const uint32_t vertexCount = (uint32_t)vertices.size();
+		const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+		if (triangleCount == 0)
+			return;
+
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			if (indices[i] >= vertexCount)
+			{
+				VK_CORE_ERROR("Can't build meshlets, index {0} is out of range", indices[i]);
+				return;
+			}
+		}
+
+		// Triangles that use each vertex, stored as offsets into one array. Live counts are the triangles of each
+		// vertex that aren't in any meshlet yet
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacencyOffsets[indices[i] + 1]++;
+
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			liveTriangles[i] = adjacencyOffsets[i + 1];
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacency[adjacencyFill[indices[i]]++] = i / 3;
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint8_t> localIndices(vertexCount, 0xFF);
+
+		// Unused triangles that share a vertex with the current meshlet, each one is queued once per meshlet
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> queuedIn(triangleCount, UINT32_MAX);
+		uint32_t nextUnused = 0;
+
+		Meshlet meshlet{};
+		glm::vec3 positionSum(0.0f);
+
+		auto addTriangle = [&](uint32_t triangle)
+		{
+			emitted[triangle] = 1;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				uint32_t vertex = indices[triangle * 3 + i];
+				liveTriangles[vertex]--;
+
+				if (localIndices[vertex] == 0xFF)
+				{
+					localIndices[vertex] = (uint8_t)meshlet.VertexCount++;
+					outMeshlets.Vertices.push_back(vertex);
+					positionSum += vertices[vertex].Position;
+
+					uint32_t meshletIndex = (uint32_t)outMeshlets.Meshlets.size();
+					for (uint32_t j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; j++)
+					{
+						uint32_t neighbour = adjacency[j];
+						if (!emitted[neighbour] && queuedIn[neighbour] != meshletIndex)
+						{
+							queuedIn[neighbour] = meshletIndex;
+							candidates.push_back(neighbour);
+						}
+					}
+				}
+
+				outMeshlets.Triangles.push_back(localIndices[vertex]);
+			}
+
+			meshlet.TriangleCount++;
+		};
 
+		auto getNewVertexCount = [&](uint32_t triangle)
+		{
+			uint32_t a = indices[triangle * 3 + 0];
+			uint32_t b = indices[triangle * 3 + 1];
+			uint32_t c = indices[triangle * 3 + 2];
+
+			return (uint32_t)(localIndices[a] == 0xFF) + (uint32_t)(localIndices[b] == 0xFF && b != a)
+				+ (uint32_t)(localIndices[c] == 0xFF && c != a && c != b);
+		};
+
+		while (true)
+		{
+			// Next meshlet starts at the triangle left next to the previous one with the fewest unused neighbours, that
+			// keeps eating the remaining surface from its border instead of leaving small islands behind
+			uint32_t seed = UINT32_MAX;
+			uint32_t seedScore = UINT32_MAX;
+			for (uint32_t triangle : candidates)
+			{
+				if (emitted[triangle])
+					continue;
+
+				uint32_t score = liveTriangles[indices[triangle * 3 + 0]] + liveTriangles[indices[triangle * 3 + 1]] + liveTriangles[indices[triangle * 3 + 2]];
+				if (score < seedScore)
+				{
+					seed = triangle;
+					seedScore = score;
+				}
+			}
+
+			// Connected part of the mesh is done, continue in index order
+			if (seed == UINT32_MAX)
+			{
+				while (nextUnused < triangleCount && emitted[nextUnused])
+					nextUnused++;
+
+				if (nextUnused == triangleCount)
+					break;
+
+				seed = nextUnused;
+			}
+
+			candidates.clear();
+
+			meshlet = {};
+			meshlet.VertexOffset = (uint32_t)outMeshlets.Vertices.size();
+			meshlet.TriangleOffset = (uint32_t)outMeshlets.Triangles.size();
+			positionSum = glm::vec3(0.0f);
+			addTriangle(seed);
+
+			while (meshlet.TriangleCount < MaxMeshletTriangles)
+			{
+				// Fewest new vertices first so that vertices get reused, closest to the meshlet center after that so
+				// that it stays round and its bounds tight. New vertices that still have many unused triangles around
+				// them push the triangle back, they are better left to the next meshlet
+				glm::vec3 center = positionSum / (float)meshlet.VertexCount;
+
+				uint32_t best = UINT32_MAX;
+				uint32_t bestNewVertices = UINT32_MAX;
+				float bestDistance = std::numeric_limits<float>::max();
+
+				uint32_t kept = 0;
+				for (uint32_t i = 0; i < (uint32_t)candidates.size(); i++)
+				{
+					uint32_t triangle = candidates[i];
+					if (emitted[triangle])
+						continue;
+
+					candidates[kept++] = triangle;
+
+					uint32_t newVertices = getNewVertexCount(triangle);
+					if (meshlet.VertexCount + newVertices > MaxMeshletVertices || newVertices > bestNewVertices)
+						continue;
+
+					glm::vec3 triangleCenter = (vertices[indices[triangle * 3 + 0]].Position + vertices[indices[triangle * 3 + 1]].Position
+						+ vertices[indices[triangle * 3 + 2]].Position) / 3.0f;
+					glm::vec3 offset = triangleCenter - center;
+					float distance = glm::dot(offset, offset);
+
+					uint32_t liveNeighbours = 0;
+					for (uint32_t j = 0; j < 3; j++)
+					{
+						uint32_t vertex = indices[triangle * 3 + j];
+						if (localIndices[vertex] == 0xFF)
+							liveNeighbours += liveTriangles[vertex];
+					}
+					distance *= 1.0f + 0.5f * (float)liveNeighbours;
+
+					if (newVertices < bestNewVertices || distance < bestDistance)
+					{
+						best = triangle;
+						bestNewVertices = newVertices;
+						bestDistance = distance;
+					}
+				}
+				candidates.resize(kept);
+
+				if (best == UINT32_MAX)
+					break;
+
+				addTriangle(best);
+			}
+
+			for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+				localIndices[outMeshlets.Vertices[meshlet.VertexOffset + i]] = 0xFF;
+
+			// Every meshlet starts on a 4 byte boundary so that shaders can read triangles as uints
+			while (outMeshlets.Triangles.size() % 4 != 0)
+				outMeshlets.Triangles.push_back(0);
+
+			ComputeMeshletBounds(vertices, outMeshlets, meshlet);
+			outMeshlets.Meshlets.push_back(meshlet);
+		}
+	}
+
+	Mesh::MeshletBenchmarkResult Mesh::BenchmarkMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t iterations)
+	{
+		MeshletBenchmarkResult result;
+		result.TriangleCount = indices.size() / 3;
+
+		// Best of the iterations, the first one also pays for page faults
+		MeshletData meshlets;
+		float buildTime = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < std::max(iterations, 1u); i++)
+		{
+			Timer timer;
+			BuildMeshlets(vertices, indices, meshlets);
+			buildTime = std::min(buildTime, timer.ElapsedSeconds());
+		}
+
+		result.MeshletCount = meshlets.Meshlets.size();
+		if (result.MeshletCount > 0)
+		{
+			uint64_t cullableCones = 0;
+			for (const Meshlet& meshlet : meshlets.Meshlets)
+			{
+				if (meshlet.ConeCutoff < 1.0f)
+					cullableCones++;
+			}
+
+			result.TriangleFill = (double)result.TriangleCount / (double)(result.MeshletCount * MaxMeshletTriangles);
+			result.VerticesPerTriangle = (double)meshlets.Vertices.size() / (double)result.TriangleCount;
+			result.CullableCones = (double)cullableCones / (double)result.MeshletCount;
+		}
+		result.TrianglesPerSecond = (double)result.TriangleCount / std::max((double)buildTime, 1e-9);
+
+		VK_CORE_INFO("Meshlets: {0} triangles -> {1} meshlets, fill {2:.2f}, {3:.2f} vertices per triangle, {4:.1f}% cullable cones, {5:.2f} M triangles/s",
+			result.TriangleCount, result.MeshletCount, result.TriangleFill, result.VerticesPerTriangle, result.CullableCones * 100.0, result.TrianglesPerSecond / 1000000.0);
+
+		return result;
+	}
+
+	void Mesh::UploadMeshlets(std::span<const Meshlet> meshlets, std::span<const uint32_t> vertices, std::span<const uint8_t> triangles, UploadBatch* batch)
+	{
+		VK_CORE_ASSERT(m_Initialized, "Mesh has to be initialized before uploading meshlets!");
+
+		if (m_MeshletCount > 0)
+		{
+			m_MeshletBuffer.Destroy();
+			m_MeshletVertexBuffer.Destroy();
+			m_MeshletTriangleBuffer.Destroy();
+		}
+
+		m_MeshletCount = (uint32_t)meshlets.size();
+		if (m_MeshletCount == 0)
+			return;
+
+		CreateDeviceBuffer(m_MeshletBuffer, meshlets.data(), meshlets.size_bytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batch);
+		CreateDeviceBuffer(m_MeshletVertexBuffer, vertices.data(), vertices.size_bytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batch);
+		CreateDeviceBuffer(m_MeshletTriangleBuffer, triangles.data(), triangles.size_bytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batch);
+	}
+
+	void Mesh::UploadLods(std::span<const Lod> lods, std::span<const uint32_t> indices, UploadBatch* batch)
+	{
+		VK_CORE_ASSERT(m_Initialized, "Mesh has to be initialized before uploading LODs!");
+		VK_CORE_ASSERT(m_HasIndexBuffer, "LODs can only be uploaded for meshes with an index buffer!");
+
+		if (!m_Lods.empty())
+		{
+			m_LodIndexBuffer.Destroy();
+			m_Lods.clear();
+		}
+
+		for (const Lod& lod : lods)
+		{
+			if (lod.IndexCount == 0 || (uint64_t)lod.IndexOffset + lod.IndexCount > indices.size())
+			{
+				VK_CORE_ERROR("LOD indices {0}-{1} are out of range of {2} indices", lod.IndexOffset, (uint64_t)lod.IndexOffset + lod.IndexCount, indices.size());
+				return;
+			}
+		}
+
+		if (lods.empty())
+			return;
+
+		m_Lods.assign(lods.begin(), lods.end());
+
+		// LODs index the same vertex buffer, so whatever index type the full mesh uses fits them as well
+		const void* indexData = indices.data();
+		std::vector<uint16_t> narrowIndices;
+		if (m_IndexType == VK_INDEX_TYPE_UINT16)
+		{
+			narrowIndices.assign(indices.begin(), indices.end());
+			indexData = narrowIndices.data();
+		}
+
+		CreateDeviceBuffer(m_LodIndexBuffer, indexData, (VkDeviceSize)GetIndexSize() * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, batch);
+	}
+
+	uint32_t Mesh::SelectLod(float pixelsPerUnit, float maxPixelError) const
+	{
+		// Errors only grow with the level, so the first one that's too big ends the search
+		uint32_t lod = 0;
+		while (lod + 1 < GetLodCount() && GetLodError(lod + 1) * pixelsPerUnit <= maxPixelError)
+			lod++;
+
+		return lod;
+	}
+
+	void Mesh::CreateDeviceBuffer(Buffer& buffer, const void* data, VkDeviceSize size, VkBufferUsageFlags usageFlags, UploadBatch* batch)
+	{
 		Buffer::CreateInfo bufferInfo{};
-		bufferInfo.InstanceSize = indexSize;
-		bufferInfo.InstanceCount = m_IndexCount;
+		bufferInfo.InstanceSize = size;
+		bufferInfo.InstanceCount = 1;
+		bufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usageFlags;
+		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		buffer.Init(bufferInfo);
+
+		if (batch != nullptr)
+		{
+			batch->UploadToBuffer(data, size, buffer);
+			return;
+		}
+
 		bufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 		Buffer stagingBuffer;
 		stagingBuffer.Init(bufferInfo);
 
 		stagingBuffer.Map();
-		stagingBuffer.WriteToBuffer((void*)indices->data());
+		stagingBuffer.WriteToBuffer((void*)data);
 		stagingBuffer.Flush();
 
+		Buffer::CopyBuffer(stagingBuffer.GetBuffer(), buffer.GetBuffer(), size, 0, 0, Device::GetGraphicsQueue(), 0, Device::GetGraphicsCommandPool());
+	}
+
+	glm::mat4 Mesh::GetDequantizationTransform() const
+	{
+		glm::mat4 transform(1.0f);
+		if (m_Layout != VertexLayout::Packed)
+			return transform;
+
+		transform[0][0] = m_PositionExtent.x;
+		transform[1][1] = m_PositionExtent.y;
+		transform[2][2] = m_PositionExtent.z;
+		transform[3] = glm::vec4(m_PositionCenter, 1.0f);
+
+		return transform;
+	}
+
+	uint64_t Mesh::GetMemorySize() const
+	{
+		if (!m_Initialized)
+			return 0;
+
+		uint64_t size = m_VertexBuffer.GetBufferSize();
+		if (m_DequantizationBuffer.IsInitialized())
+			size += m_DequantizationBuffer.GetBufferSize();
+		if (m_HasIndexBuffer)
+			size += m_IndexBuffer.GetBufferSize();
+		if (m_MeshletCount > 0)
+			size += m_MeshletBuffer.GetBufferSize() + m_MeshletVertexBuffer.GetBufferSize() + m_MeshletTriangleBuffer.GetBufferSize();
+		if (!m_Lods.empty())
+			size += m_LodIndexBuffer.GetBufferSize();
+
+		return size;
+	}
+
+	void Mesh::CreateIndexBuffer(std::span<const uint32_t> indices, VkBufferUsageFlags customUsageFlags, UploadBatch* batch)
+	{
+		m_IndexCount = (uint64_t)indices.size();
+		m_HasIndexBuffer = m_IndexCount > 0;
+		m_IndexType = VK_INDEX_TYPE_UINT32;
+		if (!m_HasIndexBuffer) { return; }
+
+		// Most meshes have few enough vertices to use 16 bit indices, that halves the index memory. Vertex count is
+		// checked as well so that buffers which are filled in later don't end up too narrow. 0xFFFF is left out since
+		// it restarts primitives when primitive restart is enabled
+		uint32_t maxIndex = *std::max_element(indices.begin(), indices.end());
+		if (m_VertexCount < 0xFFFF && maxIndex < 0xFFFF)
+			m_IndexType = VK_INDEX_TYPE_UINT16;
+
+		const void* indexData = indices.data();
+		std::vector<uint16_t> narrowIndices;
+		if (m_IndexType == VK_INDEX_TYPE_UINT16)
+		{
+			narrowIndices.assign(indices.begin(), indices.end());
+			indexData = narrowIndices.data();
+		}
+
+		uint32_t indexSize = GetIndexSize();
+		VkDeviceSize bufferSize = (VkDeviceSize)indexSize * m_IndexCount;
+
 		VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 		if (Device::UseRayTracing())
 			usageFlags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		
+
+		Buffer::CreateInfo bufferInfo{};
 		bufferInfo.InstanceSize = indexSize;
 		bufferInfo.InstanceCount = m_IndexCount;
 		bufferInfo.UsageFlags = usageFlags | customUsageFlags;
 		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 		m_IndexBuffer.Init(bufferInfo);
 
+		if (batch != nullptr)
+		{
+			batch->UploadToBuffer(indexData, bufferSize, m_IndexBuffer);
+			return;
+		}
+
+		bufferInfo.UsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.MemoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		Buffer stagingBuffer;
+		stagingBuffer.Init(bufferInfo);
+
+		stagingBuffer.Map();
+		stagingBuffer.WriteToBuffer((void*)indexData);
+		stagingBuffer.Flush();
+
 		Buffer::CopyBuffer(stagingBuffer.GetBuffer(), m_IndexBuffer.GetBuffer(), bufferSize, 0, 0, Device::GetGraphicsQueue(), 0, Device::GetGraphicsCommandPool());
 	}
 
 	void Mesh::Reset()
 	{
 		m_VertexCount = 0;
+		m_BoundsCenter = glm::vec3(0.0f);
+		m_BoundsRadius = 0.0f;
+		m_Layout = VertexLayout::Full;
+		m_PositionCenter = glm::vec3(0.0f);
+		m_PositionExtent = glm::vec3(1.0f);
 		m_HasIndexBuffer = false;
 		m_IndexCount = 0;
+		m_IndexType = VK_INDEX_TYPE_UINT32;
+		m_MeshletCount = 0;
+		m_Lods.clear();
 		m_Initialized = false;
 	}
 
@@ -182,9 +871,22 @@ namespace VulkanHelper
 
 		m_VertexBuffer = std::move(other.m_VertexBuffer);
 		m_VertexCount = std::move(other.m_VertexCount);
+		m_BoundsCenter = std::move(other.m_BoundsCenter);
+		m_BoundsRadius = std::move(other.m_BoundsRadius);
+		m_Layout = std::move(other.m_Layout);
+		m_PositionCenter = std::move(other.m_PositionCenter);
+		m_PositionExtent = std::move(other.m_PositionExtent);
+		m_DequantizationBuffer = std::move(other.m_DequantizationBuffer);
 		m_HasIndexBuffer = std::move(other.m_HasIndexBuffer);
 		m_IndexBuffer = std::move(other.m_IndexBuffer);
 		m_IndexCount = std::move(other.m_IndexCount);
+		m_IndexType = std::move(other.m_IndexType);
+		m_MeshletBuffer = std::move(other.m_MeshletBuffer);
+		m_MeshletVertexBuffer = std::move(other.m_MeshletVertexBuffer);
+		m_MeshletTriangleBuffer = std::move(other.m_MeshletTriangleBuffer);
+		m_MeshletCount = std::move(other.m_MeshletCount);
+		m_LodIndexBuffer = std::move(other.m_LodIndexBuffer);
+		m_Lods = std::move(other.m_Lods);
 		m_Initialized = std::move(other.m_Initialized);
 
 		other.Reset();
@@ -207,9 +909,22 @@ namespace VulkanHelper
 
 		m_VertexBuffer = std::move(other.m_VertexBuffer);
 		m_VertexCount = std::move(other.m_VertexCount);
+		m_BoundsCenter = std::move(other.m_BoundsCenter);
+		m_BoundsRadius = std::move(other.m_BoundsRadius);
+		m_Layout = std::move(other.m_Layout);
+		m_PositionCenter = std::move(other.m_PositionCenter);
+		m_PositionExtent = std::move(other.m_PositionExtent);
+		m_DequantizationBuffer = std::move(other.m_DequantizationBuffer);
 		m_HasIndexBuffer = std::move(other.m_HasIndexBuffer);
 		m_IndexBuffer = std::move(other.m_IndexBuffer);
 		m_IndexCount = std::move(other.m_IndexCount);
+		m_IndexType = std::move(other.m_IndexType);
+		m_MeshletBuffer = std::move(other.m_MeshletBuffer);
+		m_MeshletVertexBuffer = std::move(other.m_MeshletVertexBuffer);
+		m_MeshletTriangleBuffer = std::move(other.m_MeshletTriangleBuffer);
+		m_MeshletCount = std::move(other.m_MeshletCount);
+		m_LodIndexBuffer = std::move(other.m_LodIndexBuffer);
+		m_Lods = std::move(other.m_Lods);
 		m_Initialized = std::move(other.m_Initialized);
 
 		other.Reset();
@@ -218,9 +933,9 @@ namespace VulkanHelper
 	}
 
 	/**
-		@brief Binds vertex and index buffers
+		@brief Binds vertex and index buffers, LODs other than 0 bind the LOD index buffer instead
 	*/
-	void Mesh::Bind(VkCommandBuffer commandBuffer)
+	void Mesh::Bind(VkCommandBuffer commandBuffer, uint32_t lod)
 	{
 		VkBuffer buffers[] = { m_VertexBuffer.GetBuffer() };
 		VkDeviceSize offsets[] = { 0 };
@@ -228,13 +943,20 @@ namespace VulkanHelper
 
 		if (m_HasIndexBuffer) 
 		{ 
-			vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			lod = std::min(lod, GetLodCount() - 1);
+			vkCmdBindIndexBuffer(commandBuffer, lod == 0 ? m_IndexBuffer.GetBuffer() : m_LodIndexBuffer.GetBuffer(), 0, m_IndexType);
 		}
 	}
 
-	void Mesh::Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
+	void Mesh::Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod)
 	{
-		if (m_HasIndexBuffer)
+		lod = std::min(lod, GetLodCount() - 1);
+		if (m_HasIndexBuffer && lod > 0)
+		{
+			const Lod& level = m_Lods[lod - 1];
+			vkCmdDrawIndexed(commandBuffer, level.IndexCount, instanceCount, level.IndexOffset, 0, firstInstance);
+		}
+		else if (m_HasIndexBuffer)
 		{ 
 			vkCmdDrawIndexed(commandBuffer, (uint32_t)m_IndexCount, instanceCount, 0, 0, firstInstance); 
 		}
@@ -271,13 +993,55 @@ namespace VulkanHelper
 		return attributeDescriptions;
 	}
 
+	std::vector<VkVertexInputBindingDescription> Mesh::PackedVertex::GetBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescription(1);
+		bindingDescription[0].binding = 0;
+		bindingDescription[0].stride = sizeof(PackedVertex);
+		bindingDescription[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	/**
+	 * @brief Same locations as Vertex, but position comes in as vec4 and normal as octahedral encoded vec2
+	*/
+	std::vector<VkVertexInputAttributeDescription> Mesh::PackedVertex::GetAttributeDescriptions()
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		attributeDescriptions.reserve(3);
+		attributeDescriptions.emplace_back(VkVertexInputAttributeDescription{ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(PackedVertex, Position) });
+		attributeDescriptions.emplace_back(VkVertexInputAttributeDescription{ 1, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, Normal) });
+		attributeDescriptions.emplace_back(VkVertexInputAttributeDescription{ 2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, TexCoord) });
+
+		return attributeDescriptions;
+	}
+
 	void Mesh::UpdateVertexBuffer(const std::vector<Vertex>& vertices, int offset, VkCommandBuffer cmd)
 	{
+		if (m_Layout == VertexLayout::Packed)
+		{
+			// Vertices outside of the original bounds get clamped to them
+			std::vector<PackedVertex> packedVertices(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				packedVertices[i] = PackVertex(vertices[i], m_PositionCenter, m_PositionExtent);
+
+			vkCmdUpdateBuffer(cmd, m_VertexBuffer.GetBuffer(), offset, sizeof(packedVertices[0]) * packedVertices.size(), packedVertices.data());
+			return;
+		}
+
 		vkCmdUpdateBuffer(cmd, m_VertexBuffer.GetBuffer(), offset, sizeof(vertices[0]) * vertices.size(), vertices.data());
 	}
 
 	void Mesh::UpdateIndexBuffer(const std::vector<uint32_t>& indices, int offset, VkCommandBuffer cmd /*= 0*/)
 	{
+		if (m_IndexType == VK_INDEX_TYPE_UINT16)
+		{
+			std::vector<uint16_t> narrowIndices(indices.begin(), indices.end());
+			vkCmdUpdateBuffer(cmd, m_IndexBuffer.GetBuffer(), offset, sizeof(narrowIndices[0]) * narrowIndices.size(), narrowIndices.data());
+			return;
+		}
+
 		vkCmdUpdateBuffer(cmd, m_IndexBuffer.GetBuffer(), offset, sizeof(indices[0]) * indices.size(), indices.data());
 	}
 
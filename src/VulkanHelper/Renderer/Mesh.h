@@ -1,6 +1,8 @@
 #pragma once
 #include "pch.h"
+#include <span>
 #include "Vulkan/Buffer.h"
+#include "Vulkan/UploadBatch.h"
 #include "../Utility/Utility.h"
 #include "glm/glm.hpp"
 
@@ -23,16 +25,117 @@ namespace VulkanHelper
 			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
 		};
 
+		/**
+		 * @brief Compact vertex, half the size of Vertex. Position is stored as 16 bit snorm relative to the bounding
+		 * box of the mesh, the normal is octahedral encoded into 16 bit snorm and texture coordinates are half floats.
+		 * The position attribute stays in the [-1, 1] range, GetDequantizationTransform() maps it back to the space
+		 * of the mesh. Shaders/PackedVertex.glsl has the matching decode functions.
+		 */
+		struct PackedVertex
+		{
+			int16_t Position[4]; // w is unused, 3 component 16 bit formats aren't widely supported
+			int16_t Normal[2];
+			uint16_t TexCoord[2];
+
+			static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
+		};
+
+		enum class VertexLayout
+		{
+			Full,	// Vertex
+			Packed	// PackedVertex
+		};
+
+		// Largest error that packing may introduce for a mesh to still be packed, see ChooseVertexLayout()
+		struct PackingTolerance
+		{
+			// In the units of the mesh, every axis separately
+			float Position = 0.0005f;
+			// Distance between the original and the decoded unit normal
+			float Normal = 0.001f;
+			// Half a texel of a 1024 texture, half floats go over it for UVs outside of [-4, 4]
+			float TexCoord = 1.0f / 2048.0f;
+		};
+
+		/**
+		 * @brief Cluster of at most MaxMeshletVertices vertices and MaxMeshletTriangles triangles, with bounds for
+		 * culling it as a whole. Laid out so that an array of them can be read straight from a storage buffer.
+		 */
+		struct Meshlet
+		{
+			// Bounding sphere
+			glm::vec3 Center;
+			float Radius;
+
+			// Every triangle faces away from the camera if dot(normalize(ConeApex - cameraPosition), ConeAxis) >= ConeCutoff,
+			// cutoff is 1 when normals are spread too much for that to ever be true
+			glm::vec3 ConeApex;
+			float ConeCutoff;
+			glm::vec3 ConeAxis;
+
+			// Offset into MeshletData::Vertices
+			uint32_t VertexOffset;
+			// Offset into MeshletData::Triangles, aligned to 4 bytes
+			uint32_t TriangleOffset;
+			uint32_t VertexCount;
+			uint32_t TriangleCount;
+			uint32_t Padding;
+		};
+
+		struct MeshletData
+		{
+			std::vector<Meshlet> Meshlets;
+			// Indices into the vertex buffer
+			std::vector<uint32_t> Vertices;
+			// 3 per triangle, indices into the vertices of the meshlet
+			std::vector<uint8_t> Triangles;
+		};
+
+		// Limits commonly recommended for mesh shaders, 124 keeps the triangle count a multiple of 4
+		static constexpr uint32_t MaxMeshletVertices = 64;
+		static constexpr uint32_t MaxMeshletTriangles = 124;
+
+		struct MeshletBenchmarkResult
+		{
+			uint64_t TriangleCount = 0;
+			uint64_t MeshletCount = 0;
+			// How full meshlets are on average, 1 is MaxMeshletTriangles in every one
+			double TriangleFill = 0.0;
+			// Vertices transformed per triangle, every vertex is transformed once in each meshlet that uses it
+			double VerticesPerTriangle = 0.0;
+			// Meshlets whose normal cone can cull them, the rest is only culled by their bounding sphere
+			double CullableCones = 0.0;
+			double TrianglesPerSecond = 0.0;
+		};
+
+		// Simplified version of the mesh, drawn with the same vertices as the full one
+		struct Lod
+		{
+			// In indices of the LOD index buffer
+			uint32_t IndexOffset;
+			uint32_t IndexCount;
+			// How far the surface may be from the full mesh, in the units of the mesh
+			float Error;
+		};
+
 		struct CreateInfo
 		{
 			const std::vector<Vertex>* Vertices = nullptr;
 			const std::vector<uint32_t>* Indices = nullptr;
 
+			// Vertices are converted to the layout on upload
+			VertexLayout Layout = VertexLayout::Full;
+
 			VkBufferUsageFlags VertexUsageFlags = 0;
 			VkBufferUsageFlags IndexUsageFlags = 0;
+
+			// If set, uploads are only recorded into the batch and the buffers are filled once it's submitted
+			UploadBatch* Batch = nullptr;
 		};
 
 		void Init(const CreateInfo& createInfo);
+		void Init(std::span<const Vertex> vertices, std::span<const uint32_t> indices, VkBufferUsageFlags vertexUsageFlags = 0, VkBufferUsageFlags indexUsageFlags = 0, UploadBatch* batch = nullptr, VertexLayout layout = VertexLayout::Full);
 		void Init(aiMesh* mesh, const aiScene* scene, const glm::mat4& mat = glm::mat4(1.0f), VkBufferUsageFlags customUsageFlags = 0);
 		void Destroy();
 
@@ -46,10 +149,39 @@ namespace VulkanHelper
 		Mesh(Mesh&& other) noexcept;
 		Mesh& operator=(Mesh&& other) noexcept;
 
-		void Bind(VkCommandBuffer commandBuffer);
-		void Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance = 0);
+		// LOD 0 is the full mesh, levels past the last one draw the last one
+		void Bind(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+		void Draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance = 0, uint32_t lod = 0);
+
+		static void ConvertAssimpMesh(aiMesh* mesh, const glm::mat4& mat, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices);
+
+		// Greedily grows meshlets over connected triangles, preferring the ones that add the fewest new vertices
+		static void BuildMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices, MeshletData& outMeshlets);
+		// Builds meshlets a few times and logs their quality along with the build speed
+		static MeshletBenchmarkResult BenchmarkMeshlets(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t iterations = 5);
+
+		// Creates storage buffers with the meshlets next to the vertex and index buffers, for cluster culling and
+		// mesh shaders. Has to be called after Init
+		void UploadMeshlets(std::span<const Meshlet> meshlets, std::span<const uint32_t> vertices, std::span<const uint8_t> triangles, UploadBatch* batch = nullptr);
+
+		// Creates one index buffer with the indices of every LOD, narrowed the same way as the full mesh. LODs are
+		// numbered from 1 since 0 is the full mesh. Has to be called after Init
+		void UploadLods(std::span<const Lod> lods, std::span<const uint32_t> indices, UploadBatch* batch = nullptr);
+
+		// Lowest detail LOD whose error takes up at most maxPixelError pixels on the screen, pixelsPerUnit is how
+		// many pixels one unit of the mesh covers at its distance
+		uint32_t SelectLod(float pixelsPerUnit, float maxPixelError = 1.0f) const;
+
+		// Packed when every vertex decodes back within the tolerance, Full otherwise
+		static VertexLayout ChooseVertexLayout(std::span<const Vertex> vertices, const PackingTolerance& tolerance = {});
+		// Center and extent are the center and the half size of the bounding box that positions are stored relative to
+		static void GetPackingBounds(std::span<const Vertex> vertices, glm::vec3& outCenter, glm::vec3& outExtent);
+		static PackedVertex PackVertex(const Vertex& vertex, const glm::vec3& center, const glm::vec3& extent);
+		static Vertex UnpackVertex(const PackedVertex& vertex, const glm::vec3& center, const glm::vec3& extent);
 
+		// Vertices are packed with the bounds of the mesh when it uses the packed layout, offset is in bytes of that layout
 		void UpdateVertexBuffer(const std::vector<Vertex>& vertices, int offset, VkCommandBuffer cmd = 0);
+		// Indices are narrowed when the mesh uses 16 bit ones, offset is in bytes of the index type
 		void UpdateIndexBuffer(const std::vector<uint32_t>& indices, int offset, VkCommandBuffer cmd = 0);
 
 		inline const Buffer* GetVertexBuffer() const { return &m_VertexBuffer; }
@@ -63,21 +195,76 @@ namespace VulkanHelper
 
 		inline bool& HasIndexBuffer() { return m_HasIndexBuffer; }
 
+		// Empty unless UploadMeshlets was called
+		inline const Buffer* GetMeshletBuffer() const { return &m_MeshletBuffer; }
+		inline const Buffer* GetMeshletVertexBuffer() const { return &m_MeshletVertexBuffer; }
+		inline const Buffer* GetMeshletTriangleBuffer() const { return &m_MeshletTriangleBuffer; }
+		inline uint32_t GetMeshletCount() const { return m_MeshletCount; }
+		inline bool HasMeshlets() const { return m_MeshletCount > 0; }
+
+		// Only the full mesh unless UploadLods was called
+		inline uint32_t GetLodCount() const { return 1 + (uint32_t)m_Lods.size(); }
+		inline float GetLodError(uint32_t lod) const { return lod == 0 ? 0.0f : m_Lods[lod - 1].Error; }
+		inline uint32_t GetLodIndexCount(uint32_t lod) const { return lod == 0 ? (uint32_t)m_IndexCount : m_Lods[lod - 1].IndexCount; }
+		inline const Buffer* GetLodIndexBuffer() const { return &m_LodIndexBuffer; }
+
+		// Bounding sphere of the vertices, in the space of the mesh
+		inline glm::vec3 GetBoundsCenter() const { return m_BoundsCenter; }
+		inline float GetBoundsRadius() const { return m_BoundsRadius; }
+
+		// 16 bit when every index fits into it, 32 bit otherwise
+		inline VkIndexType GetIndexType() const { return m_IndexType; }
+		inline uint32_t GetIndexSize() const { return m_IndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+		inline VertexLayout GetVertexLayout() const { return m_Layout; }
+		inline uint32_t GetVertexSize() const { return m_Layout == VertexLayout::Packed ? sizeof(PackedVertex) : sizeof(Vertex); }
+
+		// Scale and offset that turn packed positions back into the space of the mesh, meant to be multiplied into
+		// the model matrix. Normals aren't affected by it. Identity for the full layout
+		glm::mat4 GetDequantizationTransform() const;
+		inline glm::vec3 GetPositionCenter() const { return m_PositionCenter; }
+		inline glm::vec3 GetPositionExtent() const { return m_PositionExtent; }
+
+		// VkTransformMatrixKHR with the dequantization transform, used as transformData when building acceleration
+		// structures from packed meshes. Only created for packed meshes when ray tracing is enabled
+		inline const Buffer* GetDequantizationBuffer() const { return &m_DequantizationBuffer; }
+
+		// Size of every GPU buffer owned by the mesh, including meshlets, LODs and the dequantization buffer
+		uint64_t GetMemorySize() const;
+
 		inline bool IsInitialized() const { return m_Initialized; }
 	private:
 		
 		void CreateMesh(const CreateInfo& createInfo);
 		void CreateMesh(aiMesh* mesh, const aiScene* scene, glm::mat4 mat = glm::mat4(1.0f), VkBufferUsageFlags customUsageFlags = 0);
 
-		void CreateVertexBuffer(const std::vector<Vertex>* const vertices, VkBufferUsageFlags customUsageFlags = 0);
-		void CreateIndexBuffer(const std::vector<uint32_t>* const indices, VkBufferUsageFlags customUsageFlags = 0);
+		void CreateVertexBuffer(std::span<const Vertex> vertices, VkBufferUsageFlags customUsageFlags = 0, UploadBatch* batch = nullptr, VertexLayout layout = VertexLayout::Full);
+		void CreateDequantizationBuffer();
+		static void CreateDeviceBuffer(Buffer& buffer, const void* data, VkDeviceSize size, VkBufferUsageFlags usageFlags, UploadBatch* batch);
+		void CreateIndexBuffer(std::span<const uint32_t> indices, VkBufferUsageFlags customUsageFlags = 0, UploadBatch* batch = nullptr);
 		
 		Buffer m_VertexBuffer;
 		uint64_t m_VertexCount = 0;
+		glm::vec3 m_BoundsCenter = glm::vec3(0.0f);
+		float m_BoundsRadius = 0.0f;
+
+		VertexLayout m_Layout = VertexLayout::Full;
+		glm::vec3 m_PositionCenter = glm::vec3(0.0f);
+		glm::vec3 m_PositionExtent = glm::vec3(1.0f);
+		Buffer m_DequantizationBuffer;
 
 		bool m_HasIndexBuffer = false;
 		Buffer m_IndexBuffer;
 		uint64_t m_IndexCount = 0;
+		VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
+
+		Buffer m_MeshletBuffer;
+		Buffer m_MeshletVertexBuffer;
+		Buffer m_MeshletTriangleBuffer;
+		uint32_t m_MeshletCount = 0;
+
+		Buffer m_LodIndexBuffer;
+		std::vector<Lod> m_Lods;
 
 		bool m_Initialized = false;
 
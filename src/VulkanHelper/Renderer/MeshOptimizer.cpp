@@ -0,0 +1,892 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		constexpr uint32_t InvalidVertex = UINT32_MAX;
+
+		bool ValidateIndices(std::span<const uint32_t> indices, uint32_t vertexCount)
+		{
+			for (uint32_t index : indices)
+			{
+				if (index >= vertexCount)
+				{
+					VK_CORE_ERROR("Can't optimize mesh, index {0} is out of range", index);
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		/**
+		 * @brief FIFO cache simulated with time stamps, a vertex is cached if fewer than cacheSize vertices were
+		 * inserted after it. Clearing only moves the time forward.
+		 */
+		class VertexCache
+		{
+		public:
+			VertexCache(uint32_t vertexCount, uint32_t cacheSize)
+				: m_InsertTimes(vertexCount, 0), m_Time(cacheSize + 1), m_CacheSize(cacheSize) {}
+
+			// Returns true if the vertex had to be transformed
+			bool Access(uint32_t vertex)
+			{
+				if (m_Time - m_InsertTimes[vertex] <= m_CacheSize)
+					return false;
+
+				m_InsertTimes[vertex] = m_Time++;
+				return true;
+			}
+
+			uint32_t AccessTriangle(const uint32_t* triangle)
+			{
+				return (uint32_t)Access(triangle[0]) + (uint32_t)Access(triangle[1]) + (uint32_t)Access(triangle[2]);
+			}
+
+			// Vertices stay cached for cacheSize more insertions, Tipsify uses that to rate them
+			inline uint32_t GetAge(uint32_t vertex) const { return m_Time - m_InsertTimes[vertex]; }
+			inline void Clear() { m_Time += m_CacheSize + 1; }
+
+		private:
+			std::vector<uint32_t> m_InsertTimes;
+			uint32_t m_Time;
+			uint32_t m_CacheSize;
+		};
+
+		/**
+		 * @brief Sum of squared distances to a set of weighted planes, in doubles since the terms of big meshes cancel
+		 * out badly in floats. Divided by the total weight it's the mean squared distance to the planes.
+		 */
+		struct Quadric
+		{
+			double XX = 0.0, XY = 0.0, XZ = 0.0, YY = 0.0, YZ = 0.0, ZZ = 0.0;
+			double X = 0.0, Y = 0.0, Z = 0.0;
+			double C = 0.0;
+			double Weight = 0.0;
+
+			void AddPlane(const glm::vec3& normal, float distance, double weight)
+			{
+				double a = normal.x, b = normal.y, c = normal.z, d = distance;
+
+				XX += weight * a * a; XY += weight * a * b; XZ += weight * a * c;
+				YY += weight * b * b; YZ += weight * b * c; ZZ += weight * c * c;
+				X += weight * a * d; Y += weight * b * d; Z += weight * c * d;
+				C += weight * d * d;
+				Weight += weight;
+			}
+
+			void Add(const Quadric& other)
+			{
+				XX += other.XX; XY += other.XY; XZ += other.XZ;
+				YY += other.YY; YZ += other.YZ; ZZ += other.ZZ;
+				X += other.X; Y += other.Y; Z += other.Z;
+				C += other.C;
+				Weight += other.Weight;
+			}
+
+			double GetError(const glm::vec3& position) const
+			{
+				double x = position.x, y = position.y, z = position.z;
+
+				double error = x * x * XX + y * y * YY + z * z * ZZ + 2.0 * (x * y * XY + x * z * XZ + y * z * YZ)
+					+ 2.0 * (x * X + y * Y + z * Z) + C;
+
+				return Weight > 0.0 ? std::abs(error) / Weight : 0.0;
+			}
+		};
+
+		// What a vertex may collapse into, decided once from the input mesh
+		enum class VertexKind : uint8_t
+		{
+			Manifold,	// Inside of a surface with one set of attributes, collapses into any neighbour
+			Border,		// On an open edge of the surface, collapses only along it
+			Seam,		// One of two vertices on an attribute seam, both collapse along the seam together
+			Locked		// Corners and everything else that can't move without tearing the mesh
+		};
+
+		// Open edges and attribute seams are weighted more than triangles so that their shape is kept longer
+		constexpr double BoundaryWeight = 10.0;
+
+		/**
+		 * @brief Triangles around every welded position. Edges are looked up by scanning the few triangles around
+		 * their start, which is a lot cheaper than sorting all of them.
+		 */
+		class PositionAdjacency
+		{
+		public:
+			void Build(std::span<const uint32_t> indices, const std::vector<uint32_t>& positionIds)
+			{
+				m_Indices = indices;
+				m_PositionIds = &positionIds;
+
+				m_Offsets.assign(positionIds.size() + 1, 0);
+				for (uint32_t index : indices)
+					m_Offsets[positionIds[index] + 1]++;
+				for (size_t i = 0; i < positionIds.size(); i++)
+					m_Offsets[i + 1] += m_Offsets[i];
+
+				m_Triangles.resize(indices.size());
+				m_Fill.assign(m_Offsets.begin(), m_Offsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); i++)
+					m_Triangles[m_Fill[positionIds[indices[i]]]++] = (uint32_t)(i / 3);
+			}
+
+			inline std::span<const uint32_t> GetTriangles(uint32_t position) const { return { m_Triangles.data() + m_Offsets[position], m_Offsets[position + 1] - m_Offsets[position] }; }
+			inline const uint32_t* GetTriangle(uint32_t triangle) const { return &m_Indices[(size_t)triangle * 3]; }
+
+			// Whether a triangle goes from vertex a to vertex b
+			bool HasEdge(uint32_t a, uint32_t b) const
+			{
+				for (uint32_t triangle : GetTriangles((*m_PositionIds)[a]))
+				{
+					const uint32_t* corners = GetTriangle(triangle);
+					for (uint32_t j = 0; j < 3; j++)
+					{
+						if (corners[j] == a && corners[(j + 1) % 3] == b)
+							return true;
+					}
+				}
+
+				return false;
+			}
+
+			// Same with positions, whatever vertices are at them
+			bool HasPositionEdge(uint32_t a, uint32_t b) const
+			{
+				const std::vector<uint32_t>& positionIds = *m_PositionIds;
+				for (uint32_t triangle : GetTriangles(a))
+				{
+					const uint32_t* corners = GetTriangle(triangle);
+					for (uint32_t j = 0; j < 3; j++)
+					{
+						if (positionIds[corners[j]] == a && positionIds[corners[(j + 1) % 3]] == b)
+							return true;
+					}
+				}
+
+				return false;
+			}
+
+			// Open edges have no triangle going the other way
+			inline bool IsOpen(uint32_t a, uint32_t b) const { return HasEdge(a, b) && !HasEdge(b, a); }
+			inline bool IsPositionOpen(uint32_t a, uint32_t b) const { return HasPositionEdge(a, b) && !HasPositionEdge(b, a); }
+
+		private:
+			std::span<const uint32_t> m_Indices;
+			const std::vector<uint32_t>* m_PositionIds = nullptr;
+
+			std::vector<uint32_t> m_Offsets;
+			std::vector<uint32_t> m_Fill;
+			std::vector<uint32_t> m_Triangles;
+		};
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+		if (triangleCount == 0 || !ValidateIndices(indices, vertexCount))
+			return;
+
+		// Triangles that use each vertex, stored as offsets into one array. Live counts are the triangles of each
+		// vertex that weren't emitted yet
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacencyOffsets[indices[i] + 1]++;
+
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			liveTriangles[i] = adjacencyOffsets[i + 1];
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			adjacency[adjacencyFill[indices[i]]++] = i / 3;
+
+		VertexCache cache(vertexCount, cacheSize);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+
+		uint32_t cursor = 0;
+		uint32_t fanning = 0;
+		while (fanning != InvalidVertex)
+		{
+			// Emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; i++)
+			{
+				uint32_t triangle = adjacency[i];
+				if (emitted[triangle])
+					continue;
+
+				for (uint32_t j = 0; j < 3; j++)
+				{
+					uint32_t vertex = indices[triangle * 3 + j];
+					output.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+					cache.Access(vertex);
+				}
+
+				emitted[triangle] = 1;
+			}
+
+			// Next one is the candidate that has been in the cache the longest but will still be there once all of
+			// its triangles are emitted, candidates that would fall out of it are only taken if there's nothing else
+			fanning = InvalidVertex;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0)
+					continue;
+
+				int64_t priority = 0;
+				if ((uint64_t)cache.GetAge(vertex) + 2 * (uint64_t)liveTriangles[vertex] <= cacheSize)
+					priority = cache.GetAge(vertex);
+
+				if (priority > bestPriority)
+				{
+					fanning = vertex;
+					bestPriority = priority;
+				}
+			}
+
+			// Dead end, go back to the most recently used vertex that still has triangles, or the next one in order
+			while (fanning == InvalidVertex && !deadEnds.empty())
+			{
+				uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+					fanning = vertex;
+			}
+
+			while (fanning == InvalidVertex && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+					fanning = cursor;
+				cursor++;
+			}
+		}
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Mesh::Vertex> vertices, float threshold, uint32_t cacheSize)
+	{
+		const uint32_t vertexCount = (uint32_t)vertices.size();
+		const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+		if (triangleCount == 0 || !ValidateIndices(indices, vertexCount))
+			return;
+
+		VertexCache cache(vertexCount, cacheSize);
+
+		// Hard boundaries are where every vertex of a triangle misses the cache, the cache order jumped elsewhere there
+		std::vector<uint32_t> hardBoundaries;
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			if (cache.AccessTriangle(&indices[i * 3]) == 3)
+				hardBoundaries.push_back(i);
+		}
+		hardBoundaries.push_back(triangleCount);
+
+		// Hard clusters are split further wherever the part before the split already reuses vertices about as well
+		// as the whole cluster does, so drawing the parts in a different order costs little cache efficiency
+		std::vector<uint32_t> clusters;
+		for (size_t i = 0; i + 1 < hardBoundaries.size(); i++)
+		{
+			uint32_t start = hardBoundaries[i];
+			uint32_t end = hardBoundaries[i + 1];
+
+			cache.Clear();
+			uint32_t clusterMisses = 0;
+			for (uint32_t j = start; j < end; j++)
+				clusterMisses += cache.AccessTriangle(&indices[j * 3]);
+
+			const double maxACMR = threshold * (double)clusterMisses / (double)(end - start);
+
+			cache.Clear();
+			clusters.push_back(start);
+			uint32_t misses = 0;
+			uint32_t count = 0;
+			for (uint32_t j = start; j < end; j++)
+			{
+				misses += cache.AccessTriangle(&indices[j * 3]);
+				count++;
+
+				if (j + 1 < end && (double)misses / (double)count <= maxACMR)
+				{
+					clusters.push_back(j + 1);
+					cache.Clear();
+					misses = 0;
+					count = 0;
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		// Clusters that face away from the center of the mesh are drawn first, they are likely to occlude the rest
+		const uint32_t clusterCount = (uint32_t)clusters.size() - 1;
+		std::vector<glm::vec3> clusterCenters(clusterCount, glm::vec3(0.0f));
+		std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+		std::vector<float> clusterAreas(clusterCount, 0.0f);
+		glm::vec3 meshCenter(0.0f);
+		float meshArea = 0.0f;
+		for (uint32_t i = 0; i < clusterCount; i++)
+		{
+			for (uint32_t j = clusters[i]; j < clusters[i + 1]; j++)
+			{
+				glm::vec3 a = vertices[indices[j * 3 + 0]].Position;
+				glm::vec3 b = vertices[indices[j * 3 + 1]].Position;
+				glm::vec3 c = vertices[indices[j * 3 + 2]].Position;
+
+				// Cross product is twice the area in the direction of the normal, so the sums are area weighted
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float area = glm::length(normal);
+
+				clusterCenters[i] += (a + b + c) * (area / 3.0f);
+				clusterNormals[i] += normal;
+				clusterAreas[i] += area;
+			}
+
+			meshCenter += clusterCenters[i];
+			meshArea += clusterAreas[i];
+		}
+
+		if (meshArea > 0.0f)
+			meshCenter /= meshArea;
+
+		std::vector<float> sortKeys(clusterCount, 0.0f);
+		for (uint32_t i = 0; i < clusterCount; i++)
+		{
+			float normalLength = glm::length(clusterNormals[i]);
+			if (clusterAreas[i] <= 0.0f || normalLength <= 0.0f)
+				continue;
+
+			glm::vec3 center = clusterCenters[i] / clusterAreas[i];
+			sortKeys[i] = glm::dot(center - meshCenter, clusterNormals[i] / normalLength);
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		for (uint32_t cluster : order)
+			output.insert(output.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	void MeshOptimizer::OptimizeVertexFetch(std::vector<Mesh::Vertex>& vertices, std::span<uint32_t> indices)
+	{
+		if (!ValidateIndices(indices, (uint32_t)vertices.size()))
+			return;
+
+		std::vector<uint32_t> remap(vertices.size(), InvalidVertex);
+		std::vector<Mesh::Vertex> reordered;
+		reordered.reserve(vertices.size());
+
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == InvalidVertex)
+			{
+				remap[index] = (uint32_t)reordered.size();
+				reordered.push_back(vertices[index]);
+			}
+
+			index = remap[index];
+		}
+
+		vertices = std::move(reordered);
+	}
+
+	void MeshOptimizer::Optimize(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		// Non indexed meshes have no vertex reuse to improve
+		if (indices.empty() || !ValidateIndices(indices, (uint32_t)vertices.size()))
+			return;
+
+		OptimizeVertexCache(indices, (uint32_t)vertices.size());
+		OptimizeOverdraw(indices, vertices);
+		OptimizeVertexFetch(vertices, indices);
+	}
+
+	float MeshOptimizer::Simplify(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices, uint32_t targetIndexCount, float maxError,
+		std::vector<uint32_t>& outIndices)
+	{
+		outIndices.assign(indices.begin(), indices.end());
+
+		const uint32_t vertexCount = (uint32_t)vertices.size();
+		if (indices.size() <= targetIndexCount || !ValidateIndices(indices, vertexCount))
+			return 0.0f;
+
+		// Vertices at the same position are welded, every position is represented by the lowest index that's at it.
+		// Wedges link all vertices of a position into a cycle
+		std::vector<uint32_t> sorted(vertexCount);
+		std::iota(sorted.begin(), sorted.end(), 0);
+		std::sort(sorted.begin(), sorted.end(), [&vertices](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& positionA = vertices[a].Position;
+			const glm::vec3& positionB = vertices[b].Position;
+			if (positionA.x != positionB.x) return positionA.x < positionB.x;
+			if (positionA.y != positionB.y) return positionA.y < positionB.y;
+			if (positionA.z != positionB.z) return positionA.z < positionB.z;
+			return a < b;
+		});
+
+		std::vector<uint32_t> positionIds(vertexCount);
+		std::vector<uint32_t> wedges(vertexCount);
+		for (uint32_t i = 0; i < vertexCount;)
+		{
+			uint32_t end = i + 1;
+			while (end < vertexCount && vertices[sorted[end]].Position == vertices[sorted[i]].Position)
+				end++;
+
+			for (uint32_t j = i; j < end; j++)
+			{
+				positionIds[sorted[j]] = sorted[i];
+				wedges[sorted[j]] = sorted[j + 1 < end ? j + 1 : i];
+			}
+
+			i = end;
+		}
+
+		// Triangles that are already degenerate would only get in the way of the topology checks
+		size_t kept = 0;
+		for (size_t i = 0; i < outIndices.size(); i += 3)
+		{
+			uint32_t a = positionIds[outIndices[i + 0]];
+			uint32_t b = positionIds[outIndices[i + 1]];
+			uint32_t c = positionIds[outIndices[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			for (uint32_t j = 0; j < 3; j++)
+				outIndices[kept++] = outIndices[i + j];
+		}
+		outIndices.resize(kept);
+
+		PositionAdjacency adjacency;
+		adjacency.Build(outIndices, positionIds);
+
+		// Edges that are open only because of different attributes on both sides are seams, the ones that are open
+		// even with positions welded are borders
+		std::vector<uint8_t> openEdges(outIndices.size(), 0);
+		std::vector<uint32_t> openOut(vertexCount, InvalidVertex);
+		std::vector<uint32_t> openIn(vertexCount, InvalidVertex);
+		std::vector<uint32_t> openCounts(vertexCount, 0);
+		for (size_t i = 0; i < outIndices.size(); i++)
+		{
+			uint32_t a = outIndices[i];
+			uint32_t b = outIndices[i - i % 3 + (i + 1) % 3];
+			if (adjacency.HasEdge(b, a))
+				continue;
+
+			openEdges[i] = 1;
+			openOut[a] = b;
+			openIn[b] = a;
+			openCounts[a]++;
+			openCounts[b]++;
+		}
+
+		std::vector<VertexKind> kinds(vertexCount, VertexKind::Locked);
+		std::vector<uint8_t> onSeam(vertexCount, 0);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			bool single = wedges[i] == i;
+			if (openCounts[i] == 0)
+			{
+				if (single)
+					kinds[i] = VertexKind::Manifold;
+				continue;
+			}
+
+			// Anything but one open edge in and one out means the surface branches or ends at the vertex
+			if (openCounts[i] != 2 || openOut[i] == InvalidVertex || openIn[i] == InvalidVertex)
+				continue;
+
+			bool borderOut = adjacency.IsPositionOpen(positionIds[i], positionIds[openOut[i]]);
+			bool borderIn = adjacency.IsPositionOpen(positionIds[openIn[i]], positionIds[i]);
+			if (single && borderOut && borderIn)
+				kinds[i] = VertexKind::Border;
+			else if (!single && wedges[wedges[i]] == i && !borderOut && !borderIn)
+				onSeam[i] = 1;
+		}
+
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			if (onSeam[i] && onSeam[wedges[i]])
+				kinds[i] = VertexKind::Seam;
+		}
+
+		// Every position gets the planes of its triangles, weighted by area, and planes perpendicular to its open
+		// edges so that borders and seams don't get pulled inwards
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < outIndices.size(); i += 3)
+		{
+			const glm::vec3& a = vertices[outIndices[i + 0]].Position;
+			const glm::vec3& b = vertices[outIndices[i + 1]].Position;
+			const glm::vec3& c = vertices[outIndices[i + 2]].Position;
+
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float doubleArea = glm::length(normal);
+			if (doubleArea <= 0.0f)
+				continue;
+
+			normal /= doubleArea;
+			float distance = -glm::dot(normal, a);
+			for (uint32_t j = 0; j < 3; j++)
+				quadrics[positionIds[outIndices[i + j]]].AddPlane(normal, distance, doubleArea * 0.5);
+
+			for (uint32_t j = 0; j < 3; j++)
+			{
+				if (!openEdges[i + j])
+					continue;
+
+				uint32_t from = outIndices[i + j];
+				uint32_t to = outIndices[i + (j + 1) % 3];
+
+				glm::vec3 edge = vertices[to].Position - vertices[from].Position;
+				glm::vec3 edgeNormal = glm::cross(edge, normal);
+				float length = glm::length(edgeNormal);
+				if (length <= 0.0f)
+					continue;
+
+				edgeNormal /= length;
+				float edgeDistance = -glm::dot(edgeNormal, vertices[from].Position);
+				double weight = (double)length * length * BoundaryWeight;
+				quadrics[positionIds[from]].AddPlane(edgeNormal, edgeDistance, weight);
+				quadrics[positionIds[to]].AddPlane(edgeNormal, edgeDistance, weight);
+			}
+		}
+
+		struct Collapse
+		{
+			uint32_t From;
+			uint32_t To;
+			double Error;
+		};
+
+		std::vector<Collapse> collapses;
+		std::vector<double> errors;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint32_t> neighboursFrom;
+		std::vector<uint32_t> neighboursTo;
+
+		// Collapses done in a pass lock the positions around them
+		constexpr uint8_t Unlocked = 0;
+		constexpr uint8_t TargetOnly = 1;
+		constexpr uint8_t Locked = 2;
+		std::vector<uint8_t> locked(vertexCount);
+
+		const double maxErrorSquared = (double)maxError * (double)maxError;
+		double resultError = 0.0;
+
+		auto canCollapse = [&](uint32_t from, uint32_t to)
+		{
+			switch (kinds[from])
+			{
+			case VertexKind::Manifold:
+				return true;
+			case VertexKind::Border:
+				return (kinds[to] == VertexKind::Border || kinds[to] == VertexKind::Locked) && (adjacency.IsOpen(from, to) || adjacency.IsOpen(to, from));
+			case VertexKind::Seam:
+			{
+				// The other side of the seam has to have the matching edge, otherwise the seam would tear
+				uint32_t twinFrom = wedges[from];
+				uint32_t twinTo = wedges[to];
+				return kinds[to] == VertexKind::Seam && (adjacency.IsOpen(from, to) || adjacency.IsOpen(to, from))
+					&& (adjacency.IsOpen(twinFrom, twinTo) || adjacency.IsOpen(twinTo, twinFrom));
+			}
+			default:
+				return false;
+			}
+		};
+
+		// Checks the triangles around the collapsed position, positions of the ones that don't go away are the same
+		// as in the input since vertices are only ever moved onto other vertices
+		auto isCollapseValid = [&](uint32_t from, uint32_t to)
+		{
+			uint32_t positionFrom = positionIds[from];
+			uint32_t positionTo = positionIds[to];
+			const glm::vec3& target = vertices[to].Position;
+
+			neighboursFrom.clear();
+			uint32_t sharedTriangles = 0;
+			for (uint32_t triangle : adjacency.GetTriangles(positionFrom))
+			{
+				const uint32_t* corners = adjacency.GetTriangle(triangle);
+
+				bool shared = false;
+				for (uint32_t j = 0; j < 3; j++)
+				{
+					uint32_t position = positionIds[corners[j]];
+					if (position == positionTo)
+					{
+						shared = true;
+
+						// Interior vertex next to another wedge of the target would get attributes of the wrong side
+						if (kinds[from] == VertexKind::Manifold && corners[j] != to)
+							return false;
+					}
+					else if (position != positionFrom)
+					{
+						neighboursFrom.push_back(position);
+					}
+				}
+
+				if (shared)
+				{
+					sharedTriangles++;
+					continue;
+				}
+
+				glm::vec3 points[3];
+				for (uint32_t j = 0; j < 3; j++)
+					points[j] = vertices[corners[j]].Position;
+
+				glm::vec3 normal = glm::cross(points[1] - points[0], points[2] - points[0]);
+				for (uint32_t j = 0; j < 3; j++)
+				{
+					if (positionIds[corners[j]] == positionFrom)
+						points[j] = target;
+				}
+				glm::vec3 newNormal = glm::cross(points[1] - points[0], points[2] - points[0]);
+
+				// Triangles turning by more than ~75 degrees are as good as flipped, a few of those in a row would flip them
+				if (glm::dot(normal, newNormal) <= 0.25f * glm::length(normal) * glm::length(newNormal))
+					return false;
+			}
+
+			// Target may be next to collapses done earlier in the pass, its triangles are seen through the remap
+			neighboursTo.clear();
+			for (uint32_t triangle : adjacency.GetTriangles(positionTo))
+			{
+				const uint32_t* corners = adjacency.GetTriangle(triangle);
+				for (uint32_t j = 0; j < 3; j++)
+				{
+					uint32_t position = positionIds[remap[corners[j]]];
+					if (position != positionTo && position != positionFrom)
+						neighboursTo.push_back(position);
+				}
+			}
+
+			// Both ends may share only the vertices opposite of the edge, anything else would pinch the surface
+			std::sort(neighboursFrom.begin(), neighboursFrom.end());
+			neighboursFrom.erase(std::unique(neighboursFrom.begin(), neighboursFrom.end()), neighboursFrom.end());
+			std::sort(neighboursTo.begin(), neighboursTo.end());
+			neighboursTo.erase(std::unique(neighboursTo.begin(), neighboursTo.end()), neighboursTo.end());
+
+			uint32_t sharedNeighbours = 0;
+			for (size_t i = 0, j = 0; i < neighboursFrom.size() && j < neighboursTo.size();)
+			{
+				if (neighboursFrom[i] < neighboursTo[j]) i++;
+				else if (neighboursTo[j] < neighboursFrom[i]) j++;
+				else { sharedNeighbours++; i++; j++; }
+			}
+
+			return sharedTriangles > 0 && sharedNeighbours <= sharedTriangles;
+		};
+
+		// Collapses go in passes, each one takes the cheapest edges that don't get in each other's way
+		while (outIndices.size() > targetIndexCount)
+		{
+			adjacency.Build(outIndices, positionIds);
+
+			// Interior edges show up once in each direction, open ones only once so both directions are added for them.
+			// Edges between two interior vertices are never open
+			collapses.clear();
+			auto addCollapse = [&](uint32_t from, uint32_t to)
+			{
+				if (!canCollapse(from, to))
+					return;
+
+				double error = quadrics[positionIds[from]].GetError(vertices[to].Position);
+				if (error <= maxErrorSquared)
+					collapses.push_back({ from, to, error });
+			};
+
+			for (size_t i = 0; i < outIndices.size(); i++)
+			{
+				uint32_t a = outIndices[i];
+				uint32_t b = outIndices[i - i % 3 + (i + 1) % 3];
+				addCollapse(a, b);
+				if ((kinds[a] != VertexKind::Manifold || kinds[b] != VertexKind::Manifold) && !adjacency.HasEdge(b, a))
+					addCollapse(b, a);
+			}
+
+			if (collapses.empty())
+				break;
+
+			// Every collapse removes about two triangles. Going a bit over what's needed makes up for the ones that
+			// get rejected, while the error limit keeps expensive ones for later passes when cheaper ones show up
+			size_t neededCollapses = std::max<size_t>((outIndices.size() - targetIndexCount) / 6, 1);
+			size_t limitIndex = std::min(neededCollapses + neededCollapses / 2, collapses.size() - 1);
+
+			errors.resize(collapses.size());
+			for (size_t i = 0; i < collapses.size(); i++)
+				errors[i] = collapses[i].Error;
+			std::nth_element(errors.begin(), errors.begin() + limitIndex, errors.end());
+			double errorLimit = errors[limitIndex];
+
+			// Only the ones under the limit are sorted. Stable so that equal errors stay in triangle order and the
+			// result is the same every time
+			collapses.erase(std::remove_if(collapses.begin(), collapses.end(), [errorLimit](const Collapse& collapse) { return collapse.Error > errorLimit; }), collapses.end());
+			std::stable_sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(locked.begin(), locked.end(), Unlocked);
+
+			size_t remainingIndices = outIndices.size();
+			uint32_t collapseCount = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (remainingIndices <= targetIndexCount)
+					break;
+
+				uint32_t positionFrom = positionIds[collapse.From];
+				uint32_t positionTo = positionIds[collapse.To];
+				if (locked[positionFrom] != Unlocked || locked[positionTo] == Locked || !isCollapseValid(collapse.From, collapse.To))
+					continue;
+
+				// Triangles of the neighbours change, so they can't move anymore in this pass since the flip check
+				// would see them wrong. They can still be collapsed into
+				for (uint32_t triangle : adjacency.GetTriangles(positionFrom))
+				{
+					const uint32_t* corners = adjacency.GetTriangle(triangle);
+					for (uint32_t j = 0; j < 3; j++)
+					{
+						uint32_t position = positionIds[corners[j]];
+						locked[position] = std::max(locked[position], TargetOnly);
+						if (position == positionTo)
+							remainingIndices -= 3;
+					}
+				}
+				locked[positionFrom] = Locked;
+				locked[positionTo] = Locked;
+
+				remap[collapse.From] = collapse.To;
+				if (kinds[collapse.From] == VertexKind::Seam)
+					remap[wedges[collapse.From]] = wedges[collapse.To];
+
+				quadrics[positionTo].Add(quadrics[positionFrom]);
+				resultError = std::max(resultError, collapse.Error);
+				collapseCount++;
+			}
+
+			if (collapseCount == 0)
+				break;
+
+			kept = 0;
+			for (size_t i = 0; i < outIndices.size(); i += 3)
+			{
+				uint32_t a = remap[outIndices[i + 0]];
+				uint32_t b = remap[outIndices[i + 1]];
+				uint32_t c = remap[outIndices[i + 2]];
+				if (positionIds[a] == positionIds[b] || positionIds[b] == positionIds[c] || positionIds[c] == positionIds[a])
+					continue;
+
+				outIndices[kept++] = a;
+				outIndices[kept++] = b;
+				outIndices[kept++] = c;
+			}
+			outIndices.resize(kept);
+		}
+
+		return (float)std::sqrt(resultError);
+	}
+
+	void MeshOptimizer::GenerateLods(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices, uint32_t lodCount,
+		std::vector<Mesh::Lod>& outLods, std::vector<uint32_t>& outIndices)
+	{
+		outLods.clear();
+		outIndices.clear();
+
+		if (lodCount == 0)
+			return;
+
+		std::vector<uint32_t> previous(indices.begin(), indices.end());
+		std::vector<uint32_t> simplified;
+		float error = 0.0f;
+		for (uint32_t i = 0; i < lodCount; i++)
+		{
+			uint32_t targetIndexCount = (uint32_t)(previous.size() / 6) * 3;
+			error += Simplify(vertices, previous, targetIndexCount, std::numeric_limits<float>::max(), simplified);
+
+			// Locked vertices stop the simplification at some point, levels that barely differ aren't worth the memory
+			if (simplified.empty() || simplified.size() * 10 > previous.size() * 9)
+				break;
+
+			OptimizeVertexCache(simplified, (uint32_t)vertices.size());
+
+			Mesh::Lod lod;
+			lod.IndexOffset = (uint32_t)outIndices.size();
+			lod.IndexCount = (uint32_t)simplified.size();
+			lod.Error = error;
+			outLods.push_back(lod);
+
+			outIndices.insert(outIndices.end(), simplified.begin(), simplified.end());
+			previous.swap(simplified);
+		}
+	}
+
+	MeshOptimizer::VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStatistics statistics;
+
+		const uint64_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0 || !ValidateIndices(indices, vertexCount))
+			return statistics;
+
+		VertexCache cache(vertexCount, cacheSize);
+		std::vector<uint8_t> referenced(vertexCount, 0);
+		uint64_t referencedCount = 0;
+		for (uint64_t i = 0; i < triangleCount * 3; i++)
+		{
+			uint32_t vertex = indices[i];
+			if (!referenced[vertex])
+			{
+				referenced[vertex] = 1;
+				referencedCount++;
+			}
+
+			if (cache.Access(vertex))
+				statistics.VerticesTransformed++;
+		}
+
+		statistics.ACMR = (double)statistics.VerticesTransformed / (double)triangleCount;
+		statistics.ATVR = (double)statistics.VerticesTransformed / (double)referencedCount;
+
+		return statistics;
+	}
+
+	MeshOptimizer::Report MeshOptimizer::MeasureOptimization(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices)
+	{
+		Report report;
+		report.Before = AnalyzeVertexCache(indices, (uint32_t)vertices.size());
+
+		std::vector<Mesh::Vertex> optimizedVertices(vertices.begin(), vertices.end());
+		std::vector<uint32_t> optimizedIndices(indices.begin(), indices.end());
+
+		Timer timer;
+		Optimize(optimizedVertices, optimizedIndices);
+		report.Milliseconds = timer.ElapsedMillis();
+
+		report.After = AnalyzeVertexCache(optimizedIndices, (uint32_t)optimizedVertices.size());
+
+		VK_CORE_INFO("Mesh optimization: {0} triangles, ACMR {1:.3f} -> {2:.3f}, ATVR {3:.3f} -> {4:.3f} in {5:.2f}ms",
+			indices.size() / 3, report.Before.ACMR, report.After.ACMR, report.Before.ATVR, report.After.ATVR, report.Milliseconds);
+
+		return report;
+	}
+}
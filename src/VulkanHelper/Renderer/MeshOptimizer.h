@@ -0,0 +1,70 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+#include "Mesh.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Reorders mesh data so that the GPU does less work drawing it. Triangles are ordered for post transform
+	 * vertex cache reuse first, then groups of them are sorted so that outward facing ones are drawn first to cut down
+	 * overdraw, and finally vertices are laid out in the order they're first used so that fetches stay sequential.
+	 *
+	 * Works on plain vertex and index data, so any mesh can go through it before it's handed to Mesh::Init.
+	 * Also generates levels of detail by quadric error edge collapses.
+	 */
+	namespace MeshOptimizer
+	{
+		// Size of the simulated FIFO cache, small enough to fit the caches of most GPUs
+		constexpr uint32_t DefaultCacheSize = 16;
+
+		struct VertexCacheStatistics
+		{
+			uint64_t VerticesTransformed = 0;
+			// Vertices transformed per triangle, 3 means no reuse at all and ~0.5 is the best a regular grid can get
+			double ACMR = 0.0;
+			// Vertices transformed per vertex that's referenced, 1 is optimal
+			double ATVR = 0.0;
+		};
+
+		struct Report
+		{
+			VertexCacheStatistics Before;
+			VertexCacheStatistics After;
+			float Milliseconds = 0.0f;
+		};
+
+		// Tipsify, reorders triangles in linear time for a FIFO cache of the given size
+		void OptimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+
+		// Splits indices that are already cache optimized into clusters and sorts those from the most outward facing
+		// one, threshold is how much worse than the cache optimized order the ACMR is allowed to get
+		void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Mesh::Vertex> vertices, float threshold = 1.05f, uint32_t cacheSize = DefaultCacheSize);
+
+		// Moves vertices into the order they are first referenced in and drops the ones that aren't, indices are remapped
+		void OptimizeVertexFetch(std::vector<Mesh::Vertex>& vertices, std::span<uint32_t> indices);
+
+		// Runs all of the above in order
+		void Optimize(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// Collapses edges with the smallest quadric error until at most targetIndexCount indices are left or the next
+		// collapse would move the surface more than maxError. Vertices only move onto other vertices, so the result
+		// indexes the same vertex buffer. UV and normal seams and open borders are only collapsed along themselves,
+		// corners where they meet stay in place. Same input always gives the same output.
+		// Returns the error of the result, in the units of the mesh
+		float Simplify(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices, uint32_t targetIndexCount, float maxError,
+			std::vector<uint32_t>& outIndices);
+
+		// Up to lodCount levels below the full mesh, every one with about half the triangles of the previous one.
+		// Generation stops early once simplification stalls. Indices of all levels are stored one after another,
+		// errors add up from the full mesh
+		void GenerateLods(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices, uint32_t lodCount,
+			std::vector<Mesh::Lod>& outLods, std::vector<uint32_t>& outIndices);
+
+		VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+
+		// Optimizes a copy of the mesh and logs ACMR and ATVR before and after along with the time it took
+		Report MeasureOptimization(std::span<const Mesh::Vertex> vertices, std::span<const uint32_t> indices);
+	}
+}
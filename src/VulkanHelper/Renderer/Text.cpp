@@ -110,7 +110,13 @@ namespace VulkanHelper
 		{
 			// Update Device local memory using vkCmdUpdateBuffer
 			m_TextMesh.GetVertexBuffer()->WriteToBuffer(vertices.data(), vertices.size() * sizeof(Mesh::Vertex), 0, cmdBuffer);
-			m_TextMesh.GetIndexBuffer()->WriteToBuffer(indices.data(), indices.size() * sizeof(uint32_t), 0, cmdBuffer);
+			if (m_TextMesh.GetIndexType() == VK_INDEX_TYPE_UINT16)
+			{
+				std::vector<uint16_t> narrowIndices(indices.begin(), indices.end());
+				m_TextMesh.GetIndexBuffer()->WriteToBuffer(narrowIndices.data(), narrowIndices.size() * sizeof(uint16_t), 0, cmdBuffer);
+			}
+			else
+				m_TextMesh.GetIndexBuffer()->WriteToBuffer(indices.data(), indices.size() * sizeof(uint32_t), 0, cmdBuffer);
 		}
 		m_TextMesh.GetVertexCount() = (uint32_t)vertices.size();
 		m_TextMesh.GetIndexCount() = (uint32_t)indices.size();
@@ -31,51 +31,28 @@ namespace VulkanHelper
 		}
 	}
 
-	std::vector<char> ScriptComponent::Serialize()
+	void ScriptComponent::Serialize(BinaryWriter& writer)
 	{
-		std::vector<char> bytes;
-
-		for (int i = 0; i < ScriptClassesNames.size(); i++)
+		// Every name is null terminated, empty name ends the list
+		for (const std::string& name : ScriptClassesNames)
 		{
-			for (int j = 0; j < ScriptClassesNames[i].size(); j++)
-			{
-				bytes.push_back(ScriptClassesNames[i][j]);
-			}
+			writer.WriteString(name);
 		}
 
-		bytes.push_back('\0');
-
-		return bytes;
+		writer.WriteString("");
 	}
 
-	void ScriptComponent::Deserialize(const std::vector<char>& bytes)
+	void ScriptComponent::Deserialize(BinaryReader& reader)
 	{
-		std::vector<std::string> scriptClassNames(1);
-
-		if (bytes[0] == '\0') // No scripts attached
-			return;
-
-		for (int i = 0; i < bytes.size(); i++)
-		{
-			if (bytes[i] == '\0')
-			{
-				scriptClassNames.emplace_back("");
-			}
-
-			scriptClassNames[scriptClassNames.size() - 1].push_back(bytes[i]);
-		}
-
-		scriptClassNames.erase(scriptClassNames.end() - 1); // last index is always empty due to for loop above
-
-		ScriptClassesNames = scriptClassNames;
-
-		for (int i = 0; i < scriptClassNames.size(); i++)
+		std::string name;
+		while (!reader.IsAtEnd() && reader.ReadString(name) && !name.empty())
 		{
-			ScriptInterface* scInterface = (ScriptInterface*)Serializer::CreateRegisteredClass(scriptClassNames[i]);
+			ScriptInterface* scInterface = (ScriptInterface*)Serializer::CreateRegisteredClass(name);
 
 			VK_CORE_ASSERT(scInterface != nullptr, "Script doesn't inherit from script interface!");
 
 			Scripts.push_back(scInterface);
+			ScriptClassesNames.push_back(name);
 		}
 	}
 
@@ -93,228 +70,178 @@ namespace VulkanHelper
 		ScriptClassesNames = std::move(other.ScriptClassesNames);
 	}
 
-	std::vector<char> TransformComponent::Serialize()
+	void TransformComponent::Serialize(BinaryWriter& writer)
 	{
-		return VulkanHelper::Bytes::ToBytes(this, sizeof(TransformComponent));
+		writer.WriteBytes(&Transform, sizeof(VulkanHelper::Transform));
 	}
 
-	void TransformComponent::Deserialize(const std::vector<char>& bytes)
+	void TransformComponent::Deserialize(BinaryReader& reader)
 	{
-		TransformComponent comp = VulkanHelper::Bytes::FromBytes<TransformComponent>(bytes);
-		memcpy(&Transform, &comp.Transform, sizeof(VulkanHelper::Transform));
+		reader.ReadBytes(&Transform, sizeof(VulkanHelper::Transform));
 	}
 
-	std::vector<char> MeshComponent::Serialize()
+	void MeshComponent::Serialize(BinaryWriter& writer)
 	{
-		std::vector<char> bytes;
-
-		VulkanHelper::Mesh* mesh = AssetHandle.GetMesh();
-
-		// Get the vulkan buffers
-		uint64_t vertexCount = mesh->GetVertexCount();
-		uint64_t indexCount = mesh->GetIndexCount();
-		VulkanHelper::Buffer* vertexBuffer = mesh->GetVertexBuffer();
-		VulkanHelper::Buffer* indexBuffer = mesh->GetIndexBuffer();
-
-		std::vector<char> vertices(vertexCount * sizeof(VulkanHelper::Mesh::Vertex));
-		std::vector<char> indices(indexCount * sizeof(uint32_t));
-
-		// Read buffers into vectors
-		vertexBuffer->ReadFromBuffer(vertices.data(), vertices.size(), 0);
-		if (mesh->HasIndexBuffer()) // skip if empty
-			indexBuffer->ReadFromBuffer(indices.data(), indices.size(), 0);
-
-		// Start serializing
+		MeshAsset::SourceData source = dynamic_cast<MeshAsset*>(AssetHandle.GetAsset())->GetSourceData();
 
 		// Serialize Mesh Unique Path
-		std::string path = AssetHandle.GetAsset()->GetPath();
-		for (int i = 0; i < path.size(); i++)
-		{
-			bytes.push_back(path[i]);
-		}
-		bytes.push_back('\0');
-
-		// Serialize the amount of data
-		std::vector<char> vertexCountBytes = VulkanHelper::Bytes::ToBytes(&vertexCount, 8);
-		std::vector<char> indexCountBytes = VulkanHelper::Bytes::ToBytes(&indexCount, 8);
+		writer.WriteString(AssetHandle.GetAsset()->GetPath());
 
-		bytes.insert(bytes.end(), vertexCountBytes.begin(), vertexCountBytes.end());
-		bytes.insert(bytes.end(), indexCountBytes.begin(), indexCountBytes.end()); // don't skip size even when no index buffer
+		// Serialize the amount of data, don't skip size even when no index buffer
+		writer.Write((uint64_t)source.Vertices.size());
+		writer.Write((uint64_t)source.Indices.size());
 
 		// Serialize the mesh data
-		bytes.insert(bytes.end(), vertices.begin(), vertices.end());
-
-		if (mesh->HasIndexBuffer()) // Skip data if empty
-			bytes.insert(bytes.end(), indices.begin(), indices.end());
-
-		return bytes;
+		writer.WriteBytes(source.Vertices.data(), source.Vertices.size_bytes());
+		writer.WriteBytes(source.Indices.data(), source.Indices.size_bytes());
 	}
 
-	void MeshComponent::Deserialize(const std::vector<char>& bytes)
+	void MeshComponent::Deserialize(BinaryReader& reader)
 	{
+		std::string path;
 		uint64_t vertexCount = 0;
 		uint64_t indexCount = 0;
 
-		uint64_t currentPos = 0;
-		std::string path;
-		while (true)
-		{
-			char ch = bytes[currentPos];
-			currentPos++;
+		reader.ReadString(path);
+		reader.Read(vertexCount);
+		reader.Read(indexCount);
 
-			if (ch == '\0')
-				break;
-			else
-				path.push_back(ch);
+		if (reader.HasFailed() || vertexCount > reader.GetRemaining() / sizeof(VulkanHelper::Mesh::Vertex)
+			|| indexCount > (reader.GetRemaining() - vertexCount * sizeof(VulkanHelper::Mesh::Vertex)) / sizeof(uint32_t))
+		{
+			VK_CORE_ERROR("Mesh {} is corrupted", path);
+			return;
 		}
 
-		// Get the data sizes
-		memcpy(&vertexCount, bytes.data() + currentPos, 8);
-		currentPos += 8;
-		memcpy(&indexCount, bytes.data() + currentPos, 8);
-		currentPos += 8;
-
 		// Get the mesh data itself
 		std::vector<VulkanHelper::Mesh::Vertex> vertices(vertexCount);
 		std::vector<uint32_t> indices(indexCount);
 
-		memcpy(vertices.data(), bytes.data() + currentPos, vertices.size() * sizeof(VulkanHelper::Mesh::Vertex));
-		currentPos += vertices.size() * sizeof(VulkanHelper::Mesh::Vertex);
-		memcpy(indices.data(), bytes.data() + currentPos, indices.size() * sizeof(uint32_t));
-		currentPos += indices.size() * sizeof(uint32_t);
+		reader.ReadBytes(vertices.data(), vertices.size() * sizeof(VulkanHelper::Mesh::Vertex));
+		reader.ReadBytes(indices.data(), indices.size() * sizeof(uint32_t));
 
 		// Create the mesh
 		VulkanHelper::Mesh mesh;
-		mesh.Init({ &vertices, &indices });
+		mesh.Init(vertices, indices, 0, 0, nullptr, AssetManager::ChooseVertexLayout(vertices));
+
+		// Data is kept as the CPU side copy of the mesh so that saving the scene again doesn't read it back
+		auto data = std::make_shared<std::pair<std::vector<VulkanHelper::Mesh::Vertex>, std::vector<uint32_t>>>(std::move(vertices), std::move(indices));
+		VulkanHelper::MeshAsset::SourceData source{ data->first, data->second, data };
 
 		// Create the asset
-		std::unique_ptr<VulkanHelper::Asset> meshAsset = std::make_unique<VulkanHelper::MeshAsset>(path, std::move(mesh));
+		std::unique_ptr<VulkanHelper::Asset> meshAsset = std::make_unique<VulkanHelper::MeshAsset>(path, std::move(mesh), std::move(source));
 		AssetHandle = AssetManager::AddAsset(path, std::move(meshAsset));
 	}
 
-	std::vector<char> NameComponent::Serialize()
+	void MeshComponent::Serialize(BinaryWriter& writer, MeshTable& meshes)
 	{
-		std::vector<char> bytes;
-		for (int i = 0; i < Name.size(); i++)
-		{
-			bytes.push_back(Name[i]);
-		}
-		bytes.push_back('\0');
+		meshes.Add(AssetHandle);
 
-		return bytes;
+		writer.WriteString(AssetHandle.GetAsset()->GetPath());
 	}
 
-	void NameComponent::Deserialize(const std::vector<char>& bytes)
+	void MeshComponent::Deserialize(BinaryReader& reader, const MeshTable& meshes)
 	{
-		std::string name;
+		std::string path;
+		if (!reader.ReadString(path))
+			return;
 
-		int index = 0;
-		while (true)
+		// Fails the whole chunk, the scene is rejected as corrupted instead of getting a component without a mesh
+		AssetHandle = meshes.Find(path);
+		if (!AssetHandle.IsInitialized())
 		{
-			char ch = bytes[index];
-			index++;
-
-			if (ch == '\0')
-				break;
-			else
-				name.push_back(ch);
+			VK_CORE_ERROR("Mesh {} isn't in the scene mesh table!", path);
+			reader.MarkFailed();
 		}
-
-		Name = std::move(name);
 	}
 
-	std::vector<char> MaterialComponent::Serialize()
+	uint32_t MeshComponent::SelectLod(const glm::mat4& transform, const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight, float maxPixelError) const
 	{
-		Material* mat = AssetHandle.GetMaterial();
+		if (!AssetHandle.IsInitialized() || !AssetHandle.IsAssetLoaded())
+			return 0;
 
-		// Properties
-		std::vector<char> bytes;
+		const Mesh* mesh = AssetHandle.GetMesh();
+		if (mesh->GetLodCount() == 1)
+			return 0;
+
+		// LOD errors are in the space of the mesh, the largest scale of the transform is the worst case for them
+		float scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		glm::vec3 center = glm::vec3(transform * glm::vec4(mesh->GetBoundsCenter(), 1.0f));
 
-		// first 4 bytes are describing byte size of MaterialProperties
-		bytes.resize(4);
+		// Closest point of the sphere is what shows the error the most, inside of it the full mesh is always used
+		float distance = glm::length(center - cameraPosition) - mesh->GetBoundsRadius() * scale;
+		if (distance <= 0.0f)
+			return 0;
 
-		uint32_t propertiesSize = sizeof(MaterialProperties);
-		memcpy(bytes.data(), &propertiesSize, sizeof(uint32_t));
+		// [1][1] is the cotangent of half the vertical field of view, so this many pixels cover one unit at the distance
+		float pixelsPerUnit = glm::abs(projection[1][1]) * viewportHeight * 0.5f / distance * scale;
 
-		bytes.resize(bytes.size() + sizeof(MaterialProperties));
-		memcpy(bytes.data() + 4, &mat->Properties, sizeof(MaterialProperties));
+		return mesh->SelectLod(pixelsPerUnit, maxPixelError);
+	}
+
+	void NameComponent::Serialize(BinaryWriter& writer)
+	{
+		writer.WriteString(Name);
+	}
+
+	void NameComponent::Deserialize(BinaryReader& reader)
+	{
+		reader.ReadString(Name);
+	}
+
+	void MaterialComponent::Serialize(BinaryWriter& writer)
+	{
+		Material* mat = AssetHandle.GetMaterial();
+
+		// Properties, prefixed by their byte size
+		writer.Write((uint32_t)sizeof(MaterialProperties));
+		writer.WriteBytes(&mat->Properties, sizeof(MaterialProperties));
 
 		// Textures names
 		// 1. Albedo
 		// 2. Normal
 		// 3. Rougness
 		// 4. Metallness
-		std::vector<std::string> names;
-		names.emplace_back(mat->Textures.GetAlbedo().GetAsset()->GetPath());
-		names.emplace_back(mat->Textures.GetNormal().GetAsset()->GetPath());
-		names.emplace_back(mat->Textures.GetRoughness().GetAsset()->GetPath());
-		names.emplace_back(mat->Textures.GetMetallness().GetAsset()->GetPath());
-
-		for (int i = 0; i < 4; i++)
-		{
-			for (int j = 0; j < names[i].size(); j++)
-			{
-				bytes.push_back(names[i][j]);
-			}
-			bytes.push_back('\0');
-		}
+		writer.WriteString(mat->Textures.GetAlbedo().GetAsset()->GetPath());
+		writer.WriteString(mat->Textures.GetNormal().GetAsset()->GetPath());
+		writer.WriteString(mat->Textures.GetRoughness().GetAsset()->GetPath());
+		writer.WriteString(mat->Textures.GetMetallness().GetAsset()->GetPath());
 
 		// Material Name
-		for (int i = 0; i < mat->MaterialName.size(); i++)
-		{
-			bytes.push_back(mat->MaterialName[i]);
-		}
-		bytes.push_back('\0');
-
-		return bytes;
+		writer.WriteString(mat->MaterialName);
 	}
 
-	void MaterialComponent::Deserialize(const std::vector<char>& bytes)
+	void MaterialComponent::Deserialize(BinaryReader& reader)
 	{
 		// Properties
 		MaterialProperties props{};
 
-		// first 4 bytes are describing byte size of MaterialProperties
 		uint32_t propertiesSize = 0;
-		memcpy(&propertiesSize, bytes.data(), sizeof(uint32_t));
+		reader.Read(propertiesSize);
 
-		memcpy(&props, bytes.data() + 4, propertiesSize);
+		// Properties stored by a different version can be smaller or larger, only the common part is used
+		std::span<const char> properties = reader.ReadSpan(propertiesSize);
+		if (!properties.empty())
+			memcpy(&props, properties.data(), std::min<uint64_t>(properties.size(), sizeof(MaterialProperties)));
 
 		// Texture Names
-		std::vector<std::string> names;
-
-		int currentPos = propertiesSize + 4;
-		for (int i = 0; i < 4; i++)
+		std::array<std::string, 4> names;
+		for (std::string& name : names)
 		{
-			names.push_back("");
-			while (true)
-			{
-				char ch = bytes[currentPos];
-				currentPos += 1;
-
-				if (ch == '\0')
-					break;
-				else
-					names[i].push_back(ch);
-			}
+			reader.ReadString(name);
 		}
 
 		// Material Name
 		std::string materialName;
-		while (true)
-		{
-			char ch = bytes[currentPos];
-			materialName.push_back(ch);
-			currentPos += 1;
+		reader.ReadString(materialName);
 
-			if (ch == '\0')
-				break;
+		if (reader.HasFailed())
+		{
+			VK_CORE_ERROR("Material {} is corrupted", materialName);
+			return;
 		}
 
 		// Making an asset
-		std::hash<std::string> hash;
-		VulkanHelper::AssetHandle handle = VulkanHelper::AssetHandle(AssetHandle::CreateInfo{ hash(materialName) });
-
 		MaterialTextures textures{};
 
 		textures.SetAlbedo(AssetManager::LoadAsset(names[0]));
@@ -322,45 +249,35 @@ namespace VulkanHelper
 		textures.SetRoughness(AssetManager::LoadAsset(names[2]));
 		textures.SetMetallness(AssetManager::LoadAsset(names[3]));
 
+		std::vector<VulkanHelper::AssetHandle> dependencies = { textures.GetAlbedo(), textures.GetNormal(), textures.GetRoughness(), textures.GetMetallness() };
+
 		VulkanHelper::Material mat;
 		mat.Properties = std::move(props);
 		mat.Textures = std::move(textures);
 		mat.MaterialName = materialName;
 
 		std::unique_ptr<Asset> asset = std::make_unique<MaterialAsset>(materialName, std::move(mat));
-		AssetHandle = AssetManager::AddAsset(materialName, std::move(asset));
+		AssetHandle = AssetManager::AddAsset(materialName, std::move(asset), dependencies);
 	}
 
-	std::vector<char> TonemapperSettingsComponent::Serialize()
+	void TonemapperSettingsComponent::Serialize(BinaryWriter& writer)
 	{
-		std::vector<char> bytes;
-
-		bytes.resize(sizeof(VulkanHelper::Tonemap::TonemapInfo));
-
-		memcpy(bytes.data(), &Settings, sizeof(VulkanHelper::Tonemap::TonemapInfo));
-
-		return bytes;
+		writer.WriteBytes(&Settings, sizeof(VulkanHelper::Tonemap::TonemapInfo));
 	}
 
-	void TonemapperSettingsComponent::Deserialize(const std::vector<char>& bytes)
+	void TonemapperSettingsComponent::Deserialize(BinaryReader& reader)
 	{
-		memcpy(&Settings, bytes.data(), sizeof(VulkanHelper::Tonemap::TonemapInfo));
+		reader.ReadBytes(&Settings, sizeof(VulkanHelper::Tonemap::TonemapInfo));
 	}
 
-	std::vector<char> BloomSettingsComponent::Serialize()
+	void BloomSettingsComponent::Serialize(BinaryWriter& writer)
 	{
-		std::vector<char> bytes;
-
-		bytes.resize(sizeof(VulkanHelper::Bloom::BloomInfo));
-
-		memcpy(bytes.data(), &Settings, sizeof(VulkanHelper::Bloom::BloomInfo));
-
-		return bytes;
+		writer.WriteBytes(&Settings, sizeof(VulkanHelper::Bloom::BloomInfo));
 	}
 
-	void BloomSettingsComponent::Deserialize(const std::vector<char>& bytes)
+	void BloomSettingsComponent::Deserialize(BinaryReader& reader)
 	{
-		memcpy(&Settings, bytes.data(), sizeof(VulkanHelper::Bloom::BloomInfo));
+		reader.ReadBytes(&Settings, sizeof(VulkanHelper::Bloom::BloomInfo));
 	}
 
 }
\ No newline at end of file
@@ -12,6 +12,7 @@
 
 #include "Entity.h"
 #include "Asset/Asset.h"
+#include "Asset/MeshTable.h"
 
 #include "Effects/Tonemap.h"
 #include "Effects/Bloom.h"
@@ -90,8 +91,8 @@ namespace VulkanHelper
 
 		inline uint32_t GetScriptCount() const { return (uint32_t)Scripts.size(); }
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
 	};
 
 	class MeshComponent
@@ -104,8 +105,17 @@ namespace VulkanHelper
 		MeshComponent& operator=(const MeshComponent& other) { AssetHandle = other.AssetHandle; return *this; };
 		MeshComponent& operator=(MeshComponent&& other) noexcept { AssetHandle = std::move(other.AssetHandle); return *this; };
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		// Version 1 scenes, mesh data is embedded in every component
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
+
+		// Only the mesh path is stored, data is written once per unique mesh into the table
+		void Serialize(BinaryWriter& writer, MeshTable& meshes);
+		void Deserialize(BinaryReader& reader, const MeshTable& meshes);
+
+		// LOD to pass to Mesh::Bind and Mesh::Draw, picked by how big the bounding sphere of the mesh is on the screen.
+		// Projection is the one the camera renders with, viewport height is in pixels. 0 while the mesh isn't loaded
+		uint32_t SelectLod(const glm::mat4& transform, const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight, float maxPixelError = 1.0f) const;
 
 		VulkanHelper::AssetHandle AssetHandle;
 	};
@@ -120,8 +130,8 @@ namespace VulkanHelper
 		MaterialComponent& operator=(const MaterialComponent& other) { AssetHandle = other.AssetHandle; return *this; };
 		MaterialComponent& operator=(MaterialComponent&& other) noexcept { AssetHandle = std::move(other.AssetHandle); return *this; };
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
 
 		VulkanHelper::AssetHandle AssetHandle;
 	};
@@ -136,8 +146,8 @@ namespace VulkanHelper
 		TransformComponent& operator=(const TransformComponent& other) { Transform = other.Transform; return *this; };
 		TransformComponent& operator=(TransformComponent&& other) noexcept { Transform = std::move(other.Transform); return *this; };
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
 
 		VulkanHelper::Transform Transform;
 	};
@@ -152,8 +162,8 @@ namespace VulkanHelper
 		NameComponent& operator=(const NameComponent& other) { Name = other.Name; return *this; };
 		NameComponent& operator=(NameComponent&& other) noexcept { Name = std::move(other.Name); return *this; };
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
 
 		std::string Name;
 	};
@@ -168,8 +178,8 @@ namespace VulkanHelper
 		TonemapperSettingsComponent& operator=(const TonemapperSettingsComponent& other) { Settings = other.Settings; return *this; };
 		TonemapperSettingsComponent& operator=(TonemapperSettingsComponent&& other) noexcept { Settings = std::move(other.Settings); return *this; };
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
 
 		VulkanHelper::Tonemap::TonemapInfo Settings{};
 	};
@@ -184,8 +194,8 @@ namespace VulkanHelper
 		BloomSettingsComponent& operator=(const BloomSettingsComponent& other) { Settings = other.Settings; return *this; };
 		BloomSettingsComponent& operator=(BloomSettingsComponent&& other) noexcept { Settings = std::move(other.Settings); return *this; };
 
-		std::vector<char> Serialize();
-		void Deserialize(const std::vector<char>& bytes);
+		void Serialize(BinaryWriter& writer);
+		void Deserialize(BinaryReader& reader);
 
 		VulkanHelper::Bloom::BloomInfo Settings{};
 	};
@@ -0,0 +1,34 @@
+// Decoding of Mesh::PackedVertex. As vertex input the attributes are declared as
+//
+//     layout(location = 0) in vec4 inPosition;
+//     layout(location = 1) in vec2 inNormal;
+//     layout(location = 2) in vec2 inTexCoord;
+//
+// snorm and half float formats are already converted by the input assembler, texture coordinates are used as
+// they are. Position is in [-1, 1] inside of the bounding box of the mesh, either multiply
+// Mesh::GetDequantizationTransform() into the model matrix or call DecodePosition with its center and extent.
+
+vec3 DecodePosition(vec4 position, vec3 center, vec3 extent)
+{
+    return position.xyz * extent + center;
+}
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -t : t;
+    normal.y += normal.y >= 0.0 ? -t : t;
+
+    return normalize(normal);
+}
+
+// For packed vertices read raw out of a storage buffer, e.g. in hit shaders. Each vertex is 16 bytes, a uvec4
+void UnpackVertex(uvec4 data, vec3 center, vec3 extent, out vec3 position, out vec3 normal, out vec2 texCoord)
+{
+    vec2 xy = unpackSnorm2x16(data.x);
+    vec2 zw = unpackSnorm2x16(data.y);
+    position = DecodePosition(vec4(xy, zw), center, extent);
+    normal = DecodeOctahedral(unpackSnorm2x16(data.z));
+    texCoord = unpackHalf2x16(data.w);
+}
@@ -0,0 +1,486 @@
+#include "pch.h"
+#include "AsyncFileReader.h"
+#include <list>
+
+#include "Logger.h"
+#include "Assert.h"
+
+// liburing isn't a dependency, the kernel interface is small enough to be used directly through syscalls
+#if defined(LIN) && __has_include(<linux/io_uring.h>)
+#define VK_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		Ref<std::vector<char>> ReadWholeFile(const std::string& path)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+				return nullptr;
+
+			std::streamoff size = file.tellg();
+			if (size < 0)
+				return nullptr;
+
+			Ref<std::vector<char>> data = std::make_shared<std::vector<char>>((size_t)size);
+
+			file.seekg(0);
+			if (size > 0 && !file.read(data->data(), size))
+				return nullptr;
+
+			return data;
+		}
+	}
+
+#ifdef VK_IO_URING
+	struct AsyncFileReader::Ring
+	{
+		int FileDescriptor = -1;
+
+		void* SQRing = nullptr;
+		void* CQRing = nullptr;
+		size_t SQRingSize = 0;
+		size_t CQRingSize = 0;
+
+		io_uring_sqe* SQEs = nullptr;
+		size_t SQEsSize = 0;
+
+		uint32_t* SQHead = nullptr;
+		uint32_t* SQTail = nullptr;
+		uint32_t* SQArray = nullptr;
+		uint32_t SQMask = 0;
+		uint32_t SQEntries = 0;
+
+		uint32_t* CQHead = nullptr;
+		uint32_t* CQTail = nullptr;
+		io_uring_cqe* CQEs = nullptr;
+		uint32_t CQMask = 0;
+
+		~Ring() { Destroy(); }
+
+		bool Init(uint32_t entries)
+		{
+			io_uring_params params{};
+			FileDescriptor = (int)syscall(__NR_io_uring_setup, entries, &params);
+			if (FileDescriptor < 0)
+				return false;
+
+			SQRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+			CQRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+			// Newer kernels share a single mapping between both rings
+			bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+			if (singleMapping)
+				SQRingSize = CQRingSize = std::max(SQRingSize, CQRingSize);
+
+			SQRing = Map(SQRingSize, IORING_OFF_SQ_RING);
+			CQRing = singleMapping ? SQRing : Map(CQRingSize, IORING_OFF_CQ_RING);
+			SQEsSize = params.sq_entries * sizeof(io_uring_sqe);
+			SQEs = (io_uring_sqe*)Map(SQEsSize, IORING_OFF_SQES);
+			if (SQRing == nullptr || CQRing == nullptr || SQEs == nullptr)
+			{
+				Destroy();
+				return false;
+			}
+
+			char* sq = (char*)SQRing;
+			SQHead = (uint32_t*)(sq + params.sq_off.head);
+			SQTail = (uint32_t*)(sq + params.sq_off.tail);
+			SQArray = (uint32_t*)(sq + params.sq_off.array);
+			SQMask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+			SQEntries = params.sq_entries;
+
+			char* cq = (char*)CQRing;
+			CQHead = (uint32_t*)(cq + params.cq_off.head);
+			CQTail = (uint32_t*)(cq + params.cq_off.tail);
+			CQEs = (io_uring_cqe*)(cq + params.cq_off.cqes);
+			CQMask = *(uint32_t*)(cq + params.cq_off.ring_mask);
+
+			return true;
+		}
+
+		void Destroy()
+		{
+			if (SQEs != nullptr)
+				munmap(SQEs, SQEsSize);
+			if (CQRing != nullptr && CQRing != SQRing)
+				munmap(CQRing, CQRingSize);
+			if (SQRing != nullptr)
+				munmap(SQRing, SQRingSize);
+			if (FileDescriptor >= 0)
+				close(FileDescriptor);
+
+			FileDescriptor = -1;
+			SQRing = nullptr;
+			CQRing = nullptr;
+			SQEs = nullptr;
+		}
+
+		void* Map(size_t size, off_t offset)
+		{
+			void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, FileDescriptor, offset);
+			return data == MAP_FAILED ? nullptr : data;
+		}
+
+		// Returns false if the submission queue is full
+		bool PrepareRead(int fd, const iovec* vector, uint64_t offset, uint64_t userData)
+		{
+			// Only this thread writes the tail, the kernel moves the head as it consumes submissions
+			uint32_t tail = *SQTail;
+			if (tail - std::atomic_ref<uint32_t>(*SQHead).load(std::memory_order_acquire) >= SQEntries)
+				return false;
+
+			uint32_t index = tail & SQMask;
+			io_uring_sqe& sqe = SQEs[index];
+			memset(&sqe, 0, sizeof(io_uring_sqe));
+			sqe.opcode = IORING_OP_READV;
+			sqe.fd = fd;
+			sqe.addr = (uint64_t)vector;
+			sqe.len = 1;
+			sqe.off = offset;
+			sqe.user_data = userData;
+
+			SQArray[index] = index;
+			std::atomic_ref<uint32_t>(*SQTail).store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Returns the number of consumed submissions, or -1 with errno set
+		int Enter(uint32_t submitCount, uint32_t waitCount)
+		{
+			uint32_t flags = waitCount > 0 ? IORING_ENTER_GETEVENTS : 0;
+			return (int)syscall(__NR_io_uring_enter, FileDescriptor, submitCount, waitCount, flags, nullptr, 0);
+		}
+
+		template<typename F>
+		void Reap(F&& function)
+		{
+			uint32_t head = *CQHead;
+			uint32_t tail = std::atomic_ref<uint32_t>(*CQTail).load(std::memory_order_acquire);
+			for (; head != tail; head++)
+			{
+				function(CQEs[head & CQMask]);
+			}
+
+			std::atomic_ref<uint32_t>(*CQHead).store(head, std::memory_order_release);
+		}
+	};
+#else
+	struct AsyncFileReader::Ring {};
+#endif
+
+	// Defined here, where Ring is a complete type
+	AsyncFileReader::AsyncFileReader() = default;
+
+	AsyncFileReader::~AsyncFileReader()
+	{
+		Destroy();
+	}
+
+	void AsyncFileReader::Init(const CreateInfo& createInfo)
+	{
+		if (m_Initialized)
+			Destroy();
+
+		VK_CORE_ASSERT(createInfo.QueueDepth > 0 && createInfo.ChunkSize > 0, "Queue depth and chunk size can't be 0!");
+
+		m_QueueDepth = createInfo.QueueDepth;
+		m_ChunkSize = createInfo.ChunkSize;
+		m_Stop = false;
+
+#ifdef VK_IO_URING
+		if (!createInfo.DisableIOUring)
+		{
+			m_Ring = std::make_unique<Ring>();
+			if (m_Ring->Init(m_QueueDepth))
+			{
+				m_Threads.emplace_back([this] { RingLoop(); });
+			}
+			else
+			{
+				// Commonly blocked by seccomp in containers
+				VK_CORE_WARN("io_uring isn't available, files will be read with blocking calls");
+				m_Ring.reset();
+			}
+		}
+#endif
+
+		if (m_Ring == nullptr)
+		{
+			for (uint32_t i = 0; i < std::max(createInfo.ThreadCount, 1u); i++)
+			{
+				m_Threads.emplace_back([this] { BlockingLoop(); });
+			}
+		}
+
+		m_Initialized = true;
+	}
+
+	void AsyncFileReader::Destroy()
+	{
+		if (!m_Initialized)
+			return;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+		lock.unlock();
+		m_CV.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+
+		m_Threads.clear();
+		m_Ring.reset();
+		m_Initialized = false;
+	}
+
+	void AsyncFileReader::Read(const std::string& path, Callback&& callback)
+	{
+		VK_CORE_ASSERT(m_Initialized, "Reader isn't initialized!");
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Requests.push_back({ path, std::move(callback) });
+		lock.unlock();
+		m_CV.notify_one();
+	}
+
+	void AsyncFileReader::Read(const std::vector<std::string>& paths, BatchCallback&& callback)
+	{
+		VK_CORE_ASSERT(m_Initialized, "Reader isn't initialized!");
+
+		if (paths.empty())
+		{
+			callback({});
+			return;
+		}
+
+		struct Batch
+		{
+			std::vector<Ref<std::vector<char>>> Data;
+			std::atomic<uint32_t> Remaining;
+			BatchCallback OnRead;
+		};
+
+		Ref<Batch> batch = std::make_shared<Batch>();
+		batch->Data.resize(paths.size());
+		batch->Remaining = (uint32_t)paths.size();
+		batch->OnRead = std::move(callback);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		for (uint32_t i = 0; i < (uint32_t)paths.size(); i++)
+		{
+			m_Requests.push_back({ paths[i], [batch, i](Ref<std::vector<char>> data)
+				{
+					batch->Data[i] = std::move(data);
+					if (batch->Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						batch->OnRead(std::move(batch->Data));
+				} });
+		}
+		lock.unlock();
+		m_CV.notify_all();
+	}
+
+	void AsyncFileReader::BlockingLoop()
+	{
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_CV.wait(lock, [this] { return m_Stop || !m_Requests.empty(); });
+			if (m_Requests.empty())
+				return;
+
+			Request request = std::move(m_Requests.front());
+			m_Requests.pop_front();
+			lock.unlock();
+
+			request.OnRead(ReadWholeFile(request.Path));
+		}
+	}
+
+	void AsyncFileReader::RingLoop()
+	{
+#ifdef VK_IO_URING
+		struct OpenFile
+		{
+			Request Source;
+			int FileDescriptor = -1;
+			Ref<std::vector<char>> Data;
+
+			uint64_t NextOffset = 0;
+			uint64_t BytesRead = 0;
+			uint32_t InFlight = 0;
+			bool Failed = false;
+
+			// Parts of reads that have to be submitted again, after a short read or an interruption
+			std::vector<std::pair<uint64_t, uint64_t>> Retries;
+		};
+
+		struct ReadSlot
+		{
+			OpenFile* File = nullptr;
+			iovec Vector{};
+			uint64_t Offset = 0;
+		};
+
+		// List so that slots can keep pointers to files while others are added and removed
+		std::list<OpenFile> files;
+		std::vector<ReadSlot> slots(m_QueueDepth);
+		std::vector<uint32_t> freeSlots(m_QueueDepth);
+		for (uint32_t i = 0; i < m_QueueDepth; i++)
+		{
+			freeSlots[i] = m_QueueDepth - i - 1;
+		}
+
+		uint32_t unsubmitted = 0;
+		std::vector<Request> newRequests;
+
+		while (true)
+		{
+			// Sleep only when there is nothing in flight, otherwise new requests are picked up after the next completion
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (files.empty())
+			{
+				m_CV.wait(lock, [this] { return m_Stop || !m_Requests.empty(); });
+				if (m_Requests.empty())
+					return;
+			}
+
+			// Number of open files is bounded as well, so that huge batches don't allocate all of their memory at once
+			while (!m_Requests.empty() && files.size() + newRequests.size() < m_QueueDepth)
+			{
+				newRequests.push_back(std::move(m_Requests.front()));
+				m_Requests.pop_front();
+			}
+			lock.unlock();
+
+			for (Request& request : newRequests)
+			{
+				OpenFile file;
+				file.Source = std::move(request);
+				file.FileDescriptor = open(file.Source.Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+				struct stat fileStat;
+				if (file.FileDescriptor == -1 || fstat(file.FileDescriptor, &fileStat) == -1)
+				{
+					if (file.FileDescriptor != -1)
+						close(file.FileDescriptor);
+
+					file.Source.OnRead(nullptr);
+					continue;
+				}
+
+				file.Data = std::make_shared<std::vector<char>>((size_t)fileStat.st_size);
+				files.push_back(std::move(file));
+			}
+			newRequests.clear();
+
+			// Fill free slots with reads, retries go first so that files that are almost done finish sooner
+			for (OpenFile& file : files)
+			{
+				while (!freeSlots.empty() && !file.Failed)
+				{
+					uint64_t offset;
+					uint64_t size;
+					if (!file.Retries.empty())
+					{
+						std::tie(offset, size) = file.Retries.back();
+						file.Retries.pop_back();
+					}
+					else if (file.NextOffset < file.Data->size())
+					{
+						offset = file.NextOffset;
+						size = std::min<uint64_t>(m_ChunkSize, file.Data->size() - offset);
+						file.NextOffset += size;
+					}
+					else
+					{
+						break;
+					}
+
+					uint32_t index = freeSlots.back();
+					ReadSlot& slot = slots[index];
+					slot.File = &file;
+					slot.Offset = offset;
+					slot.Vector = { file.Data->data() + offset, (size_t)size };
+
+					if (!m_Ring->PrepareRead(file.FileDescriptor, &slot.Vector, offset, index))
+					{
+						file.Retries.push_back({ offset, size });
+						break;
+					}
+
+					freeSlots.pop_back();
+					file.InFlight++;
+					unsubmitted++;
+				}
+			}
+
+			// Submit everything at once and wait for at least one read to complete
+			if (freeSlots.size() < m_QueueDepth)
+			{
+				int result = m_Ring->Enter(unsubmitted, 1);
+				if (result >= 0)
+				{
+					unsubmitted -= (uint32_t)result;
+				}
+				else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				{
+					VK_CORE_ASSERT(false, "io_uring_enter failed! Error: {}", strerror(errno));
+					return;
+				}
+
+				m_Ring->Reap([&](const io_uring_cqe& cqe)
+					{
+						uint32_t index = (uint32_t)cqe.user_data;
+						ReadSlot& slot = slots[index];
+						OpenFile& file = *slot.File;
+
+						file.InFlight--;
+						freeSlots.push_back(index);
+
+						if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+						{
+							file.Retries.push_back({ slot.Offset, slot.Vector.iov_len });
+						}
+						else if (cqe.res <= 0)
+						{
+							// 0 means the file got shorter since it was opened
+							file.Failed = true;
+						}
+						else
+						{
+							file.BytesRead += (uint64_t)cqe.res;
+							if ((size_t)cqe.res < slot.Vector.iov_len)
+								file.Retries.push_back({ slot.Offset + cqe.res, slot.Vector.iov_len - cqe.res });
+						}
+					});
+			}
+
+			// Hand over files that are done
+			for (auto it = files.begin(); it != files.end();)
+			{
+				if (it->InFlight > 0 || (!it->Failed && it->BytesRead < it->Data->size()))
+				{
+					it++;
+					continue;
+				}
+
+				close(it->FileDescriptor);
+				it->Source.OnRead(it->Failed ? nullptr : std::move(it->Data));
+				it = files.erase(it);
+			}
+		}
+#endif
+	}
+}
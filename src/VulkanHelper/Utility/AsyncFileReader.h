@@ -0,0 +1,85 @@
+#pragma once
+#include "pch.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Pointers.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Reads whole files into memory on dedicated I/O threads, so threads that decode the data never block on
+	 * the disk. On Linux requests are batched and submitted through io_uring with many reads in flight at once,
+	 * which keeps slow disks busy. Everywhere else, or when io_uring isn't available, a few threads read files
+	 * with plain blocking calls instead.
+	 */
+	class AsyncFileReader
+	{
+	public:
+		struct CreateInfo
+		{
+			// Maximum number of reads in flight at once
+			uint32_t QueueDepth = 64;
+
+			// Big files are split into reads of this size so they don't hold up the small ones behind them
+			uint32_t ChunkSize = 1024 * 1024;
+
+			// Threads doing blocking reads, used only when io_uring isn't
+			uint32_t ThreadCount = 4;
+
+			bool DisableIOUring = false;
+		};
+
+		// Data is nullptr if the file couldn't be read
+		using Callback = std::function<void(Ref<std::vector<char>> data)>;
+		// Data is in the same order as the paths
+		using BatchCallback = std::function<void(std::vector<Ref<std::vector<char>>> data)>;
+
+		AsyncFileReader();
+		~AsyncFileReader();
+
+		void Init(const CreateInfo& createInfo);
+		// Finishes every read that was already requested before returning
+		void Destroy();
+
+		AsyncFileReader(const AsyncFileReader& other) = delete;
+		AsyncFileReader& operator=(const AsyncFileReader& other) = delete;
+
+		// Callbacks are invoked on an I/O thread, they are meant only to hand the data over, e.g. by pushing
+		// a decoding task onto a thread pool. Anything slower stalls the reads queued after it.
+		void Read(const std::string& path, Callback&& callback);
+		// Callback is invoked once every file is read, all of them are queued at once so they share submissions
+		void Read(const std::vector<std::string>& paths, BatchCallback&& callback);
+
+		inline bool IsUsingIOUring() const { return m_Ring != nullptr; }
+		inline bool IsInitialized() const { return m_Initialized; }
+
+	private:
+		struct Request
+		{
+			std::string Path;
+			Callback OnRead;
+		};
+
+		// io_uring instance, defined only on platforms that support it
+		struct Ring;
+
+		void RingLoop();
+		void BlockingLoop();
+
+		Scope<Ring> m_Ring;
+		std::vector<std::thread> m_Threads;
+
+		std::deque<Request> m_Requests;
+		std::mutex m_Mutex;
+		std::condition_variable m_CV;
+		bool m_Stop = false;
+
+		uint32_t m_QueueDepth = 0;
+		uint32_t m_ChunkSize = 0;
+
+		bool m_Initialized = false;
+	};
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Growable byte buffer that values are appended to. Clear keeps the capacity, so a writer reused across
+	 * many small objects stops allocating once it has grown to the size of the largest one.
+	 */
+	class BinaryWriter
+	{
+	public:
+		BinaryWriter() = default;
+
+		template<typename T>
+		void Write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written directly!");
+			WriteBytes(&value, sizeof(T));
+		}
+
+		void WriteBytes(const void* data, uint64_t size)
+		{
+			if (size == 0)
+				return;
+
+			uint64_t offset = m_Data.size();
+			m_Data.resize(offset + size);
+			memcpy(m_Data.data() + offset, data, size);
+		}
+
+		// Stored null terminated
+		void WriteString(std::string_view string)
+		{
+			WriteBytes(string.data(), string.size());
+			m_Data.push_back('\0');
+		}
+
+		// Overwrites a value written earlier, used to fill in sizes that are only known afterwards
+		template<typename T>
+		void WriteAt(uint64_t offset, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written directly!");
+			VK_CORE_ASSERT(offset + sizeof(T) <= m_Data.size(), "Writing out of bounds!");
+			memcpy(m_Data.data() + offset, &value, sizeof(T));
+		}
+
+		inline void Reserve(uint64_t size) { m_Data.reserve(size); }
+		inline void Clear() { m_Data.clear(); }
+
+		inline const char* GetData() const { return m_Data.data(); }
+		inline uint64_t GetSize() const { return m_Data.size(); }
+		inline std::span<const char> GetSpan() const { return { m_Data.data(), m_Data.size() }; }
+
+	private:
+		std::vector<char> m_Data;
+	};
+
+	/**
+	 * @brief Reads values out of a span without copying it. Every read is bounds checked, reading past the end
+	 * fails, leaves the output untouched and marks the reader as failed so that a whole sequence of reads can be
+	 * checked once at the end.
+	 */
+	class BinaryReader
+	{
+	public:
+		BinaryReader() = default;
+		BinaryReader(std::span<const char> data) : m_Data(data) {}
+
+		template<typename T>
+		bool Read(T& outValue)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read directly!");
+			return ReadBytes(&outValue, sizeof(T));
+		}
+
+		bool ReadBytes(void* dst, uint64_t size)
+		{
+			if (!Require(size))
+				return false;
+
+			memcpy(dst, m_Data.data() + m_Position, size);
+			m_Position += size;
+			return true;
+		}
+
+		// Returned span points into the read data, empty if there isn't enough data left
+		std::span<const char> ReadSpan(uint64_t size)
+		{
+			if (!Require(size))
+				return {};
+
+			std::span<const char> span = m_Data.subspan(m_Position, size);
+			m_Position += size;
+			return span;
+		}
+
+		// Reads until the null terminator, string that runs until the end of the data is accepted as well
+		bool ReadString(std::string& outString)
+		{
+			if (m_Failed || m_Position >= m_Data.size())
+			{
+				m_Failed = true;
+				return false;
+			}
+
+			const char* start = m_Data.data() + m_Position;
+			uint64_t length = strnlen(start, m_Data.size() - m_Position);
+			outString.assign(start, length);
+
+			m_Position = std::min<uint64_t>(m_Position + length + 1, m_Data.size());
+			return true;
+		}
+
+		// For data that was read fine but isn't valid, e.g. a reference to something that doesn't exist
+		inline void MarkFailed() { m_Failed = true; }
+
+		inline bool IsAtEnd() const { return m_Position >= m_Data.size(); }
+		inline bool HasFailed() const { return m_Failed; }
+		inline uint64_t GetPosition() const { return m_Position; }
+		inline uint64_t GetRemaining() const { return m_Data.size() - m_Position; }
+		inline std::span<const char> GetSpan() const { return m_Data; }
+
+	private:
+		bool Require(uint64_t size)
+		{
+			if (m_Failed || size > m_Data.size() - m_Position)
+			{
+				m_Failed = true;
+				return false;
+			}
+
+			return true;
+		}
+
+		std::span<const char> m_Data;
+		uint64_t m_Position = 0;
+		bool m_Failed = false;
+	};
+}
@@ -22,6 +22,27 @@ namespace VulkanHelper
 			return object;
 		}
 
+		// 64 bit FNV-1a variant consuming 8 bytes per step, good enough for detecting file changes
+		static uint64_t Hash64(const void* data, uint64_t size, uint64_t seed = 14695981039346656037ull)
+		{
+			const uint64_t prime = 1099511628211ull;
+			const char* bytes = (const char*)data;
+
+			uint64_t hash = seed;
+			uint64_t i = 0;
+			for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+			{
+				uint64_t word;
+				memcpy(&word, bytes + i, sizeof(uint64_t));
+				hash = (hash ^ word) * prime;
+				hash ^= hash >> 32;
+			}
+			for (; i < size; i++)
+				hash = (hash ^ (uint8_t)bytes[i]) * prime;
+
+			return hash;
+		}
+
 		static std::string NumberToHex(uint32_t number, uint8_t numberOfDigits)
 		{
 			std::stringstream ss;
@@ -0,0 +1,429 @@
+#include "pch.h"
+#include "Compression.h"
+#include "Logger.h"
+#include "Assert.h"
+#include "Timer.h"
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		constexpr uint32_t Magic = 0x5A4C4856; // "VHLZ"
+		constexpr uint32_t Version = 1;
+
+		// Set in the block size table for blocks that are stored uncompressed
+		constexpr uint32_t StoredFlag = 0x80000000u;
+
+		constexpr uint32_t MinMatch = 4;
+		constexpr uint32_t MaxOffset = 65535;
+		// Matches don't start in the last 12 bytes and end at least 5 bytes before the end of a block, so the last
+		// sequence is always literals only
+		constexpr uint32_t MatchStartLimit = 12;
+		constexpr uint32_t MatchEndLimit = 5;
+		constexpr uint32_t HashBits = 14;
+
+		struct Header
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint64_t Size;
+			uint32_t BlockSize;
+			uint32_t BlockCount;
+		};
+
+		inline uint32_t Read32(const uint8_t* data)
+		{
+			uint32_t value;
+			memcpy(&value, data, sizeof(uint32_t));
+			return value;
+		}
+
+		inline uint32_t HashSequence(uint32_t sequence)
+		{
+			return (sequence * 2654435761u) >> (32 - HashBits);
+		}
+
+		// Lengths of 15 and more continue in the following bytes, 255 at a time
+		inline bool WriteLength(uint8_t*& out, const uint8_t* outEnd, uint32_t length)
+		{
+			for (; length >= 255; length -= 255)
+			{
+				if (out == outEnd)
+					return false;
+				*out++ = 255;
+			}
+
+			if (out == outEnd)
+				return false;
+			*out++ = (uint8_t)length;
+			return true;
+		}
+
+		inline bool ReadLength(const uint8_t*& in, const uint8_t* inEnd, uint32_t& length)
+		{
+			uint8_t byte;
+			do
+			{
+				if (in == inEnd)
+					return false;
+
+				byte = *in++;
+				length += byte;
+			} while (byte == 255);
+
+			return true;
+		}
+
+		bool WriteSequence(uint8_t*& out, const uint8_t* outEnd, const uint8_t* literals, uint32_t literalCount, uint32_t offset, uint32_t matchLength)
+		{
+			uint32_t matchCode = matchLength - MinMatch;
+
+			if (out == outEnd)
+				return false;
+
+			uint8_t* token = out++;
+			*token = (uint8_t)(std::min(literalCount, 15u) << 4);
+			if (literalCount >= 15 && !WriteLength(out, outEnd, literalCount - 15))
+				return false;
+
+			if ((uint64_t)(outEnd - out) < literalCount)
+				return false;
+			memcpy(out, literals, literalCount);
+			out += literalCount;
+
+			// Last sequence of a block has no match
+			if (matchLength == 0)
+				return true;
+
+			if (outEnd - out < 2)
+				return false;
+			*out++ = (uint8_t)(offset & 0xFF);
+			*out++ = (uint8_t)(offset >> 8);
+
+			*token |= (uint8_t)std::min(matchCode, 15u);
+			if (matchCode >= 15 && !WriteLength(out, outEnd, matchCode - 15))
+				return false;
+
+			return true;
+		}
+
+		// Returns the compressed size, or 0 if the block doesn't fit into capacity
+		uint32_t CompressBlock(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity)
+		{
+			uint8_t* out = dst;
+			const uint8_t* outEnd = dst + capacity;
+
+			uint32_t anchor = 0;
+			if (size > MatchStartLimit)
+			{
+				// Positions are stored relative to the block start, stale entries are rejected by comparing the bytes
+				std::vector<uint32_t> table(1 << HashBits, 0);
+
+				const uint32_t startLimit = size - MatchStartLimit;
+				const uint32_t endLimit = size - MatchEndLimit;
+
+				uint32_t position = 1;
+				while (position < startLimit)
+				{
+					uint32_t sequence = Read32(src + position);
+					uint32_t hash = HashSequence(sequence);
+					uint32_t candidate = table[hash];
+					table[hash] = position;
+
+					if (position - candidate > MaxOffset || Read32(src + candidate) != sequence)
+					{
+						// Skip faster through data that doesn't compress
+						position += 1 + ((position - anchor) >> 6);
+						continue;
+					}
+
+					// Extend the match backwards into the pending literals
+					while (position > anchor && candidate > 0 && src[position - 1] == src[candidate - 1])
+					{
+						position--;
+						candidate--;
+					}
+
+					uint32_t length = MinMatch;
+					while (position + length < endLimit && src[position + length] == src[candidate + length])
+						length++;
+
+					if (!WriteSequence(out, outEnd, src + anchor, position - anchor, position - candidate, length))
+						return 0;
+
+					position += length;
+					anchor = position;
+
+					if (position < startLimit)
+						table[HashSequence(Read32(src + position - 2))] = position - 2;
+				}
+			}
+
+			if (!WriteSequence(out, outEnd, src + anchor, size - anchor, 0, 0))
+				return 0;
+
+			return (uint32_t)(out - dst);
+		}
+
+		bool DecompressBlock(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t dstSize)
+		{
+			const uint8_t* in = src;
+			const uint8_t* inEnd = src + size;
+			uint8_t* out = dst;
+			uint8_t* outEnd = dst + dstSize;
+
+			while (true)
+			{
+				if (in == inEnd)
+					return false;
+
+				uint8_t token = *in++;
+
+				uint32_t literalCount = token >> 4;
+				if (literalCount == 15 && !ReadLength(in, inEnd, literalCount))
+					return false;
+
+				if ((uint64_t)(inEnd - in) < literalCount || (uint64_t)(outEnd - out) < literalCount)
+					return false;
+
+				memcpy(out, in, literalCount);
+				in += literalCount;
+				out += literalCount;
+
+				if (in == inEnd)
+					return out == outEnd;
+
+				if (inEnd - in < 2)
+					return false;
+
+				uint32_t offset = (uint32_t)in[0] | ((uint32_t)in[1] << 8);
+				in += 2;
+
+				if (offset == 0 || offset > (uint64_t)(out - dst))
+					return false;
+
+				uint32_t matchLength = token & 15;
+				if (matchLength == 15 && !ReadLength(in, inEnd, matchLength))
+					return false;
+				matchLength += MinMatch;
+
+				if ((uint64_t)(outEnd - out) < matchLength)
+					return false;
+
+				const uint8_t* match = out - offset;
+				if (offset >= matchLength)
+				{
+					memcpy(out, match, matchLength);
+					out += matchLength;
+				}
+				else
+				{
+					// Overlapping match repeats the last offset bytes
+					for (uint32_t i = 0; i < matchLength; i++)
+						*out++ = match[i];
+				}
+			}
+		}
+
+		void ForEachBlock(uint32_t blockCount, ThreadPool* threadPool, const std::function<void(uint32_t)>& function)
+		{
+			if (threadPool != nullptr && blockCount > 1)
+			{
+				threadPool->ParallelFor(blockCount, function);
+				return;
+			}
+
+			for (uint32_t i = 0; i < blockCount; i++)
+				function(i);
+		}
+
+		bool ReadHeader(std::span<const char> data, Header& outHeader, std::vector<uint32_t>& outBlockSizes)
+		{
+			if (data.size() < sizeof(Header))
+				return false;
+
+			memcpy(&outHeader, data.data(), sizeof(Header));
+			if (outHeader.Magic != Magic || outHeader.Version != Version || outHeader.BlockSize == 0 || outHeader.BlockSize > Compression::MaxBlockSize)
+				return false;
+
+			uint64_t expectedBlocks = (outHeader.Size + outHeader.BlockSize - 1) / outHeader.BlockSize;
+			if (outHeader.BlockCount != expectedBlocks || outHeader.BlockCount > (data.size() - sizeof(Header)) / sizeof(uint32_t))
+				return false;
+
+			outBlockSizes.resize(outHeader.BlockCount);
+			memcpy(outBlockSizes.data(), data.data() + sizeof(Header), outBlockSizes.size() * sizeof(uint32_t));
+			return true;
+		}
+	}
+
+	std::vector<char> Compression::Compress(std::span<const char> data, ThreadPool* threadPool, uint32_t blockSize)
+	{
+		VK_CORE_ASSERT(blockSize > 0 && blockSize <= MaxBlockSize, "Invalid block size {}", blockSize);
+
+		uint32_t blockCount = (uint32_t)((data.size() + blockSize - 1) / blockSize);
+
+		// Every block gets compressed into its own buffer, stored blocks keep an empty one
+		std::vector<std::vector<char>> blocks(blockCount);
+		std::vector<uint32_t> blockSizes(blockCount);
+		ForEachBlock(blockCount, threadPool, [&](uint32_t block)
+		{
+			uint64_t offset = (uint64_t)block * blockSize;
+			uint32_t size = (uint32_t)std::min<uint64_t>(blockSize, data.size() - offset);
+			const uint8_t* src = (const uint8_t*)data.data() + offset;
+
+			blocks[block].resize(size);
+			uint32_t compressedSize = CompressBlock(src, size, (uint8_t*)blocks[block].data(), size - 1);
+			if (compressedSize == 0)
+			{
+				blocks[block].clear();
+				blockSizes[block] = size | StoredFlag;
+			}
+			else
+			{
+				blocks[block].resize(compressedSize);
+				blockSizes[block] = compressedSize;
+			}
+		});
+
+		Header header{ Magic, Version, (uint64_t)data.size(), blockSize, blockCount };
+
+		uint64_t totalSize = sizeof(Header) + blockCount * sizeof(uint32_t);
+		for (uint32_t size : blockSizes)
+			totalSize += size & ~StoredFlag;
+
+		std::vector<char> output(totalSize);
+		char* out = output.data();
+		memcpy(out, &header, sizeof(Header));
+		out += sizeof(Header);
+		memcpy(out, blockSizes.data(), blockCount * sizeof(uint32_t));
+		out += blockCount * sizeof(uint32_t);
+
+		for (uint32_t block = 0; block < blockCount; block++)
+		{
+			if (blockSizes[block] & StoredFlag)
+			{
+				uint32_t size = blockSizes[block] & ~StoredFlag;
+				memcpy(out, data.data() + (uint64_t)block * blockSize, size);
+				out += size;
+			}
+			else
+			{
+				memcpy(out, blocks[block].data(), blocks[block].size());
+				out += blocks[block].size();
+			}
+		}
+
+		return output;
+	}
+
+	bool Compression::IsCompressed(std::span<const char> data)
+	{
+		uint32_t magic = 0;
+		if (data.size() >= sizeof(uint32_t))
+			memcpy(&magic, data.data(), sizeof(uint32_t));
+
+		return magic == Magic;
+	}
+
+	bool Compression::GetDecompressedSize(std::span<const char> data, uint64_t& outSize)
+	{
+		Header header;
+		std::vector<uint32_t> blockSizes;
+		if (!ReadHeader(data, header, blockSizes))
+			return false;
+
+		outSize = header.Size;
+		return true;
+	}
+
+	bool Compression::Decompress(std::span<const char> data, std::span<char> dst, ThreadPool* threadPool)
+	{
+		Header header;
+		std::vector<uint32_t> blockSizes;
+		if (!ReadHeader(data, header, blockSizes) || header.Size != dst.size())
+			return false;
+
+		// Offsets of the blocks are only known after summing up the sizes of the previous ones
+		std::vector<uint64_t> offsets(header.BlockCount);
+		uint64_t offset = sizeof(Header) + (uint64_t)header.BlockCount * sizeof(uint32_t);
+		for (uint32_t block = 0; block < header.BlockCount; block++)
+		{
+			uint32_t size = blockSizes[block] & ~StoredFlag;
+			if (size > data.size() - offset)
+				return false;
+
+			offsets[block] = offset;
+			offset += size;
+		}
+
+		std::atomic<bool> valid = true;
+		ForEachBlock(header.BlockCount, threadPool, [&](uint32_t block)
+		{
+			uint64_t dstOffset = (uint64_t)block * header.BlockSize;
+			uint32_t dstSize = (uint32_t)std::min<uint64_t>(header.BlockSize, header.Size - dstOffset);
+			uint32_t size = blockSizes[block] & ~StoredFlag;
+			const uint8_t* src = (const uint8_t*)data.data() + offsets[block];
+			uint8_t* out = (uint8_t*)dst.data() + dstOffset;
+
+			if (blockSizes[block] & StoredFlag)
+			{
+				if (size != dstSize)
+					valid = false;
+				else
+					memcpy(out, src, size);
+			}
+			else if (!DecompressBlock(src, size, out, dstSize))
+			{
+				valid = false;
+			}
+		});
+
+		return valid;
+	}
+
+	bool Compression::Decompress(std::span<const char> data, std::vector<char>& outData, ThreadPool* threadPool)
+	{
+		uint64_t size = 0;
+		if (!GetDecompressedSize(data, size))
+			return false;
+
+		outData.resize(size);
+		return Decompress(data, std::span<char>(outData), threadPool);
+	}
+
+	Compression::BenchmarkResult Compression::Benchmark(std::span<const char> data, ThreadPool* threadPool, uint32_t iterations, uint32_t blockSize)
+	{
+		BenchmarkResult result;
+		result.UncompressedSize = data.size();
+
+		std::vector<char> compressed;
+		std::vector<char> decompressed(data.size());
+
+		// Best of the iterations, the first one also pays for page faults
+		float compressTime = std::numeric_limits<float>::max();
+		float decompressTime = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < std::max(iterations, 1u); i++)
+		{
+			Timer timer;
+			compressed = Compress(data, threadPool, blockSize);
+			compressTime = std::min(compressTime, timer.ElapsedSeconds());
+
+			timer.Reset();
+			bool valid = Decompress(compressed, decompressed, threadPool);
+			decompressTime = std::min(decompressTime, timer.ElapsedSeconds());
+
+			VK_CORE_ASSERT(valid && memcmp(decompressed.data(), data.data(), data.size()) == 0, "Compression round trip failed!");
+		}
+
+		const double megabytes = (double)data.size() / (1024.0 * 1024.0);
+		result.CompressedSize = compressed.size();
+		result.Ratio = compressed.empty() ? 0.0 : (double)data.size() / (double)compressed.size();
+		result.CompressMBps = megabytes / std::max((double)compressTime, 1e-9);
+		result.DecompressMBps = megabytes / std::max((double)decompressTime, 1e-9);
+
+		VK_CORE_INFO("Compression: {0} -> {1} bytes, ratio {2:.2f}, compress {3:.1f} MB/s, decompress {4:.1f} MB/s",
+			result.UncompressedSize, result.CompressedSize, result.Ratio, result.CompressMBps, result.DecompressMBps);
+
+		return result;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+#include "ThreadPool.h"
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief LZ77 block compressor in the spirit of LZ4, meant for data that's read far more often than it's written.
+	 * Input is split into fixed size blocks that are compressed independently, so both compression and decompression
+	 * of a large file spread across the thread pool. Blocks that don't get smaller are stored as they are.
+	 *
+	 * Compressed data starts with a magic number, IsCompressed tells it apart from raw files written before.
+	 */
+	namespace Compression
+	{
+		constexpr uint32_t DefaultBlockSize = 256 * 1024;
+		constexpr uint32_t MaxBlockSize = 16 * 1024 * 1024;
+
+		struct BenchmarkResult
+		{
+			uint64_t UncompressedSize = 0;
+			uint64_t CompressedSize = 0;
+			double Ratio = 0.0;
+			double CompressMBps = 0.0;
+			double DecompressMBps = 0.0;
+		};
+
+		std::vector<char> Compress(std::span<const char> data, ThreadPool* threadPool = nullptr, uint32_t blockSize = DefaultBlockSize);
+
+		bool IsCompressed(std::span<const char> data);
+
+		// Returns false if data isn't a valid compressed stream
+		bool GetDecompressedSize(std::span<const char> data, uint64_t& outSize);
+
+		// dst has to be exactly GetDecompressedSize bytes. Returns false if data is corrupted
+		bool Decompress(std::span<const char> data, std::span<char> dst, ThreadPool* threadPool = nullptr);
+		bool Decompress(std::span<const char> data, std::vector<char>& outData, ThreadPool* threadPool = nullptr);
+
+		// Round trips data a few times and logs the compression ratio along with the throughput in both directions
+		BenchmarkResult Benchmark(std::span<const char> data, ThreadPool* threadPool = nullptr, uint32_t iterations = 5, uint32_t blockSize = DefaultBlockSize);
+	}
+}
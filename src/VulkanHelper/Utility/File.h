@@ -1,6 +1,8 @@
 #pragma once
 
 #include "pch.h"
+#include "MappedFile.h"
+#include "Bytes.h"
 
 namespace VulkanHelper
 {
@@ -9,7 +11,7 @@ namespace VulkanHelper
 	public:
 
 		template<typename T>
-		static void WriteToFile(T* data, uint32_t byteSize, const std::string& filepath)
+		static void WriteToFile(T* data, uint64_t byteSize, const std::string& filepath)
 		{
 			std::ofstream outputFile(filepath, std::ios::binary); // Open the file for writing
 
@@ -21,47 +23,57 @@ namespace VulkanHelper
 		}
 
 		template<typename T>
-		static void ReadFromFile(T* data, uint32_t byteSize, const std::string& filepath, uint32_t offset = 0)
+		static void ReadFromFile(T* data, uint64_t byteSize, const std::string& filepath, uint64_t offset = 0)
 		{
-			std::ifstream file(filepath, std::ios::binary);
-			VK_CORE_ASSERT(file.is_open(), "failed to open file: " + filepath);
-
-			file.seekg(offset);
-
-			file.read(reinterpret_cast<char*>(data), byteSize);
+			MappedFile file;
+			if (!file.Init({ filepath }) || offset > file.GetSize() || byteSize > file.GetSize() - offset)
+			{
+				VK_CORE_ASSERT(false, "failed to read file: " + filepath);
+				return;
+			}
+
+			memcpy(data, file.GetData() + offset, byteSize);
 		}
 
+		// Trailing bytes that don't make up a whole T are ignored. Prefer MappedFile when the data doesn't have to be owned
 		template<typename T>
 		static void ReadFromFileVec(std::vector<T>& data, const std::string& filepath)
 		{
-			std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-			VK_CORE_ASSERT(file.is_open(), "failed to open file: " + filepath);
-
-			uint32_t fileSize = (uint32_t)(file.tellg());
-			file.seekg(0);
-
-			uint32_t TSize = sizeof(T);
-			data.resize(fileSize / TSize);
-
-			file.read(reinterpret_cast<char*>(data.data()), fileSize);
+			MappedFile file;
+			if (!file.Init({ filepath }))
+			{
+				VK_CORE_ASSERT(false, "failed to open file: " + filepath);
+				return;
+			}
+
+			data.resize(file.GetSize() / sizeof(T));
+			if (!data.empty())
+				memcpy(data.data(), file.GetData(), data.size() * sizeof(T));
 		}
 
+		// File is copied only once, straight from the mapping into the string
 		static std::string ReadFromFile(const std::string& filepath)
 		{
-			std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-			VK_CORE_ASSERT(file.is_open(), "failed to open file: " + filepath);
-
-			uint32_t fileSize = (uint32_t)(file.tellg());
-			file.seekg(0);
-
-			std::stringstream ss;
-
-			ss << file.rdbuf();
+			MappedFile file;
+			if (!file.Init({ filepath }))
+			{
+				VK_CORE_ASSERT(false, "failed to open file: " + filepath);
+				return "";
+			}
+
+			return std::string(file.GetData(), (size_t)file.GetSize());
+		}
 
-			file.close();
+		// Hashes whole file contents, used to tell whether cooked data is still up to date with its source
+		static bool HashFile(const std::string& filepath, uint64_t& outHash, uint64_t& outSize)
+		{
+			MappedFile file;
+			if (!file.Init({ filepath }))
+				return false;
 
-			std::string str = ss.str();
-			return str;
+			outHash = Bytes::Hash64(file.GetData(), file.GetSize());
+			outSize = file.GetSize();
+			return true;
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#ifndef WIN
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanHelper
+{
+	MappedFile::~MappedFile()
+	{
+		Destroy();
+	}
+
+	bool MappedFile::Init(const CreateInfo& createInfo)
+	{
+		if (m_Initialized)
+			Destroy();
+
+#ifdef WIN
+		m_FileHandle = CreateFileA(createInfo.Filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_FileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_FileHandle, &size))
+		{
+			Destroy();
+			return false;
+		}
+		m_Size = (uint64_t)size.QuadPart;
+
+		// Empty files can't be mapped, they are still valid though
+		if (m_Size > 0)
+		{
+			m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_MappingHandle == nullptr)
+			{
+				Destroy();
+				return false;
+			}
+
+			m_Data = (const char*)MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0);
+			if (m_Data == nullptr)
+			{
+				Destroy();
+				return false;
+			}
+		}
+#else
+		m_FileDescriptor = open(createInfo.Filepath.c_str(), O_RDONLY);
+		if (m_FileDescriptor == -1)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(m_FileDescriptor, &fileStat) == -1)
+		{
+			Destroy();
+			return false;
+		}
+		m_Size = (uint64_t)fileStat.st_size;
+
+		// Empty files can't be mapped, they are still valid though
+		if (m_Size > 0)
+		{
+			void* data = mmap(nullptr, (size_t)m_Size, PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+			if (data == MAP_FAILED)
+			{
+				Destroy();
+				return false;
+			}
+
+			m_Data = (const char*)data;
+			madvise(data, (size_t)m_Size, MADV_WILLNEED);
+		}
+#endif
+
+		m_Initialized = true;
+		return true;
+	}
+
+	void MappedFile::Destroy()
+	{
+#ifdef WIN
+		if (m_Data != nullptr)
+			UnmapViewOfFile(m_Data);
+		if (m_MappingHandle != nullptr)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(m_FileHandle);
+#else
+		if (m_Data != nullptr)
+			munmap((void*)m_Data, (size_t)m_Size);
+		if (m_FileDescriptor != -1)
+			close(m_FileDescriptor);
+#endif
+
+		Reset();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		m_Data = other.m_Data;
+		m_Size = other.m_Size;
+#ifdef WIN
+		m_FileHandle = other.m_FileHandle;
+		m_MappingHandle = other.m_MappingHandle;
+#else
+		m_FileDescriptor = other.m_FileDescriptor;
+#endif
+		m_Initialized = other.m_Initialized;
+
+		other.Reset();
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this == &other)
+			return *this;
+
+		Destroy();
+
+		m_Data = other.m_Data;
+		m_Size = other.m_Size;
+#ifdef WIN
+		m_FileHandle = other.m_FileHandle;
+		m_MappingHandle = other.m_MappingHandle;
+#else
+		m_FileDescriptor = other.m_FileDescriptor;
+#endif
+		m_Initialized = other.m_Initialized;
+
+		other.Reset();
+
+		return *this;
+	}
+
+	void MappedFile::Reset()
+	{
+		m_Data = nullptr;
+		m_Size = 0;
+#ifdef WIN
+		m_FileHandle = INVALID_HANDLE_VALUE;
+		m_MappingHandle = nullptr;
+#else
+		m_FileDescriptor = -1;
+#endif
+		m_Initialized = false;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Read only memory mapping of a whole file. Pages are loaded by the OS on first access so opening
+	 * is cheap regardless of the file size and nothing is copied into process memory.
+	 */
+	class MappedFile
+	{
+	public:
+		struct CreateInfo
+		{
+			std::string Filepath = "";
+		};
+
+		MappedFile() = default;
+		~MappedFile();
+
+		// Returns false if the file doesn't exist or can't be mapped
+		[[nodiscard]] bool Init(const CreateInfo& createInfo);
+		void Destroy();
+
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		inline const char* GetData() const { return m_Data; }
+		inline uint64_t GetSize() const { return m_Size; }
+		inline std::span<const char> GetSpan() const { return { m_Data, (size_t)m_Size }; }
+
+		inline bool IsInitialized() const { return m_Initialized; }
+
+	private:
+		const char* m_Data = nullptr;
+		uint64_t m_Size = 0;
+
+#ifdef WIN
+		HANDLE m_FileHandle = INVALID_HANDLE_VALUE;
+		HANDLE m_MappingHandle = nullptr;
+#else
+		int m_FileDescriptor = -1;
+#endif
+
+		bool m_Initialized = false;
+
+		void Reset();
+	};
+}
@@ -0,0 +1,339 @@
+#include "pch.h"
+#include "PixelConversion.h"
+#include "Logger.h"
+#include "Assert.h"
+#include "Timer.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#define VK_PIXEL_CONVERSION_SSE2
+	#include <emmintrin.h>
+	#if defined(__F16C__) || defined(__AVX2__)
+		#define VK_PIXEL_CONVERSION_F16C
+		#include <immintrin.h>
+	#endif
+#endif
+
+namespace VulkanHelper
+{
+	namespace
+	{
+		constexpr int SharedExponentBias = 15;
+		constexpr int SharedExponentMantissaBits = 9;
+		constexpr float SharedExponentMax = 65408.0f; // (2^9 - 1) / 2^9 * 2^(31 - 15)
+
+		inline uint32_t FloatBits(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(float));
+			return bits;
+		}
+
+		inline float BitsToFloat(uint32_t bits)
+		{
+			float value;
+			memcpy(&value, &bits, sizeof(float));
+			return value;
+		}
+
+#ifdef VK_PIXEL_CONVERSION_SSE2
+		// Same steps as the scalar FloatToHalf, lanes hold the result in their low 16 bits sign extended
+		inline __m128i FloatToHalfSSE2(__m128 value)
+		{
+			const __m128i signMask = _mm_set1_epi32((int)0x80000000u);
+			const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);
+			const __m128i nanBit = _mm_set1_epi32(0x200);
+			const __m128i infinity = _mm_set1_epi32(0x7C00);
+			const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+			const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+			const __m128i normalBias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23));
+
+			__m128 sign = _mm_and_ps(_mm_castsi128_ps(signMask), value);
+			__m128 absolute = _mm_xor_ps(value, sign);
+			__m128i absoluteBits = _mm_castps_si128(absolute);
+
+			__m128 isNan = _mm_cmpunord_ps(absolute, absolute);
+			__m128i isRegular = _mm_cmpgt_epi32(halfMax, absoluteBits);
+			__m128i special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isNan), nanBit), infinity);
+
+			__m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absoluteBits);
+			__m128 subnormalSum = _mm_add_ps(absolute, _mm_castsi128_ps(subnormalMagic));
+			__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(subnormalSum), subnormalMagic);
+
+			// Bias towards rounding up when the mantissa is odd to get round to nearest even
+			__m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absoluteBits, 31 - 13), 31);
+			__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absoluteBits, normalBias), mantissaOdd), 13);
+
+			__m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+			__m128i result = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, special));
+
+			return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+		}
+
+		inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+		{
+			return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+		}
+
+		// Packs 4 texels, r, g and b hold one channel of every texel
+		inline __m128i RGBToSharedExponentSSE2(__m128 r, __m128 g, __m128 b)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 maxValue = _mm_set1_ps(SharedExponentMax);
+			const __m128 half = _mm_set1_ps(0.5f);
+
+			// max_ps returns the second operand for NaNs, so they end up as 0
+			r = _mm_min_ps(_mm_max_ps(r, zero), maxValue);
+			g = _mm_min_ps(_mm_max_ps(g, zero), maxValue);
+			b = _mm_min_ps(_mm_max_ps(b, zero), maxValue);
+			__m128 maxChannel = _mm_max_ps(r, _mm_max_ps(g, b));
+
+			// floor(log2(maxChannel)) is the unbiased float exponent, clamped to -B - 1
+			__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxChannel), 23), _mm_set1_epi32(127));
+			const __m128i minExponent = _mm_set1_epi32(-SharedExponentBias - 1);
+			exponent = Select(_mm_cmpgt_epi32(exponent, minExponent), exponent, minExponent);
+			exponent = _mm_add_epi32(exponent, _mm_set1_epi32(1 + SharedExponentBias));
+
+			// 2^(B + N - exponent) built directly from exponent bits
+			__m128i scaleExponent = _mm_sub_epi32(_mm_set1_epi32(SharedExponentBias + SharedExponentMantissaBits + 127), exponent);
+			__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(scaleExponent, 23));
+
+			__m128i maxMantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxChannel, scale), half));
+			__m128i overflow = _mm_cmpeq_epi32(maxMantissa, _mm_set1_epi32(1 << SharedExponentMantissaBits));
+			exponent = _mm_sub_epi32(exponent, overflow);
+			scale = _mm_castsi128_ps(Select(overflow, _mm_castps_si128(_mm_mul_ps(scale, half)), _mm_castps_si128(scale)));
+
+			__m128i red = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+			__m128i green = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+			__m128i blue = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+
+			__m128i packed = _mm_or_si128(red, _mm_slli_epi32(green, 9));
+			packed = _mm_or_si128(packed, _mm_slli_epi32(blue, 18));
+			return _mm_or_si128(packed, _mm_slli_epi32(exponent, 27));
+		}
+#endif
+	}
+
+	uint16_t PixelConversion::FloatToHalf(float value)
+	{
+		const uint32_t floatInfinity = 255u << 23;
+		const uint32_t halfMax = (127u + 16u) << 23;
+		const uint32_t subnormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+		uint32_t bits = FloatBits(value);
+		uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		uint16_t result;
+		if (bits >= halfMax)
+		{
+			result = bits > floatInfinity ? 0x7E00 : 0x7C00;
+		}
+		else if (bits < (113u << 23))
+		{
+			// Adding the magic number lets the FPU do the rounding of subnormals
+			result = (uint16_t)(FloatBits(BitsToFloat(bits) + BitsToFloat(subnormalMagic)) - subnormalMagic);
+		}
+		else
+		{
+			uint32_t mantissaOdd = (bits >> 13) & 1;
+			bits += ((uint32_t)(15 - 127) << 23) + 0xFFF;
+			bits += mantissaOdd;
+			result = (uint16_t)(bits >> 13);
+		}
+
+		return result | (uint16_t)(sign >> 16);
+	}
+
+	float PixelConversion::HalfToFloat(uint16_t value)
+	{
+		const float magic = BitsToFloat(113u << 23);
+		const uint32_t shiftedExponent = 0x7C00u << 13;
+
+		uint32_t bits = (value & 0x7FFFu) << 13;
+		uint32_t exponent = shiftedExponent & bits;
+		bits += (127u - 15u) << 23;
+
+		if (exponent == shiftedExponent)
+		{
+			bits += (128u - 16u) << 23; // Inf or NaN
+		}
+		else if (exponent == 0)
+		{
+			bits += 1u << 23; // Subnormal, renormalize
+			bits = FloatBits(BitsToFloat(bits) - magic);
+		}
+
+		return BitsToFloat(bits | ((uint32_t)(value & 0x8000u) << 16));
+	}
+
+	uint32_t PixelConversion::RGBToSharedExponent(float r, float g, float b)
+	{
+		// Written with !(x > 0) so that NaNs end up as 0
+		r = !(r > 0.0f) ? 0.0f : std::min(r, SharedExponentMax);
+		g = !(g > 0.0f) ? 0.0f : std::min(g, SharedExponentMax);
+		b = !(b > 0.0f) ? 0.0f : std::min(b, SharedExponentMax);
+		float maxChannel = std::max(r, std::max(g, b));
+
+		int32_t exponent = (int32_t)(FloatBits(maxChannel) >> 23) - 127;
+		exponent = std::max(exponent, -SharedExponentBias - 1) + 1 + SharedExponentBias;
+
+		float scale = BitsToFloat((uint32_t)(SharedExponentBias + SharedExponentMantissaBits + 127 - exponent) << 23);
+
+		uint32_t maxMantissa = (uint32_t)(maxChannel * scale + 0.5f);
+		if (maxMantissa == (1u << SharedExponentMantissaBits))
+		{
+			exponent++;
+			scale *= 0.5f;
+		}
+
+		uint32_t red = (uint32_t)(r * scale + 0.5f);
+		uint32_t green = (uint32_t)(g * scale + 0.5f);
+		uint32_t blue = (uint32_t)(b * scale + 0.5f);
+
+		return red | (green << 9) | (blue << 18) | ((uint32_t)exponent << 27);
+	}
+
+	void PixelConversion::SharedExponentToRGB(uint32_t value, float& outR, float& outG, float& outB)
+	{
+		int32_t exponent = (int32_t)(value >> 27);
+		float scale = BitsToFloat((uint32_t)(exponent - SharedExponentBias - SharedExponentMantissaBits + 127) << 23);
+
+		outR = (float)(value & 0x1FF) * scale;
+		outG = (float)((value >> 9) & 0x1FF) * scale;
+		outB = (float)((value >> 18) & 0x1FF) * scale;
+	}
+
+	void PixelConversion::RGBA32FToRGBA16F(const float* src, uint16_t* dst, uint64_t texelCount)
+	{
+		uint64_t valueCount = texelCount * 4;
+		uint64_t i = 0;
+
+#if defined(VK_PIXEL_CONVERSION_F16C)
+		for (; i + 8 <= valueCount; i += 8)
+		{
+			__m256 values = _mm256_loadu_ps(src + i);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+		}
+#elif defined(VK_PIXEL_CONVERSION_SSE2)
+		for (; i + 8 <= valueCount; i += 8)
+		{
+			__m128i low = FloatToHalfSSE2(_mm_loadu_ps(src + i));
+			__m128i high = FloatToHalfSSE2(_mm_loadu_ps(src + i + 4));
+
+			// Lanes are sign extended 16 bit values so saturating pack keeps them intact
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(low, high));
+		}
+#endif
+
+		for (; i < valueCount; i++)
+			dst[i] = FloatToHalf(src[i]);
+	}
+
+	void PixelConversion::RGBA32FToE5B9G9R9(const float* src, uint32_t* dst, uint64_t texelCount)
+	{
+		uint64_t i = 0;
+
+#ifdef VK_PIXEL_CONVERSION_SSE2
+		for (; i + 4 <= texelCount; i += 4)
+		{
+			__m128 texel0 = _mm_loadu_ps(src + i * 4);
+			__m128 texel1 = _mm_loadu_ps(src + i * 4 + 4);
+			__m128 texel2 = _mm_loadu_ps(src + i * 4 + 8);
+			__m128 texel3 = _mm_loadu_ps(src + i * 4 + 12);
+
+			// Transpose so that every register holds one channel of 4 texels
+			_MM_TRANSPOSE4_PS(texel0, texel1, texel2, texel3);
+
+			_mm_storeu_si128((__m128i*)(dst + i), RGBToSharedExponentSSE2(texel0, texel1, texel2));
+		}
+#endif
+
+		for (; i < texelCount; i++)
+			dst[i] = RGBToSharedExponent(src[i * 4], src[i * 4 + 1], src[i * 4 + 2]);
+	}
+
+	PixelConversion::BenchmarkResult PixelConversion::Benchmark(std::span<const float> src, uint32_t iterations)
+	{
+		uint64_t texelCount = src.size() / 4;
+
+		BenchmarkResult result;
+		result.SourceSize = texelCount * 4 * sizeof(float);
+		result.RGBA16F.Size = texelCount * 4 * sizeof(uint16_t);
+		result.E5B9G9R9.Size = texelCount * sizeof(uint32_t);
+
+		std::vector<uint16_t> halves(texelCount * 4);
+		std::vector<uint32_t> packed(texelCount);
+
+		// Best of the iterations, the first one also pays for page faults
+		float halfTime = std::numeric_limits<float>::max();
+		float packedTime = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < std::max(iterations, 1u); i++)
+		{
+			Timer timer;
+			RGBA32FToRGBA16F(src.data(), halves.data(), texelCount);
+			halfTime = std::min(halfTime, timer.ElapsedSeconds());
+
+			timer.Reset();
+			RGBA32FToE5B9G9R9(src.data(), packed.data(), texelCount);
+			packedTime = std::min(packedTime, timer.ElapsedSeconds());
+		}
+
+		const float halfMax = 65504.0f;
+		const float halfMinNormal = 1.0f / 16384.0f;
+		for (uint64_t i = 0; i < texelCount * 4; i++)
+		{
+			// NaN payloads may differ on the F16C path
+			uint16_t expected = FloatToHalf(src[i]);
+			bool isNan = (expected & 0x7FFF) > 0x7C00;
+			VK_CORE_ASSERT(halves[i] == expected || (isNan && (halves[i] & 0x7FFF) > 0x7C00), "RGBA16F conversion doesn't match the scalar path!");
+
+			float value = src[i];
+			if (!std::isfinite(value) || std::abs(value) > halfMax)
+				continue;
+
+			double error = std::abs((double)HalfToFloat(halves[i]) - (double)value);
+			result.RGBA16F.MaxAbsoluteError = std::max(result.RGBA16F.MaxAbsoluteError, error);
+			result.RGBA16F.MaxRelativeError = std::max(result.RGBA16F.MaxRelativeError, error / std::max((double)std::abs(value), (double)halfMinNormal));
+		}
+
+		const float sharedExponentMinNormal = 1.0f / 32768.0f;
+		for (uint64_t i = 0; i < texelCount; i++)
+		{
+			const float* texel = src.data() + i * 4;
+			VK_CORE_ASSERT(packed[i] == RGBToSharedExponent(texel[0], texel[1], texel[2]), "E5B9G9R9 conversion doesn't match the scalar path!");
+
+			float decoded[3];
+			SharedExponentToRGB(packed[i], decoded[0], decoded[1], decoded[2]);
+
+			// Negative channels and NaNs are clamped to 0, so the texel only counts if every channel is in range
+			bool representable = true;
+			float maxChannel = 0.0f;
+			for (int j = 0; j < 3; j++)
+			{
+				representable &= texel[j] >= 0.0f && texel[j] <= SharedExponentMax;
+				maxChannel = std::max(maxChannel, texel[j]);
+			}
+
+			if (!representable)
+				continue;
+
+			for (int j = 0; j < 3; j++)
+			{
+				double error = std::abs((double)decoded[j] - (double)texel[j]);
+				result.E5B9G9R9.MaxAbsoluteError = std::max(result.E5B9G9R9.MaxAbsoluteError, error);
+				result.E5B9G9R9.MaxRelativeError = std::max(result.E5B9G9R9.MaxRelativeError, error / std::max((double)maxChannel, (double)sharedExponentMinNormal));
+			}
+		}
+
+		const double megabytes = (double)result.SourceSize / (1024.0 * 1024.0);
+		result.RGBA16F.MBps = megabytes / std::max((double)halfTime, 1e-9);
+		result.E5B9G9R9.MBps = megabytes / std::max((double)packedTime, 1e-9);
+
+		VK_CORE_INFO("RGBA16F: {0} -> {1} bytes, {2:.1f} MB/s, max error {3:.3g} absolute, {4:.3g} relative",
+			result.SourceSize, result.RGBA16F.Size, result.RGBA16F.MBps, result.RGBA16F.MaxAbsoluteError, result.RGBA16F.MaxRelativeError);
+		VK_CORE_INFO("E5B9G9R9: {0} -> {1} bytes, {2:.1f} MB/s, max error {3:.3g} absolute, {4:.3g} relative",
+			result.SourceSize, result.E5B9G9R9.Size, result.E5B9G9R9.MBps, result.E5B9G9R9.MaxAbsoluteError, result.E5B9G9R9.MaxRelativeError);
+
+		return result;
+	}
+}
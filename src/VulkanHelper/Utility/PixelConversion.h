@@ -0,0 +1,47 @@
+#pragma once
+#include "pch.h"
+#include <span>
+
+namespace VulkanHelper
+{
+	/**
+	 * @brief Conversions of RGBA32F pixel data into smaller HDR formats. Bulk functions process 4 texels per step
+	 * with SSE2 (F16C for halves when the compiler targets it) and fall back to the scalar versions elsewhere.
+	 * Both paths produce bit identical results, apart from NaN payloads on the F16C path.
+	 */
+	namespace PixelConversion
+	{
+		struct FormatError
+		{
+			uint64_t Size = 0;
+			double MaxAbsoluteError = 0.0;
+			double MaxRelativeError = 0.0;
+			double MBps = 0.0;
+		};
+
+		struct BenchmarkResult
+		{
+			uint64_t SourceSize = 0;
+			FormatError RGBA16F;
+			FormatError E5B9G9R9;
+		};
+
+		// Round to nearest even, values out of range become infinity, NaNs stay NaNs
+		uint16_t FloatToHalf(float value);
+		float HalfToFloat(uint16_t value);
+
+		// VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 as described in the Vulkan spec, negative values and NaNs become 0
+		uint32_t RGBToSharedExponent(float r, float g, float b);
+		void SharedExponentToRGB(uint32_t value, float& outR, float& outG, float& outB);
+
+		// texelCount is the number of RGBA texels in src
+		void RGBA32FToRGBA16F(const float* src, uint16_t* dst, uint64_t texelCount);
+		// Alpha channel is dropped
+		void RGBA32FToE5B9G9R9(const float* src, uint32_t* dst, uint64_t texelCount);
+
+		// Converts RGBA texels into both formats a few times and logs their size, throughput and the largest error
+		// after decoding them back, asserts that the bulk functions match the scalar ones. Only values the format can
+		// represent count towards the error, relative error of E5B9G9R9 is relative to the largest channel of the texel
+		BenchmarkResult Benchmark(std::span<const float> src, uint32_t iterations = 5);
+	}
+}
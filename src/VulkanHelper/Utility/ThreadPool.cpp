@@ -67,6 +67,51 @@ namespace VulkanHelper
 		Reset();
 	}
 
+	void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function)
+	{
+		if (count == 0)
+			return;
+
+		struct State
+		{
+			std::atomic<uint32_t> NextIndex = 0;
+			std::atomic<uint32_t> DoneCount = 0;
+			std::mutex Mutex;
+			std::condition_variable CV;
+		};
+		std::shared_ptr<State> state = std::make_shared<State>();
+
+		// Helpers that start only after everything is claimed exit right away without touching the function
+		auto work = [state, count, &function]()
+		{
+			uint32_t done = 0;
+			while (true)
+			{
+				uint32_t index = state->NextIndex.fetch_add(1, std::memory_order_relaxed);
+				if (index >= count)
+					break;
+
+				function(index);
+				done++;
+			}
+
+			if (done > 0 && state->DoneCount.fetch_add(done, std::memory_order_acq_rel) + done == count)
+			{
+				{ std::unique_lock<std::mutex> lock(state->Mutex); }
+				state->CV.notify_all();
+			}
+		};
+
+		uint32_t helperCount = std::min(count - 1, GetThreadCount());
+		for (uint32_t i = 0; i < helperCount; i++)
+			PushTask(work);
+
+		work();
+
+		std::unique_lock<std::mutex> lock(state->Mutex);
+		state->CV.wait(lock, [&state, count] { return state->DoneCount.load(std::memory_order_acquire) == count; });
+	}
+
 	void ThreadPool::Reset()
 	{
 		m_WorkerThreads.clear();
@@ -5,6 +5,7 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 
 namespace VulkanHelper
 {
@@ -37,6 +38,10 @@ namespace VulkanHelper
 			m_CV.notify_one();
 		}
 
+		// Calls function for every index in [0, count) across the pool and waits for all of them to finish.
+		// Calling thread takes part in the work as well so it's safe to call this from inside of a task.
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function);
+
 		inline uint32_t GetThreadCount() const { return (uint32_t)m_WorkerThreads.size(); }
 
 		inline bool IsInitialized() const { return m_Initialized; }
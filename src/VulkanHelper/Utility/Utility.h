@@ -5,6 +5,11 @@
 #include "Pointers.h"
 #include "Timer.h"
 #include "File.h"
+#include "MappedFile.h"
+#include "AsyncFileReader.h"
 #include "ThreadPool.h"
 #include "FunctionQueue.h"
-#include "Bytes.h"
\ No newline at end of file
+#include "Bytes.h"
+#include "BinaryStream.h"
+#include "Compression.h"
+#include "PixelConversion.h"
\ No newline at end of file